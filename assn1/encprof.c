@@ -0,0 +1,184 @@
+/* encprof.c - instruction encoding profiler routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "encprof.h"
+
+#if !defined(TARGET_PISA)
+#error The encoding profiler only supports the PISA target...
+#endif
+
+/* bits needed to hold V as a signed value, 0 for zero */
+static int
+encprof_swidth(sword_t v)
+{
+  sword_t x = v ^ (v >> 31);
+
+  if (x == 0)
+    return (v != 0);
+  return 33 - __builtin_clz((word_t)x);
+}
+
+/* bits needed to hold V as an unsigned value, 0 for zero */
+static int
+encprof_uwidth(word_t v)
+{
+  if (v == 0)
+    return 0;
+  return 32 - __builtin_clz(v);
+}
+
+/* create an encoding profiler, classifies every opcode by its format */
+struct encprof_t *
+encprof_create(void)
+{
+  int op;
+  char *s;
+  struct encprof_t *ep;
+
+  ep = (struct encprof_t *)calloc(1, sizeof(struct encprof_t));
+  if (!ep)
+    fatal("out of virtual memory");
+
+  for (op = 0; op < OP_MAX; op++)
+    {
+      ep->opclass[op] = enc_none;
+      for (s = MD_OP_FORMAT(op); s && *s; s++)
+	{
+	  switch (*s)
+	    {
+	    case 'j': ep->opclass[op] = enc_branch; break;
+	    case 'J': ep->opclass[op] = enc_jump; break;
+	    case 'o': ep->opclass[op] = enc_mem; break;
+	    case 'i': ep->opclass[op] = enc_simm; break;
+	    case 'u': case 'U': ep->opclass[op] = enc_uimm; break;
+	    default: break;
+	    }
+	}
+    }
+
+  return ep;
+}
+
+/* register one field width distribution */
+static struct stat_stat_t *
+encprof_reg_dist(struct stat_sdb_t *sdb, char *name, char *field, char *desc)
+{
+  char buf[512];
+
+  sprintf(buf, "%s.%s", name, field);
+  return stat_reg_dist(sdb, mystrdup(buf), desc,
+		       /* initial value */0,
+		       /* array size */ENCPROF_MAX_WIDTH + 1,
+		       /* bucket size */1, PF_COUNT|PF_PDF|PF_CDF,
+		       /* format */NULL, /* index map */NULL,
+		       /* print fn */NULL);
+}
+
+/* register encoding profiler statistics */
+void
+encprof_reg_stats(struct encprof_t *ep,	/* encoding profiler */
+		  struct stat_sdb_t *sdb,/* stats database */
+		  char *name)		/* profiler name, stats are <name>.* */
+{
+  ep->branch_dist =
+    encprof_reg_dist(sdb, name, "branch_disp",
+		     "bits needed for conditional branch displacements");
+  ep->jump_dist =
+    encprof_reg_dist(sdb, name, "jump_disp",
+		     "bits needed for direct jump displacements");
+  ep->mem_dist =
+    encprof_reg_dist(sdb, name, "mem_disp",
+		     "bits needed for load/store displacements");
+  ep->imm_dist =
+    encprof_reg_dist(sdb, name, "imm",
+		     "bits needed for ALU immediates");
+}
+
+/* profile instruction INST, opcode OP, at PC */
+void
+encprof_inst(struct encprof_t *ep,	/* encoding profiler */
+	     md_inst_t inst,		/* instruction */
+	     enum md_opcode op,		/* decoded opcode */
+	     md_addr_t pc)		/* instruction address */
+{
+  md_addr_t target;
+
+  switch (ep->opclass[op])
+    {
+    case enc_branch:
+      stat_add_sample(ep->branch_dist, encprof_swidth(OFS));
+      break;
+    case enc_jump:
+      /* same target computation as the J/JAL implementations */
+      target = (pc & 036000000000) | (TARG << 2);
+      stat_add_sample(ep->jump_dist,
+		      encprof_swidth((sword_t)(target - (pc + 8)) >> 2));
+      break;
+    case enc_mem:
+      stat_add_sample(ep->mem_dist, encprof_swidth(OFS));
+      break;
+    case enc_simm:
+      stat_add_sample(ep->imm_dist, encprof_swidth(IMM));
+      break;
+    case enc_uimm:
+      stat_add_sample(ep->imm_dist, encprof_uwidth(UIMM));
+      break;
+    default:
+      break;
+    }
+}
@@ -0,0 +1,118 @@
+/* encprof.h - instruction encoding profiler interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef ENCPROF_H
+#define ENCPROF_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * The encoding profiler measures how many bits each instruction's immediate
+ * field actually needs, for instruction set encoding studies.  Instructions
+ * are classified by their operand format (see MD_OP_FORMAT()):
+ *
+ *   <name>.branch_disp	- conditional branch displacements ("j")
+ *   <name>.jump_disp	- direct jump targets, as a displacement from the
+ *			  next instruction ("J")
+ *   <name>.mem_disp	- load/store displacements ("o")
+ *   <name>.imm		- ALU immediates, signed ("i") or unsigned ("u", "U")
+ *
+ * Each is a stats database distribution of field width in bits.  Signed
+ * fields count the sign bit, so 0 needs 0 bits, -1 needs 1 and 1 needs 2.
+ * Displacements are in instruction set units, i.e., 4 byte words.
+ */
+
+/* encoding classes */
+enum encprof_class_t {
+  enc_none,			/* no immediate field */
+  enc_branch,			/* conditional branch displacement */
+  enc_jump,			/* direct jump target */
+  enc_mem,			/* load/store displacement */
+  enc_simm,			/* signed ALU immediate */
+  enc_uimm,			/* unsigned ALU immediate */
+  enc_NUM
+};
+
+/* widest field measured */
+#define ENCPROF_MAX_WIDTH	32
+
+/* encoding profiler */
+struct encprof_t {
+  enum encprof_class_t opclass[OP_MAX];	/* encoding class, by opcode */
+  struct stat_stat_t *branch_dist;	/* branch displacement widths */
+  struct stat_stat_t *jump_dist;	/* jump displacement widths */
+  struct stat_stat_t *mem_dist;		/* load/store displacement widths */
+  struct stat_stat_t *imm_dist;		/* ALU immediate widths */
+};
+
+/* create an encoding profiler, classifies every opcode by its format */
+struct encprof_t *
+encprof_create(void);
+
+/* register encoding profiler statistics */
+void
+encprof_reg_stats(struct encprof_t *ep,	/* encoding profiler */
+		  struct stat_sdb_t *sdb,/* stats database */
+		  char *name);		/* profiler name, stats are <name>.* */
+
+/* profile instruction INST, opcode OP, at PC */
+void
+encprof_inst(struct encprof_t *ep,	/* encoding profiler */
+	     md_inst_t inst,		/* instruction */
+	     enum md_opcode op,		/* decoded opcode */
+	     md_addr_t pc);		/* instruction address */
+
+#endif /* ENCPROF_H */
@@ -0,0 +1,208 @@
+/* hazprof.c - data hazard profiler routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "hazprof.h"
+
+/* producer class names, for the stats */
+static char *hazprof_class_name[hc_NUM] = {
+  "alu", "load", "mult", "fp", "branch"
+};
+
+/* classify the result of instruction OP */
+static enum hazprof_class_t
+hazprof_class(enum md_opcode op)
+{
+  if (MD_OP_FLAGS(op) & F_LOAD)
+    return hc_load;
+  else if (MD_OP_FLAGS(op) & F_CTRL)
+    return hc_branch;
+  else if (MD_OP_FUCLASS(op) == IntMULT || MD_OP_FUCLASS(op) == IntDIV)
+    return hc_mult;
+  else if (MD_OP_FLAGS(op) & F_FCOMP)
+    return hc_fp;
+  else
+    return hc_alu;
+}
+
+/* create a hazard profiler tracking RAW distances up to WINDOW instructions,
+   with the result latencies LAT[], indexed by producer class */
+struct hazprof_t *
+hazprof_create(int window,		/* RAW distances tracked */
+	       int *lat)		/* result latency, by class */
+{
+  int i;
+  struct hazprof_t *hp;
+
+  if (window < 1)
+    fatal("hazard window `%d' must be at least one instruction", window);
+  for (i = 0; i < hc_NUM; i++)
+    {
+      if (lat[i] < 1 || lat[i] > window)
+	fatal("%s result latency `%d' must be between 1 and the window (%d)",
+	      hazprof_class_name[i], lat[i], window);
+    }
+
+  hp = (struct hazprof_t *)calloc(1, sizeof(struct hazprof_t));
+  if (!hp)
+    fatal("out of virtual memory");
+
+  hp->window = window;
+  for (i = 0; i < hc_NUM; i++)
+    hp->lat[i] = lat[i];
+
+  return hp;
+}
+
+/* register hazard profiler statistics */
+void
+hazprof_reg_stats(struct hazprof_t *hp,	/* hazard profiler */
+		  struct stat_sdb_t *sdb,/* stats database */
+		  char *name)		/* profiler name, stats are <name>.* */
+{
+  int i;
+  char buf[512], buf1[512], buf2[512];
+
+  sprintf(buf, "%s.cycles", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total cycles on the profiled pipeline",
+		   &hp->issue, 0, NULL);
+  sprintf(buf, "%s.cpi", name);
+  sprintf(buf1, "%s.cycles / (sim_num_insn - sim_insn_base)", name);
+  stat_reg_formula(sdb, mystrdup(buf),
+		   "cycles per instruction on the profiled pipeline",
+		   mystrdup(buf1), NULL);
+
+  buf2[0] = '\0';
+  for (i = 0; i < hc_NUM; i++)
+    {
+      sprintf(buf, "%s.%s.stalls", name, hazprof_class_name[i]);
+      sprintf(buf1, "stall cycles waiting on %s results",
+	      hazprof_class_name[i]);
+      stat_reg_counter(sdb, mystrdup(buf), mystrdup(buf1),
+		       &hp->stalls[i], 0, NULL);
+
+      sprintf(buf, "%s.%s.raw_dist", name, hazprof_class_name[i]);
+      sprintf(buf1, "RAW distance to %s producers, in instructions",
+	      hazprof_class_name[i]);
+      hp->raw_dist[i] =
+	stat_reg_dist(sdb, mystrdup(buf), mystrdup(buf1),
+		      /* initial value */0, /* array size */hp->window + 1,
+		      /* bucket size */1, PF_COUNT|PF_PDF|PF_CDF,
+		      /* format */NULL, /* index map */NULL,
+		      /* print fn */NULL);
+
+      sprintf(buf1, "%s%s.%s.stalls", i ? " + " : "", name,
+	      hazprof_class_name[i]);
+      strcat(buf2, buf1);
+    }
+  sprintf(buf, "%s.stalls", name);
+  stat_reg_formula(sdb, mystrdup(buf), "total stall cycles",
+		   mystrdup(buf2), "%12.0f");
+}
+
+/* profile instruction OP, which reads IN1-IN3 and writes OUT1-OUT2; the
+   registers are dependence indices, DNA or $r0 (0) if unused */
+void
+hazprof_inst(struct hazprof_t *hp,	/* hazard profiler */
+	     enum md_opcode op,		/* instruction opcode */
+	     int out1, int out2,	/* output dependences */
+	     int in1, int in2, int in3)	/* input dependences */
+{
+  int i, in[3], out[2];
+  counter_t issue, dist;
+  enum hazprof_class_t class, waited = hc_alu;
+
+  hp->insts++;
+  issue = hp->issue + 1;
+
+  /* find the last input to become ready */
+  in[0] = in1; in[1] = in2; in[2] = in3;
+  for (i = 0; i < 3; i++)
+    {
+      int reg = in[i];
+
+      if (reg <= 0 || reg >= MD_TOTAL_REGS || !hp->prod_inst[reg])
+	continue;
+
+      dist = hp->insts - hp->prod_inst[reg];
+      stat_add_sample(hp->raw_dist[hp->prod_class[reg]], dist);
+
+      if (hp->ready[reg] > issue)
+	{
+	  issue = hp->ready[reg];
+	  waited = hp->prod_class[reg];
+	}
+    }
+  hp->stalls[waited] += issue - (hp->issue + 1);
+  hp->issue = issue;
+
+  /* the outputs are ready once the result is forwarded */
+  class = hazprof_class(op);
+  out[0] = out1; out[1] = out2;
+  for (i = 0; i < 2; i++)
+    {
+      int reg = out[i];
+
+      if (reg <= 0 || reg >= MD_TOTAL_REGS)
+	continue;
+      hp->prod_inst[reg] = hp->insts;
+      hp->prod_class[reg] = class;
+      hp->ready[reg] = issue + hp->lat[class];
+    }
+}
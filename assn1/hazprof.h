@@ -0,0 +1,128 @@
+/* hazprof.h - data hazard profiler interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef HAZPROF_H
+#define HAZPROF_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * The hazard profiler screens in-order pipeline designs without a cycle
+ * model.  It remembers, for every register (by dependence index), which
+ * instruction last wrote it and what class of instruction that was, and
+ * reports for each producer class:
+ *
+ *   <name>.<class>.raw_dist	- read-after-write distance, in instructions,
+ *				  up to the window size; longer distances show
+ *				  up as overflows
+ *   <name>.<class>.stalls	- stall cycles waiting on that class
+ *
+ * The stalls come from a register scoreboard: an instruction issues one
+ * cycle after its predecessor, or once all of its inputs are ready, and a
+ * result is ready LAT[class] cycles after its producer issued.  LAT
+ * describes the forwarding network, e.g., a classic five stage pipeline
+ * with full forwarding has an ALU latency of 1 and a load latency of 2,
+ * without forwarding both are 3.
+ */
+
+/* producer classes */
+enum hazprof_class_t {
+  hc_alu,			/* integer ALU and everything else */
+  hc_load,			/* loads */
+  hc_mult,			/* integer multiply/divide */
+  hc_fp,			/* floating point computation */
+  hc_branch,			/* control (link register writes) */
+  hc_NUM
+};
+
+/* hazard profiler */
+struct hazprof_t {
+  int window;				/* RAW distances tracked */
+  int lat[hc_NUM];			/* result latency, by class */
+  counter_t insts;			/* instructions seen */
+  counter_t issue;			/* cycle the last instruction issued */
+
+  /* last producer of each register */
+  counter_t prod_inst[MD_TOTAL_REGS];	/* instruction number, 0 if none */
+  counter_t ready[MD_TOTAL_REGS];	/* cycle the value is ready */
+  enum hazprof_class_t prod_class[MD_TOTAL_REGS]; /* producer class */
+
+  /* profiler stats */
+  counter_t stalls[hc_NUM];		/* stall cycles, by producer class */
+  struct stat_stat_t *raw_dist[hc_NUM];	/* RAW distances, by producer class */
+};
+
+/* create a hazard profiler tracking RAW distances up to WINDOW instructions,
+   with the result latencies LAT[], indexed by producer class */
+struct hazprof_t *
+hazprof_create(int window,		/* RAW distances tracked */
+	       int *lat);		/* result latency, by class */
+
+/* register hazard profiler statistics */
+void
+hazprof_reg_stats(struct hazprof_t *hp,	/* hazard profiler */
+		  struct stat_sdb_t *sdb,/* stats database */
+		  char *name);		/* profiler name, stats are <name>.* */
+
+/* profile instruction OP, which reads IN1-IN3 and writes OUT1-OUT2; the
+   registers are dependence indices, DNA or $r0 (0) if unused */
+void
+hazprof_inst(struct hazprof_t *hp,	/* hazard profiler */
+	     enum md_opcode op,		/* instruction opcode */
+	     int out1, int out2,	/* output dependences */
+	     int in1, int in2, int in3);/* input dependences */
+
+#endif /* HAZPROF_H */
@@ -59,6 +59,7 @@
 #ifndef _MSC_VER
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #endif
 #ifdef BFD_LOADER
 #include <bfd.h>
@@ -72,6 +73,12 @@
 #include "options.h"
 #include "stats.h"
 #include "loader.h"
+#include "sweep.h"
+#include "interval.h"
+#include "syscall.h"
+#include "vfs.h"
+#include "eio.h"
+#include "hostprof.h"
 #include "sim.h"
 
 /* stats signal handler */
@@ -91,6 +98,9 @@ signal_exit_now(int sigtype)
 /* execution instruction counter */
 counter_t sim_num_insn = 0;
 
+/* instruction count the run was restored at */
+counter_t sim_insn_base = 0;
+
 #if 0 /* not portable... :-( */
 /* total simulator (data) memory usage */
 unsigned int sim_mem_usage = 0;
@@ -101,6 +111,35 @@ time_t sim_start_time;
 time_t sim_end_time;
 int sim_elapsed_time;
 
+/* execution wall clock time in seconds, from a high-resolution clock */
+double sim_wall_time;
+static double sim_wall_start;
+
+/* peak simulator resident set size, in kilobytes */
+unsigned int sim_peak_rss = 0;
+
+/* current reading of a monotonic high-resolution clock, in seconds */
+static double
+wall_clock(void)
+{
+#if defined(CLOCK_MONOTONIC) && !defined(_MSC_VER)
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+#ifndef _MSC_VER
+  {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+  }
+#else
+  return (double)time((time_t *)NULL);
+#endif
+}
+
 /* byte/word swapping required to execute target executable on this host */
 int sim_swap_bytes;
 int sim_swap_words;
@@ -125,11 +164,22 @@ char *sim_eio_fname = NULL;
 char *sim_chkpt_fname = NULL;
 FILE *sim_eio_fd = NULL;
 
+/* EIO trace being recorded, and where to start replaying one */
+char *sim_trace_fname = NULL;
+FILE *sim_trace_fd = NULL;
+unsigned int sim_eio_start = 0;
+
 /* redirected program/simulator output file names */
 static char *sim_simout = NULL;
 static char *sim_progout = NULL;
 FILE *sim_progfd = NULL;
 
+/* simulated program output buffer size, 0 for unbuffered */
+static int sim_progbuf;
+
+/* directory preloaded into the in-memory file system, NULL for none */
+static char *sim_vfs_dir = NULL;
+
 /* track first argument orphan, this is the program to execute */
 static int exec_index = -1;
 
@@ -150,6 +200,29 @@ static int nice_priority;
 /* default simulator scheduling priority */
 #define NICE_DEFAULT_VALUE		0
 
+/* parameter sweep grid axes, number of axes, concurrency and output prefix */
+static char *sweep_grid[SWEEP_MAX_AXES];
+static int sweep_ngrid = 0;
+static int sweep_jobs;
+static char *sweep_prefix;
+
+/* parameter sweep of a worker, NULL if this is not one, the job it runs and
+   the stats of the other configurations of its job */
+static struct sweep_t *sweep = NULL;
+static int sweep_job;
+static struct stat_sdb_t **sweep_sdb = NULL;
+
+/* trace interval count, length, warm-up, concurrency, check and prefix */
+static int interval_count;
+static unsigned int interval_insts;
+static unsigned int interval_warmup;
+static int interval_jobs;
+static int interval_check;
+static char *interval_prefix;
+
+/* interval simulation, NULL if the trace is simulated in one run */
+static struct interval_t *interval = NULL;
+
 static int
 orphan_fn(int i, int argc, char **argv)
 {
@@ -194,9 +267,33 @@ sim_print_stats(FILE *fd)		/* output stream */
   if (!running)
     return;
 
+  /* program output is complete before the stats follow it */
+  sys_flush_output();
+
+  /* files the program wrote in memory go back to the host */
+  vfs_sync();
+
   /* get stats time */
   sim_end_time = time((time_t *)NULL);
   sim_elapsed_time = MAX(sim_end_time - sim_start_time, 1);
+  sim_wall_time = MAX(wall_clock() - sim_wall_start, 1e-6);
+#ifdef HOST_PROFILE
+  hostprof_stop();
+#endif
+
+#ifndef _MSC_VER
+  {
+    struct rusage ru;
+
+    /* ru_maxrss is in kilobytes on Linux, in bytes on Darwin */
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+#ifdef __APPLE__
+      sim_peak_rss = ru.ru_maxrss / 1024;
+#else
+      sim_peak_rss = ru.ru_maxrss;
+#endif
+  }
+#endif
 
 #if 0 /* not portable... :-( */
   /* compute simulator memory usage */
@@ -207,15 +304,107 @@ sim_print_stats(FILE *fd)		/* output stream */
   fprintf(fd, "\nsim: ** simulation statistics **\n");
   stat_print_stats(sim_sdb, fd);
   sim_aux_stats(fd);
+#ifdef HOST_PROFILE
+  hostprof_print_funcs(fd);
+#endif
   fprintf(fd, "\n");
 }
 
+/* lower the scheduling priority of the simulator to `-nice', if it is not
+   that low already */
+static void
+set_nice_priority(void)
+{
+#ifndef _MSC_VER
+  if (nice(0) < nice_priority)
+    {
+      if (nice(nice_priority - nice(0)) < 0)
+	fatal("could not renice simulator process");
+    }
+#endif
+}
+
+/* print the stats of the other configurations of a shared sweep job, each
+   to the simulator output of its own configuration */
+static void
+print_job_stats(void)
+{
+  int i, run;
+  char *fname;
+  FILE *fd;
+
+  if (!running || sweep == NULL)
+    return;
+
+  for (i=1; i < sweep_job_nruns(sweep, sweep_job); i++)
+    {
+      run = sweep_job_run(sweep, sweep_job, i);
+      fname = sweep_fname(sweep, run, "simout");
+      fd = fopen(fname, "w");
+      if (!fd)
+	{
+	  warn("unable to write sweep output `%s'", fname);
+	  free(fname);
+	  continue;
+	}
+
+      sweep_apply(sweep, sim_odb, run);
+      fprintf(fd, "sim: run %d shared the functional execution of run %d, "
+	      "options follow:\n", run, sweep_job_run(sweep, sweep_job, 0));
+      opt_print_options(sim_odb, fd, /* short */TRUE, /* notes */TRUE);
+      fprintf(fd, "\nsim: ** simulation statistics **\n");
+      stat_print_stats(sweep_sdb[i], fd);
+      fprintf(fd, "\n");
+
+      fclose(fd);
+      free(fname);
+    }
+}
+
+/* register all stats of the simulator and its components in SDB */
+static void
+reg_all_stats(struct stat_sdb_t *sdb)	/* stats database */
+{
+  sim_reg_stats(sdb);
+  sys_reg_stats(sdb);
+  vfs_reg_stats(sdb);
+  stat_reg_counter(sdb, "sim_insn_base",
+		   "instructions executed before the restored checkpoint",
+		   &sim_insn_base, sim_insn_base, NULL);
+  stat_reg_double(sdb, "sim_wall_time",
+		  "total simulation time in seconds, from a monotonic clock",
+		  &sim_wall_time, 0.0, "%12.6f");
+  stat_reg_formula(sdb, "sim_mips",
+		   "simulation speed (in millions of insts/sec)",
+		   "(sim_num_insn - sim_insn_base) / (sim_wall_time * 1000000)",
+		   "%12.4f");
+  stat_reg_uint(sdb, "sim_peak_rss",
+		"peak simulator resident set size",
+		&sim_peak_rss, 0, "%11uk");
+#ifdef HOST_PROFILE
+  hostprof_reg_stats(sdb);
+#endif
+#if 0 /* not portable... :-( */
+  stat_reg_uint(sdb, "sim_mem_usage",
+		"total simulator (data) memory usage",
+		&sim_mem_usage, sim_mem_usage, "%11dk");
+#endif
+}
+
 /* print stats, uninitialize simulator components, and exit w/ exitcode */
 static void
 exit_now(int exit_code)
 {
   /* print simulation stats */
   sim_print_stats(stderr);
+  print_job_stats();
+
+  /* the EIO trace being recorded ends here */
+  if (sim_trace_fd != NULL)
+    {
+      eio_close(sim_trace_fd);
+      sim_trace_fd = NULL;
+    }
 
   /* un-initialize the simulator */
   sim_uninit();
@@ -266,6 +455,22 @@ main(int argc, char **argv, char **envp)
   opt_reg_string(sim_odb, "-chkpt", "restore EIO trace execution from <fname>",
 		 &sim_chkpt_fname, /* default */NULL, /* !print */FALSE, NULL);
 
+  /* EIO trace options */
+  opt_reg_string(sim_odb, "-eio:trace",
+		 "record an EIO trace of the program's execution to <fname>",
+		 &sim_trace_fname, /* default */NULL, /* !print */FALSE, NULL);
+  opt_reg_flag(sim_odb, "-eio:binary",
+	       "write EIO traces in the binary EXO encoding",
+	       &eio_binary, /* default */FALSE, /* print */TRUE, NULL);
+  opt_reg_uint(sim_odb, "-eio:interval",
+	       "instructions between checkpoints embedded in binary EIO"
+	       " traces (0 for none)",
+	       &eio_chkpt_interval, /* default */0, /* print */TRUE, NULL);
+  opt_reg_uint(sim_odb, "-eio:start",
+	       "restore the last embedded checkpoint of the EIO trace at or"
+	       " before this instruction (0 for the start)",
+	       &sim_eio_start, /* default */0, /* print */TRUE, NULL);
+
   /* stdio redirection options */
   opt_reg_string(sim_odb, "-redir:sim",
 		 "redirect simulator output to file (non-interactive only)",
@@ -274,6 +479,14 @@ main(int argc, char **argv, char **envp)
   opt_reg_string(sim_odb, "-redir:prog",
 		 "redirect simulated program output to file",
 		 &sim_progout, /* default */NULL, /* !print */FALSE, NULL);
+  opt_reg_int(sim_odb, "-redir:progbuf",
+	      "simulated program output buffer size, in bytes (0 for none)",
+	      &sim_progbuf, /* default */4096, /* print */TRUE, NULL);
+
+  /* in-memory file system options */
+  opt_reg_string(sim_odb, "-vfs:preload",
+		 "serve simulated program files from this directory in memory",
+		 &sim_vfs_dir, /* default */NULL, /* print */TRUE, NULL);
 
 #ifndef _MSC_VER
   /* scheduling priority option */
@@ -282,6 +495,47 @@ main(int argc, char **argv, char **envp)
 	      /* default */NICE_DEFAULT_VALUE, /* print */TRUE, NULL);
 #endif
 
+#ifdef HOST_PROFILE
+  /* simulator self-profiling options */
+  hostprof_reg_options(sim_odb);
+#endif
+
+  /* parameter sweep options */
+  opt_reg_string_list(sim_odb, "-sweep:grid",
+		      "sweep option grid, <option>=<val>{,<val>} per axis "
+		      "(option w/o `-')",
+		      sweep_grid, SWEEP_MAX_AXES, &sweep_ngrid, /* default */NULL,
+		      /* !print */FALSE, NULL, /* !accrue */FALSE);
+  opt_reg_int(sim_odb, "-sweep:jobs",
+	      "maximum concurrent sweep runs (0 for one per host CPU)",
+	      &sweep_jobs, /* default */0, /* !print */FALSE, NULL);
+  opt_reg_string(sim_odb, "-sweep:out",
+		 "sweep output file prefix, runs write <prefix>.<run>.simout",
+		 &sweep_prefix, /* default */"sweep", /* !print */FALSE, NULL);
+
+  /* parallel trace interval options */
+  opt_reg_int(sim_odb, "-interval:count",
+	      "simulate an EIO trace as this many concurrent intervals "
+	      "(0 for one serial run)",
+	      &interval_count, /* default */0, /* !print */FALSE, NULL);
+  opt_reg_uint(sim_odb, "-interval:insts",
+	       "instructions to split into intervals (0 for the whole trace)",
+	       &interval_insts, /* default */0, /* !print */FALSE, NULL);
+  opt_reg_uint(sim_odb, "-interval:warmup",
+	       "minimum instructions simulated before each interval",
+	       &interval_warmup, /* default */1000000, /* !print */FALSE, NULL);
+  opt_reg_int(sim_odb, "-interval:jobs",
+	      "maximum concurrent interval runs (0 for one per host CPU)",
+	      &interval_jobs, /* default */0, /* !print */FALSE, NULL);
+  opt_reg_flag(sim_odb, "-interval:check",
+	       "also simulate the trace serially and report the stitching "
+	       "error",
+	       &interval_check, /* default */FALSE, /* !print */FALSE, NULL);
+  opt_reg_string(sim_odb, "-interval:out",
+		 "interval output file prefix, runs write <prefix>.<run>.simout",
+		 &interval_prefix, /* default */"interval", /* !print */FALSE,
+		 NULL);
+
   /* FIXME: add stats intervals and max insts... */
 
   /* register all simulator-specific options */
@@ -291,6 +545,70 @@ main(int argc, char **argv, char **envp)
   exec_index = -1;
   opt_process_options(sim_odb, argc, argv);
 
+  /* only binary traces can be repositioned to their checkpoints */
+  if (eio_chkpt_interval != 0 && !eio_binary)
+    fatal("`-eio:interval' needs `-eio:binary', text traces cannot seek");
+
+  /* parameter sweep? */
+  if (sweep_ngrid > 0)
+    {
+      int run;
+
+      sweep = sweep_new(sim_odb, sweep_grid, sweep_ngrid, sweep_prefix);
+
+      /* renice the driver once, the workers inherit its priority */
+      set_nice_priority();
+
+      sweep_job = sweep_launch(sweep, sweep_jobs);
+      if (sweep_job < 0)
+	{
+	  /* driver, all runs are done */
+	  sweep_merge(sweep);
+	  exit(0);
+	}
+
+      /* worker, override the swept options of the first configuration of
+	 its job and the output files */
+      run = sweep_job_run(sweep, sweep_job, 0);
+      sweep_apply(sweep, sim_odb, run);
+      sim_simout = sweep_fname(sweep, run, "simout");
+      sim_progout = sweep_fname(sweep, run, "progout");
+    }
+
+  /* parallel trace intervals? */
+  if (interval_count > 0)
+    {
+      int run;
+      counter_t length;
+
+      if (sweep_ngrid > 0)
+	fatal("`-interval:count' cannot be combined with `-sweep:grid'");
+      if (exec_index == -1 || !eio_valid(argv[exec_index]))
+	fatal("`-interval:count' needs an EIO trace to simulate");
+      if (!opt_find_option(sim_odb, "-max:inst"))
+	fatal("this simulator has no `-max:inst' option to end intervals");
+
+      length = interval_insts;
+      if (length == 0)
+	length = eio_last_icnt(argv[exec_index]);
+      interval = interval_new(interval_count, length, interval_warmup,
+			      interval_check, interval_prefix);
+
+      /* renice the driver once, the workers inherit its priority */
+      set_nice_priority();
+
+      run = interval_launch(interval, interval_jobs);
+      if (run >= 0)
+	{
+	  /* worker, set its start and stop points and the output files */
+	  interval_apply(interval, sim_odb, run);
+	  sim_simout = interval_fname(interval, run, "simout");
+	  sim_progout = interval_fname(interval, run, "progout");
+	  interval = NULL;
+	}
+      /* else, driver, it prints the stitched stats of all runs */
+    }
+
   /* redirect I/O? */
   if (sim_simout != NULL)
     {
@@ -307,6 +625,11 @@ main(int argc, char **argv, char **envp)
       if (!sim_progfd)
 	fatal("unable to redirect program output to file `%s'", sim_progout);
     }
+  sys_output_init(sim_progbuf);
+
+  /* load program input files before the run, so it does no file I/O */
+  if (sim_vfs_dir != NULL)
+    vfs_init(sim_vfs_dir);
 
   /* need at least two argv values to run */
   if (argc < 2)
@@ -351,14 +674,8 @@ main(int argc, char **argv, char **envp)
   /* check simulator-specific options */
   sim_check_options(sim_odb, argc, argv);
 
-#ifndef _MSC_VER
   /* set simulator scheduling priority */
-  if (nice(0) < nice_priority)
-    {
-      if (nice(nice_priority - nice(0)) < 0)
-        fatal("could not renice simulator process");
-    }
-#endif
+  set_nice_priority();
 
   /* default architected value... */
   sim_num_insn = 0;
@@ -377,14 +694,31 @@ main(int argc, char **argv, char **envp)
   /* initialize architected state */
   sim_load_prog(argv[exec_index], argc-exec_index, argv+exec_index, envp);
 
+  /* a sweep worker feeds one passive model per configuration of its job */
+  if (sweep != NULL)
+    sweep_add_models(sweep, sim_odb, sweep_job);
+
   /* register all simulator stats */
   sim_sdb = stat_new();
-  sim_reg_stats(sim_sdb);
-#if 0 /* not portable... :-( */
-  stat_reg_uint(sim_sdb, "sim_mem_usage",
-		"total simulator (data) memory usage",
-		&sim_mem_usage, sim_mem_usage, "%11dk");
-#endif
+  reg_all_stats(sim_sdb);
+
+  /* and the stats of the other configurations of the job, by model */
+  if (sweep != NULL && sweep_job_nruns(sweep, sweep_job) > 1)
+    {
+      int job_run;
+
+      sweep_sdb = (struct stat_sdb_t **)
+	calloc(sweep_job_nruns(sweep, sweep_job), sizeof(struct stat_sdb_t *));
+      if (!sweep_sdb)
+	fatal("out of virtual memory");
+      for (job_run=1; job_run < sweep_job_nruns(sweep, sweep_job); job_run++)
+	{
+	  sweep_select_model(job_run);
+	  sweep_sdb[job_run] = stat_new();
+	  reg_all_stats(sweep_sdb[job_run]);
+	}
+      sweep_select_model(0);
+    }
 
   /* record start of execution time, used in rate stats */
   sim_start_time = time((time_t *)NULL);
@@ -406,10 +740,23 @@ main(int argc, char **argv, char **envp)
 
   /* omit option dump time from rate stats */
   sim_start_time = time((time_t *)NULL);
+  sim_wall_start = wall_clock();
+#ifdef HOST_PROFILE
+  hostprof_start();
+#endif
 
   if (init_quit)
     exit_now(0);
 
+  if (interval != NULL)
+    {
+      /* driver of a parallel trace simulation, all runs are done */
+      interval_stitch(interval, sim_sdb);
+      interval_compare(interval, sim_sdb);
+      running = TRUE;
+      exit_now(0);
+    }
+
   running = TRUE;
   sim_main();
 
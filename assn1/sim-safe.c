@@ -65,41 +65,19 @@
 #include "syscall.h"
 #include "options.h"
 #include "stats.h"
+#include "vprof.h"
+#include "encprof.h"
+#include "hazprof.h"
+#include "hostprof.h"
 #include "sim.h"
 
 
-// this is where we will store our offset counts
-// offsetcounts[N] is a counter for instances of N bits needed
-#define  MAXNUMS  21 
-int offsetcounts[MAXNUMS];
-
 
 // test if general purpose register
 bool isGPR(int R){
 	return R <= 31 && R >= 1;
 }
 
-// determine the offset between two values
-int offset(int x, int y){
-	return (int)(x-y)/8;
-}
-
-// count the number of bits needed to represent a value
-int bitcount(int ofs){
-        if(ofs > 0)  return (int)floor(log(ofs)/log(2.0))+2;
-        if(ofs < 0)  return (int)ceil(log(-ofs)/log(2.0))+1;
-	return -1;
-}
-
-// increment the counter for the offset of the two bits
-void save(int x, int y){ 
-        int ofs = offset(x, y);
-	if(ofs == 0) return;
-
-	int number_of_bits = bitcount(ofs);
-	offsetcounts[number_of_bits]++;
-}
-
 
 // counts the number of bits 
 int count_bits_different(int R1, int R2){
@@ -124,7 +102,6 @@ static counter_t g_total_fimm_branches;
 static counter_t g_total_register_bit_switch;
 static counter_t g_total_register_operations;
 static counter_t g_total_cycles;
-static counter_t g_total_dependency_stalls;
 
 /* simulated registers */
 static struct regs_t regs;
@@ -138,6 +115,35 @@ static counter_t sim_num_refs = 0;
 /* maximum number of inst's to execute */
 static unsigned int max_insts;
 
+/* branch/jump displacement and immediate width profiler */
+static struct encprof_t *encprof = NULL;
+
+/* profile the instruction encoding widths? */
+static int encprof_on;
+
+/* data hazard profiler */
+static struct hazprof_t *hazprof = NULL;
+
+/* profile data hazards? */
+static int hazprof_on;
+
+/* RAW distances tracked by the hazard profiler */
+static int haz_window;
+
+/* result latencies of alu, load, mult, fp and branch producers */
+static int haz_lat[hc_NUM];
+static int haz_nlat = hc_NUM;
+static int haz_lat_def[hc_NUM] = { 1, 2, 1, 1, 1 };
+
+/* register and memory value profiler */
+static struct vprof_t *vprof = NULL;
+
+/* profile register and loaded values? */
+static int vprof_on;
+
+/* value profiler load value table size */
+static int vprof_lv_size;
+
 /* register simulator-specific options */
 void sim_reg_options(struct opt_odb_t *odb)
 {
@@ -154,13 +160,43 @@ void sim_reg_options(struct opt_odb_t *odb)
 			&max_insts, /* default */0,
 			/* print */TRUE, /* format */NULL);
 
+	/* instruction encoding profiler */
+	opt_reg_flag(odb, "-encprof",
+			"profile branch/jump displacement and immediate widths",
+			&encprof_on, /* default */FALSE,
+			/* print */TRUE, /* format */NULL);
+
+	/* hazard profiler, defaults to a five stage pipeline with forwarding */
+	opt_reg_flag(odb, "-hazprof",
+			"profile data hazards and the stalls they imply",
+			&hazprof_on, /* default */FALSE,
+			/* print */TRUE, /* format */NULL);
+	opt_reg_int(odb, "-haz:window",
+			"RAW distances tracked, in instructions",
+			&haz_window, /* default */16,
+			/* print */TRUE, /* format */NULL);
+	opt_reg_int_list(odb, "-haz:lat",
+			"result latency of <alu> <load> <mult> <fp> <branch> producers",
+			haz_lat, hc_NUM, &haz_nlat, haz_lat_def,
+			/* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+	/* value profiler */
+	opt_reg_flag(odb, "-vprof", "profile register and loaded values",
+			&vprof_on, /* default */FALSE,
+			/* print */TRUE, /* format */NULL);
+	opt_reg_int(odb, "-vprof:lvsize",
+			"load value table entries (power of two)",
+			&vprof_lv_size, /* default */4096,
+			/* print */TRUE, /* format */NULL);
+
 }
 
 /* check simulator-specific option values */
 	void
 sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 {
-	/* nada */
+	if (haz_nlat != hc_NUM)
+		fatal("-haz:lat needs a latency for each of the %d producer classes", hc_NUM);
 }
 
 /* register simulator-specific statistics */
@@ -216,15 +252,24 @@ sim_reg_stats(struct stat_sdb_t *sdb)
                         0 /* initial value for the counter */, NULL);
 
 
-        stat_reg_counter(sdb, "sim_num_load_stalls" /* label for printing */,
-                        "total number of stalls due to a load/branch dependency" /*description*/,
-                        &g_total_dependency_stalls /* pointer to the counter */,
-                        0 /* initial value for the counter */, NULL);
+        // the load-use and branch stalls come from the hazard profiler's
+        // scoreboard, so they are only there with -hazprof
+        if (hazprof_on) {
+                stat_reg_formula(sdb, "sim_num_load_stalls" /* label for printing */,
+                                "total number of stalls due to a load-use dependency" /*description*/,
+                                "haz.load.stalls" /* hazard profiler counter */,
+                                "%12.0f");
+
+                stat_reg_formula(sdb, "sim_num_branch_stalls" /* label for printing */,
+                                "total number of stalls waiting on branch results" /*description*/,
+                                "haz.branch.stalls" /* hazard profiler counter */,
+                                "%12.0f");
+        }
 
 
 	stat_reg_formula(sdb, "sim_cond_branch_freq",
 			"relative frequency of conditional branches",
-			"sim_num_cond_branches / sim_num_insn", NULL);
+			"sim_num_cond_branches / (sim_num_insn - sim_insn_base)", NULL);
 
 	stat_reg_counter(sdb, "sim_num_insn",
 			"total number of instructions executed",
@@ -237,9 +282,15 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 			&sim_elapsed_time, 0, NULL);
 	stat_reg_formula(sdb, "sim_inst_rate",
 			"simulation speed (in insts/sec)",
-			"sim_num_insn / sim_elapsed_time", NULL);
+			"(sim_num_insn - sim_insn_base) / sim_elapsed_time", NULL);
 	ld_reg_stats(sdb);
 	mem_reg_stats(mem, sdb);
+	if (vprof_on)
+		vprof_reg_stats(vprof, sdb, "vprof");
+	if (encprof_on)
+		encprof_reg_stats(encprof, sdb, "enc");
+	if (hazprof_on)
+		hazprof_reg_stats(hazprof, sdb, "haz");
 }
 
 /* initialize the simulator */
@@ -251,10 +302,25 @@ sim_init(void)
 	/* allocate and initialize register file */
 	regs_init(&regs);
 
+	/* the host profiler samples the PC of the instruction being simulated */
+	HOSTPROF_GUEST_PC(&regs.regs_PC);
+
 
 	/* allocate and initialize memory space */
 	mem = mem_create("mem");
 	mem_init(mem);
+
+	/* allocate the value profiler */
+	if (vprof_on)
+		vprof = vprof_create(&regs, vprof_lv_size);
+
+	/* allocate the encoding profiler */
+	if (encprof_on)
+		encprof = encprof_create();
+
+	/* allocate the hazard profiler */
+	if (hazprof_on)
+		hazprof = hazprof_create(haz_window, haz_lat);
 }
 
 /* load program into simulated state */
@@ -275,25 +341,9 @@ sim_aux_config(FILE *stream)		/* output stream */
 }
 
 /* dump simulator-specific auxiliary simulator statistics */
-// print the contents of the offset counts array to a file 
 void sim_aux_stats(FILE *stream)		/* output stream */
 {
-        int i = 0;
-        char text[100];
-        time_t now = time(NULL);
-        struct tm *t = localtime(&now);
-        strftime(text, sizeof(text)-1, "out%H-%M.csv", t);
-
-        stream = fopen(text, "w+");
-	
-	fprintf(stream, "Bits, Offset\n");       
- 
-        for(i = 0; i < MAXNUMS - 1;i++){
-              fprintf(stream, "%i, %i\n", i, offsetcounts[i]);
-        }
-
-	fclose(stream); 	 
-	
+	/* nada */
 }
 
 /* un-initialize simulator-specific state */
@@ -417,21 +467,6 @@ void sim_main(void)
 
 	int bits_diff;
 
-	bool load_last_cycle = false;	
-
-	// variables to store the current registers being written to
-        int dst_curr1 = 0;
-        int dst_curr2 = 0;
-
-	// variables to store the register being written to last load cycle
-	int dst_load1 = 0;
-	int dst_load2 = 0;
-
-	// variables to store the current source registers
-        int src1 = 0; 
-        int src2 = 0;
-        int src3 = 0; 
-
 	fprintf(stderr, "nclude <stdbool.h>sim: ** starting functional simulation **\n");
 
 	/* set up initial default next PC */
@@ -441,6 +476,7 @@ void sim_main(void)
 
 	while (TRUE)
 	{
+		HOSTPROF_INSN(hp_decode);
 
 		/* maintain $r0 semantics */
 		regs.regs_R[MD_REG_ZERO] = 0;
@@ -464,10 +500,12 @@ void sim_main(void)
 
 		/* decode the instruction */
 		MD_SET_OPCODE(op, inst);
-	        
-	
+
+		// measure the immediate field widths of the encoding
+		if (encprof_on) encprof_inst(encprof, inst, op, regs.regs_PC);
 
 		/* execute the instruction */
+		HOSTPROF_SWITCH(hp_exec);
 		switch (op)
 		{
 			// when the register is a general purpose register
@@ -476,18 +514,19 @@ void sim_main(void)
 			// then increment the total number of register operations
 			// then set the previous register to be the new register for the next cycle
 
-			// also, save the destination/source registers in our dst and src variables
+			// also, hand the register numbers to the hazard profiler,
+			// and let the value profiler see the old destination values
 #define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)						\
 		        case OP:									\
 			new_reg = O1;									\
-                        dst_curr1 = GPR(O1); dst_curr2 = GPR(O2);                                       		\
-                        src1 = GPR(I1); src2 = GPR(I2); src3 = GPR(I3);					\
 			if( isGPR(new_reg) ) {	 							\
 				bits_diff = count_bits_different(GPR(prv_reg), GPR(new_reg));		\
 				g_total_register_operations++;                            		\
 				g_total_register_bit_switch += bits_diff;             		    	\
                                 prv_reg = new_reg;							\
 			}										\
+			if (hazprof_on) hazprof_inst(hazprof, OP, O1, O2, I1, I2, I3);			\
+			if (vprof_on) vprof_begin(vprof, OP, O1, O2);					\
 			SYMCAT(OP,_IMPL);								\
 			break;
 #define DEFLINK(OP,MSK,NAME,MASK,SHIFT)    								\
@@ -522,37 +561,12 @@ void sim_main(void)
 
 
 
-		// if we go through a load or a branch cycle, save the destination 
-		// registers and mark that this cycle was a load instruction
-		if (MD_OP_FLAGS(op) & F_LOAD || MD_OP_FLAGS(op) & F_CTRL)
-                {
-		    dst_load1 = dst_curr1; 
-		    dst_load2 = dst_curr2;
-		    load_last_cycle = true;
-                }
-                // if we're going through a cycle that isn't a load or a branch but last 
-		// we did a load or branch cycle, then we may have a dependency
-                else if(load_last_cycle)
-                {	
-		    // if either destination register from last cycle is the 
-		    // source register of this cycle, increment the counter
-                    if( dst_load1 == src1 || dst_load1 == src2 || dst_load1 == src3 ||
-		        dst_load2 == src1 || dst_load2 == src2 || dst_load2 == src3 ) g_total_dependency_stalls++;
-                    
-                    // then update the flag to indicate that last cycle wasn't a load or a branch
-                    load_last_cycle = false;
-                }
-             
-                
-
-		// if the operation is a conditional type, save the number 
-		// of bits required to change the offset
-		if (MD_OP_FLAGS(op) & F_COND)   save(CPC, regs.regs_TPC); 
-                
-
 		if (fault != md_fault_none)
 			fatal("fault (%d) detected @ 0x%08p", fault, regs.regs_PC);
 
+		// the value profiler reads the new destination values
+		if (vprof_on) vprof_end(vprof, op, regs.regs_PC);
+
 		if (verbose)
 		{
 			myfprintf(stderr, "%10n [xor: 0x%08x] @ 0x%08p: ",
@@ -580,6 +594,7 @@ void sim_main(void)
 
 		/* finish early? */
 		if (max_insts && sim_num_insn >= max_insts){
+			if (vprof_on) vprof_fold(vprof);
 			// printf("AVERAGE CHANGE: %f", (float)bytes_diff_counter/(float)reg_change_counter);
 			return;
 		} 
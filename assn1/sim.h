@@ -77,11 +77,21 @@ extern int sim_swap_words;
 /* execution instruction counter */
 extern counter_t sim_num_insn;
 
+/* instruction count the run was restored at, its instructions were not
+   simulated, so rates and per-instruction stats leave them out */
+extern counter_t sim_insn_base;
+
 /* execution start/end times */
 extern time_t sim_start_time;
 extern time_t sim_end_time;
 extern int sim_elapsed_time;
 
+/* execution wall clock time in seconds, from a high-resolution clock */
+extern double sim_wall_time;
+
+/* peak simulator resident set size, in kilobytes */
+extern unsigned int sim_peak_rss;
+
 /* options database */
 extern struct opt_odb_t *sim_odb;
 
@@ -93,6 +103,11 @@ extern char *sim_eio_fname;
 extern char *sim_chkpt_fname;
 extern FILE *sim_eio_fd;
 
+/* EIO trace being recorded, and where to start replaying one */
+extern char *sim_trace_fname;
+extern FILE *sim_trace_fd;
+extern unsigned int sim_eio_start;
+
 /* redirected program/simulator output file names */
 extern FILE *sim_progfd;
 
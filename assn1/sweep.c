@@ -0,0 +1,574 @@
+/* sweep.c - parameter sweep driver routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "misc.h"
+#include "options.h"
+#include "sweep.h"
+
+/* passive models of the simulator, NULL if it has none */
+static struct sweep_models_t *sweep_models = NULL;
+
+/* register the passive models of the simulator, before sweep_new() */
+void
+sweep_reg_models(struct sweep_models_t *models)	/* passive models */
+{
+  sweep_models = models;
+}
+
+/* is option NAME one of the passive model options? */
+static int
+passive_option(char *name)
+{
+  char **opt;
+
+  if (!sweep_models)
+    return FALSE;
+  for (opt=sweep_models->opts; *opt != NULL; opt++)
+    {
+      if (!strcmp(*opt, name))
+	return TRUE;
+    }
+  return FALSE;
+}
+
+/* return the value index of axis AXIS in configuration RUN, the last axis
+   varies fastest */
+static int
+axis_index(struct sweep_t *sw, int axis, int run)
+{
+  int i;
+
+  for (i=sw->naxes-1; i > axis; i--)
+    run /= sw->axes[i].nvals;
+  return run % sw->axes[axis].nvals;
+}
+
+/* do configurations RUN1 and RUN2 agree on every option that is not a
+   passive model option? */
+static int
+same_execution(struct sweep_t *sw, int run1, int run2)
+{
+  int i;
+
+  for (i=0; i < sw->naxes; i++)
+    {
+      if (!sw->axes[i].passive
+	  && axis_index(sw, i, run1) != axis_index(sw, i, run2))
+	return FALSE;
+    }
+  return TRUE;
+}
+
+/* group the configurations of SW into jobs of at most MAX configurations
+   that can share one functional execution, in configuration order */
+static void
+sweep_group(struct sweep_t *sw, int max)
+{
+  int run, other, n, *done;
+
+  sw->job_runs = (int *)calloc(sw->nconfigs, sizeof(int));
+  sw->job_first = (int *)calloc(sw->nconfigs, sizeof(int));
+  sw->job_nruns = (int *)calloc(sw->nconfigs, sizeof(int));
+  done = (int *)calloc(sw->nconfigs, sizeof(int));
+  if (!sw->job_runs || !sw->job_first || !sw->job_nruns || !done)
+    fatal("out of virtual memory");
+
+  sw->njobs = 0;
+  for (run=0, n=0; run < sw->nconfigs; run++)
+    {
+      if (done[run])
+	continue;
+
+      sw->job_first[sw->njobs] = n;
+      for (other=run;
+	   other < sw->nconfigs && sw->job_nruns[sw->njobs] < max;
+	   other++)
+	{
+	  if (!done[other] && (other == run || same_execution(sw, run, other)))
+	    {
+	      done[other] = TRUE;
+	      sw->job_runs[n++] = other;
+	      sw->job_nruns[sw->njobs]++;
+	    }
+	}
+      sw->njobs++;
+    }
+  free(done);
+}
+
+/* create a sweep from the grid axis specifications GRID, all option names
+   must already be registered in ODB */
+struct sweep_t *
+sweep_new(struct opt_odb_t *odb,	/* options database */
+	  char **grid,			/* grid axis specifications */
+	  int ngrid,			/* number of grid axes */
+	  char *prefix)			/* output file name prefix */
+{
+  int i, n, npassive;
+  char *s, *p, *name;
+  struct opt_opt_t *opt;
+  struct sweep_t *sw;
+  struct sweep_axis_t *axis;
+
+  if (ngrid > SWEEP_MAX_AXES)
+    fatal("too many sweep axes, maximum is %d", SWEEP_MAX_AXES);
+
+  sw = (struct sweep_t *)calloc(1, sizeof(struct sweep_t));
+  if (!sw)
+    fatal("out of virtual memory");
+  sw->prefix = prefix;
+  sw->naxes = ngrid;
+  sw->nconfigs = 1;
+  npassive = 0;
+
+  for (i=0; i < ngrid; i++)
+    {
+      axis = &sw->axes[i];
+
+      /* split `<option>=<values>', the option name gets its `-' back */
+      s = mystrdup(grid[i]);
+      p = strchr(s, '=');
+      if (!p || p == s || p[1] == '\0')
+	fatal("sweep axis `%s' is not of the form <option>=<val>{,<val>}",
+	      grid[i]);
+      *p++ = '\0';
+      name = (char *)calloc(strlen(s) + 2, sizeof(char));
+      if (!name)
+	fatal("out of virtual memory");
+      name[0] = '-';
+      strcpy(name + 1, s);
+      opt = opt_find_option(odb, name);
+      if (!opt)
+	fatal("sweep axis option `%s' is undefined", name);
+      axis->name = name;
+      axis->is_list = (opt->nelt != NULL);
+      axis->passive = passive_option(name);
+      if (axis->passive)
+	npassive++;
+
+      /* count and split the values */
+      for (n=1, s=p; *s; s++)
+	if (*s == ',')
+	  n++;
+      axis->vals = (char **)calloc(n, sizeof(char *));
+      if (!axis->vals)
+	fatal("out of virtual memory");
+      axis->nvals = 0;
+      for (s=strtok(p, ","); s != NULL; s=strtok(NULL, ","))
+	axis->vals[axis->nvals++] = s;
+      if (axis->nvals == 0)
+	fatal("sweep axis `%s' has no values", grid[i]);
+
+      sw->nconfigs *= axis->nvals;
+    }
+
+  sw->status = (int *)calloc(sw->nconfigs, sizeof(int));
+  if (!sw->status)
+    fatal("out of virtual memory");
+
+  /* grid points that differ only in passive models share an execution */
+  sweep_group(sw, npassive > 0 ? MAX(sweep_models->max, 1) : 1);
+
+  return sw;
+}
+
+/* create a sweep of NRUNS runs without grid axes, for drivers that set up
+   each run themselves */
+struct sweep_t *
+sweep_runs(int nruns,			/* number of runs */
+	   char *prefix)		/* output file name prefix */
+{
+  struct sweep_t *sw;
+
+  sw = (struct sweep_t *)calloc(1, sizeof(struct sweep_t));
+  if (!sw)
+    fatal("out of virtual memory");
+  sw->prefix = prefix;
+  sw->naxes = 0;
+  sw->nconfigs = nruns;
+  sw->status = (int *)calloc(nruns, sizeof(int));
+  if (!sw->status)
+    fatal("out of virtual memory");
+  sweep_group(sw, 1);
+
+  return sw;
+}
+
+/* wait for one worker to exit and record its status, for every run of its
+   job */
+static void
+reap_worker(struct sweep_t *sw, pid_t *pids)
+{
+  int job, i, run, status;
+  pid_t pid;
+
+  pid = wait(&status);
+  if (pid < 0)
+    fatal("lost track of sweep workers");
+
+  for (job=0; job < sw->njobs; job++)
+    {
+      if (pids[job] == pid)
+	break;
+    }
+  if (job == sw->njobs)
+    return;
+
+  if (WIFEXITED(status))
+    status = WEXITSTATUS(status);
+  else
+    status = 128 + WTERMSIG(status);
+  pids[job] = 0;
+
+  for (i=0; i < sw->job_nruns[job]; i++)
+    {
+      run = sweep_job_run(sw, job, i);
+      sw->status[run] = status;
+      fprintf(stderr, "sweep: run %d of %d finished, exit status %d\n",
+	      run, sw->nconfigs, status);
+    }
+}
+
+/* launch all jobs of sweep SW, at most NJOBS at once, returns the job
+   index in a worker, or -1 in the driver after all workers have exited;
+   without shared executions, jobs and configurations are the same */
+int					/* job index, or -1 in driver */
+sweep_launch(struct sweep_t *sw,	/* sweep to launch */
+	     int njobs)			/* max concurrent runs, 0 = host CPUs */
+{
+  int job, nrunning;
+  pid_t pid, *pids;
+
+  if (njobs <= 0)
+    njobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (njobs <= 0)
+    njobs = 1;
+
+  pids = (pid_t *)calloc(sw->njobs, sizeof(pid_t));
+  if (!pids)
+    fatal("out of virtual memory");
+
+  if (sw->njobs != sw->nconfigs)
+    fprintf(stderr, "sweep: %d configurations in %d functional executions, "
+	    "%d concurrent runs\n", sw->nconfigs, sw->njobs, njobs);
+  else
+    fprintf(stderr, "sweep: %d configurations, %d concurrent runs\n",
+	    sw->nconfigs, njobs);
+
+  /* don't let the workers inherit unflushed output */
+  fflush(stdout);
+  fflush(stderr);
+
+  nrunning = 0;
+  for (job=0; job < sw->njobs; job++)
+    {
+      while (nrunning >= njobs)
+	{
+	  reap_worker(sw, pids);
+	  nrunning--;
+	}
+
+      pid = fork();
+      if (pid < 0)
+	fatal("could not fork sweep worker for job %d", job);
+      if (pid == 0)
+	{
+	  /* worker, carry on with job JOB */
+	  free(pids);
+	  return job;
+	}
+      pids[job] = pid;
+      nrunning++;
+    }
+
+  while (nrunning > 0)
+    {
+      reap_worker(sw, pids);
+      nrunning--;
+    }
+
+  free(pids);
+  return -1;
+}
+
+/* return the number of configurations job JOB runs */
+int
+sweep_job_nruns(struct sweep_t *sw,	/* sweep definition */
+		int job)		/* job index */
+{
+  return sw->job_nruns[job];
+}
+
+/* return the configuration index of run I of job JOB */
+int
+sweep_job_run(struct sweep_t *sw,	/* sweep definition */
+	      int job,			/* job index */
+	      int i)			/* run of the job */
+{
+  return sw->job_runs[sw->job_first[job] + i];
+}
+
+/* attach one passive model instance per configuration of job JOB, each
+   configured with the options of its configuration, and leave the options
+   of the first configuration applied; does nothing without passive models */
+void
+sweep_add_models(struct sweep_t *sw,	/* sweep definition */
+		 struct opt_odb_t *odb,	/* options database */
+		 int job)		/* job index */
+{
+  int i;
+
+  if (!sweep_models)
+    return;
+
+  for (i=0; i < sw->job_nruns[job]; i++)
+    {
+      sweep_apply(sw, odb, sweep_job_run(sw, job, i));
+      sweep_models->add();
+    }
+  sweep_apply(sw, odb, sweep_job_run(sw, job, 0));
+}
+
+/* make the model instance of run I of the current job the one whose stats
+   sim_reg_stats() registers */
+void
+sweep_select_model(int i)		/* run of the job */
+{
+  if (sweep_models)
+    sweep_models->select(i);
+}
+
+/* apply the option overrides of configuration RUN to options database ODB */
+void
+sweep_apply(struct sweep_t *sw,		/* sweep definition */
+	    struct opt_odb_t *odb,	/* options database */
+	    int run)			/* configuration index */
+{
+  int i, largc, maxargs;
+  char *s, *val, **largv;
+
+  /* one word per option name, and per value or list element */
+  maxargs = 1;
+  for (i=0; i < sw->naxes; i++)
+    maxargs += 1 + strlen(sw->axes[i].vals[axis_index(sw, i, run)]);
+  largv = (char **)calloc(maxargs, sizeof(char *));
+  if (!largv)
+    fatal("out of virtual memory");
+
+  /* marshall an option array, opt_process_options() skips argv[0] */
+  largc = 0;
+  largv[largc++] = "sweep";
+  for (i=0; i < sw->naxes; i++)
+    {
+      val = sw->axes[i].vals[axis_index(sw, i, run)];
+      largv[largc++] = sw->axes[i].name;
+      if (!sw->axes[i].is_list)
+	{
+	  largv[largc++] = val;
+	  continue;
+	}
+
+      /* list options take their elements as separate arguments */
+      val = mystrdup(val);
+      for (s=strtok(val, " \t"); s != NULL; s=strtok(NULL, " \t"))
+	largv[largc++] = s;
+    }
+  opt_process_options(odb, largc, largv);
+  free(largv);
+}
+
+/* return the output file name of configuration RUN, with extension EXT */
+char *
+sweep_fname(struct sweep_t *sw,		/* sweep definition */
+	    int run,			/* configuration index */
+	    char *ext)			/* file name extension */
+{
+  char buf[1024];
+
+  sprintf(buf, "%.900s.%03d.%s", sw->prefix, run, ext);
+  return mystrdup(buf);
+}
+
+/* merged statistics table, stat names in order of first appearance */
+struct merge_t {
+  int nstats;			/* number of distinct stat names */
+  int maxstats;			/* allocated name slots */
+  char **names;			/* stat names */
+  char ***vals;			/* vals[run][stat], NULL if not reported */
+};
+
+/* locate stat NAME in the merged table, adding it if needed */
+static int
+merge_stat(struct merge_t *m, int nruns, char *name)
+{
+  int i;
+
+  for (i=0; i < m->nstats; i++)
+    {
+      if (!strcmp(m->names[i], name))
+	return i;
+    }
+
+  if (m->nstats == m->maxstats)
+    {
+      m->maxstats = m->maxstats ? 2*m->maxstats : 64;
+      m->names = (char **)realloc(m->names, m->maxstats * sizeof(char *));
+      if (!m->names)
+	fatal("out of virtual memory");
+      for (i=0; i < nruns; i++)
+	{
+	  m->vals[i] =
+	    (char **)realloc(m->vals[i], m->maxstats * sizeof(char *));
+	  if (!m->vals[i])
+	    fatal("out of virtual memory");
+	  memset(m->vals[i] + m->nstats, 0,
+		 (m->maxstats - m->nstats) * sizeof(char *));
+	}
+    }
+  m->names[m->nstats] = mystrdup(name);
+  return m->nstats++;
+}
+
+/* read the scalar statistics of run RUN from its simulator output */
+static void
+merge_run(struct sweep_t *sw, struct merge_t *m, int run)
+{
+  int in_stats, i;
+  char line[1024], *fname, *name, *val, *hash;
+  FILE *fd;
+
+  fname = sweep_fname(sw, run, "simout");
+  fd = fopen(fname, "r");
+  if (!fd)
+    {
+      warn("could not open sweep output `%s'", fname);
+      free(fname);
+      return;
+    }
+
+  in_stats = FALSE;
+  while (fgets(line, sizeof(line), fd))
+    {
+      if (!in_stats)
+	{
+	  if (strstr(line, "** simulation statistics **"))
+	    in_stats = TRUE;
+	  continue;
+	}
+
+      /* scalar stats print as `<name> <value> # <description>' */
+      name = strtok(line, " \t\n");
+      val = strtok(NULL, " \t\n");
+      hash = strtok(NULL, " \t\n");
+      if (!name || !val || !hash || strcmp(hash, "#") != 0)
+	continue;
+
+      /* merge_stat() may grow the rows, so look the column up first */
+      i = merge_stat(m, sw->nconfigs, name);
+      m->vals[run][i] = mystrdup(val);
+    }
+
+  fclose(fd);
+  free(fname);
+}
+
+/* merge the statistics of all sweep runs into one table, one row per run */
+void
+sweep_merge(struct sweep_t *sw)		/* sweep definition */
+{
+  int run, i;
+  char fname[1024];
+  struct merge_t m;
+  FILE *fd;
+
+  m.nstats = m.maxstats = 0;
+  m.names = NULL;
+  m.vals = (char ***)calloc(sw->nconfigs, sizeof(char **));
+  if (!m.vals)
+    fatal("out of virtual memory");
+
+  for (run=0; run < sw->nconfigs; run++)
+    merge_run(sw, &m, run);
+
+  sprintf(fname, "%.1000s.csv", sw->prefix);
+  fd = fopen(fname, "w");
+  if (!fd)
+    fatal("could not open sweep table `%s'", fname);
+
+  /* header: run number, exit status, swept options, then all stats */
+  fprintf(fd, "run,status");
+  for (i=0; i < sw->naxes; i++)
+    fprintf(fd, ",%s", sw->axes[i].name + 1);
+  for (i=0; i < m.nstats; i++)
+    fprintf(fd, ",%s", m.names[i]);
+  fprintf(fd, "\n");
+
+  for (run=0; run < sw->nconfigs; run++)
+    {
+      fprintf(fd, "%d,%d", run, sw->status[run]);
+      for (i=0; i < sw->naxes; i++)
+	fprintf(fd, ",%s", sw->axes[i].vals[axis_index(sw, i, run)]);
+      for (i=0; i < m.nstats; i++)
+	fprintf(fd, ",%s", m.vals[run][i] ? m.vals[run][i] : "");
+      fprintf(fd, "\n");
+    }
+
+  fclose(fd);
+  fprintf(stderr, "sweep: merged %d runs into `%s'\n", sw->nconfigs, fname);
+}
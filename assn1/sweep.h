@@ -0,0 +1,188 @@
+/* sweep.h - parameter sweep driver interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "options.h"
+
+/*
+ * The sweep package runs one simulator command line over a grid of option
+ * values.  Each grid axis is given as `<option>=<val>{,<val>}', with the
+ * leading `-' of the option name dropped, e.g., `max:inst=1000,2000'.  The
+ * elements of a list option value are separated by blanks, so an axis over
+ * a list option is quoted, e.g., `haz:lat=1 2 1 1 1,1 3 1 1 1'.  The
+ * driver forks one worker per configuration, at most NJOBS at a time; each
+ * worker returns from sweep_launch() with its configuration index, applies
+ * its option overrides and then runs as an ordinary simulation that writes
+ * `<prefix>.<run>.simout' and `<prefix>.<run>.progout'.  Once all workers
+ * have exited, the driver merges their statistics into `<prefix>.csv'.
+ *
+ * A simulator whose passive models (caches, predictors, ...) only watch the
+ * functional core can register them with sweep_reg_models().  Grid points
+ * that differ only in the options of those models then share one worker,
+ * and so one functional execution: the worker attaches one model instance
+ * per grid point with sweep_add_models(), and writes one simout per grid
+ * point, each with the stats of its own model instance.
+ *
+ * NOTE: workers share the driver's standard input, so programs that read
+ * stdin should be given their input through a file argument instead.  The
+ * grid points of a shared worker write their program output once, to the
+ * progout of the first of them.
+ */
+
+/* maximum number of grid axes */
+#define SWEEP_MAX_AXES		16
+
+/* one grid axis, an option and the values it sweeps over */
+struct sweep_axis_t {
+  char *name;			/* option name, e.g., "-max:inst" */
+  int is_list;			/* list option, values hold blank-separated
+				   elements */
+  int passive;			/* configures a passive model? */
+  int nvals;			/* number of values */
+  char **vals;			/* option values */
+};
+
+/* parameter sweep definition */
+struct sweep_t {
+  char *prefix;			/* output file name prefix */
+  int naxes;			/* number of grid axes */
+  struct sweep_axis_t axes[SWEEP_MAX_AXES];
+  int nconfigs;			/* total configurations in the grid */
+  int *status;			/* exit status of each run */
+  int njobs;			/* worker processes, one per job */
+  int *job_runs;		/* configurations, in job order */
+  int *job_first;		/* first configuration of each job in JOB_RUNS */
+  int *job_nruns;		/* number of configurations of each job */
+};
+
+/* passive models of a simulator, grid points that differ only in their
+   options share one functional execution */
+struct sweep_models_t {
+  char **opts;			/* option names, NULL terminated */
+  int max;			/* most instances one execution can feed */
+  void (*add)(void);		/* attach one more instance, configured from
+				   the current option values */
+  void (*select)(int inst);	/* instance whose stats sim_reg_stats()
+				   registers, 0 by default */
+};
+
+/* register the passive models of the simulator, before sweep_new() */
+void
+sweep_reg_models(struct sweep_models_t *models);	/* passive models */
+
+/* create a sweep from the grid axis specifications GRID, all option names
+   must already be registered in ODB */
+struct sweep_t *
+sweep_new(struct opt_odb_t *odb,	/* options database */
+	  char **grid,			/* grid axis specifications */
+	  int ngrid,			/* number of grid axes */
+	  char *prefix);		/* output file name prefix */
+
+/* create a sweep of NRUNS runs without grid axes, for drivers that set up
+   each run themselves */
+struct sweep_t *
+sweep_runs(int nruns,			/* number of runs */
+	   char *prefix);		/* output file name prefix */
+
+/* launch all jobs of sweep SW, at most NJOBS at once, returns the job
+   index in a worker, or -1 in the driver after all workers have exited;
+   without shared executions, jobs and configurations are the same */
+int					/* job index, or -1 in driver */
+sweep_launch(struct sweep_t *sw,	/* sweep to launch */
+	     int njobs);		/* max concurrent runs, 0 = host CPUs */
+
+/* return the number of configurations job JOB runs */
+int
+sweep_job_nruns(struct sweep_t *sw,	/* sweep definition */
+		int job);		/* job index */
+
+/* return the configuration index of run I of job JOB */
+int
+sweep_job_run(struct sweep_t *sw,	/* sweep definition */
+	      int job,			/* job index */
+	      int i);			/* run of the job */
+
+/* attach one passive model instance per configuration of job JOB, each
+   configured with the options of its configuration, and leave the options
+   of the first configuration applied; does nothing without passive models */
+void
+sweep_add_models(struct sweep_t *sw,	/* sweep definition */
+		 struct opt_odb_t *odb,	/* options database */
+		 int job);		/* job index */
+
+/* make the model instance of run I of the current job the one whose stats
+   sim_reg_stats() registers */
+void
+sweep_select_model(int i);		/* run of the job */
+
+/* apply the option overrides of configuration RUN to options database ODB */
+void
+sweep_apply(struct sweep_t *sw,		/* sweep definition */
+	    struct opt_odb_t *odb,	/* options database */
+	    int run);			/* configuration index */
+
+/* return the output file name of configuration RUN, with extension EXT */
+char *
+sweep_fname(struct sweep_t *sw,		/* sweep definition */
+	    int run,			/* configuration index */
+	    char *ext);			/* file name extension */
+
+/* merge the statistics of all sweep runs into one table, one row per run */
+void
+sweep_merge(struct sweep_t *sw);	/* sweep definition */
+
+#endif /* SWEEP_H */
@@ -0,0 +1,332 @@
+/* vprof.c - register and memory value profiler routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "regs.h"
+#include "stats.h"
+#include "vprof.h"
+
+#if !defined(TARGET_PISA)
+#error The value profiler only supports the PISA target...
+#endif
+
+/* miscellaneous register dependence indices, as decoded by DHI/DLO/DFCC */
+#define VPROF_REG_HI		(0+32+32)
+#define VPROF_REG_LO		(1+32+32)
+#define VPROF_REG_FCC		(2+32+32)
+
+/* register names, for the by-register distribution */
+static char *vprof_regnames[VPROF_NUM_REGS];
+
+/* read register dependence index REG, FP registers are read as pairs */
+static qword_t
+vprof_read(struct regs_t *regs, int reg)
+{
+  if (reg < 32)
+    return (word_t)regs->regs_R[reg];
+  else if (reg < 64)
+    return ((((qword_t)(word_t)regs->regs_F.l[reg - 32 + 1]) << 32)
+	    | (word_t)regs->regs_F.l[reg - 32]);
+  else if (reg == VPROF_REG_HI)
+    return (word_t)regs->regs_C.hi;
+  else if (reg == VPROF_REG_LO)
+    return (word_t)regs->regs_C.lo;
+  else /* reg == VPROF_REG_FCC */
+    return (word_t)regs->regs_C.fcc;
+}
+
+/* bits set in X, without the popcount instruction the host compiler may
+   not be allowed to use */
+static int
+vprof_popcount(qword_t x)
+{
+  x = x - ((x >> 1) & ULL(0x5555555555555555));
+  x = (x & ULL(0x3333333333333333)) + ((x >> 2) & ULL(0x3333333333333333));
+  x = (x + (x >> 4)) & ULL(0x0f0f0f0f0f0f0f0f);
+  return (int)((x * ULL(0x0101010101010101)) >> 56);
+}
+
+/* bits needed to hold V as a signed value, 0 for zero */
+static int
+vprof_width(sword_t v)
+{
+  sword_t x = v ^ (v >> 31);
+
+  if (x == 0)
+    return (v != 0);
+  return 33 - __builtin_clz((word_t)x);
+}
+
+/* create a value profiler for register file REGS, with an LV_SIZE entry
+   load value table, LV_SIZE must be a power-of-two */
+struct vprof_t *
+vprof_create(struct regs_t *regs,	/* register file to profile */
+	     int lv_size)		/* load value table entries */
+{
+  struct vprof_t *vp;
+
+  if (lv_size <= 0 || (lv_size & (lv_size - 1)) != 0)
+    fatal("load value table size `%d' must be a power of two", lv_size);
+
+  vp = (struct vprof_t *)calloc(1, sizeof(struct vprof_t));
+  if (!vp)
+    fatal("out of virtual memory");
+  vp->regs = regs;
+
+  vp->lv_size = lv_size;
+  vp->lv_tag = (md_addr_t *)calloc(lv_size, sizeof(md_addr_t));
+  vp->lv_val = (qword_t *)calloc(lv_size, sizeof(qword_t));
+  if (!vp->lv_tag || !vp->lv_val)
+    fatal("out of virtual memory");
+
+  return vp;
+}
+
+/* register value profiler statistics */
+void
+vprof_reg_stats(struct vprof_t *vp,	/* value profiler */
+		struct stat_sdb_t *sdb,	/* stats database */
+		char *name)		/* profiler name, stats are <name>.* */
+{
+  int i;
+  char buf[512], buf1[512];
+
+  for (i = 0; i < VPROF_NUM_REGS; i++)
+    {
+      if (i < 32)
+	sprintf(buf, "r%d", i);
+      else if (i < 64)
+	sprintf(buf, "f%d", i - 32);
+      else
+	sprintf(buf, "%s", i == VPROF_REG_HI ? "hi"
+		: i == VPROF_REG_LO ? "lo" : "fcc");
+      vprof_regnames[i] = mystrdup(buf);
+    }
+
+  sprintf(buf, "%s.writes", name);
+  stat_reg_counter(sdb, mystrdup(buf), "total number of register writes",
+		   &vp->writes, 0, NULL);
+  sprintf(buf, "%s.toggles", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of register bits switched",
+		   &vp->toggles, 0, NULL);
+  sprintf(buf, "%s.toggles_per_write", name);
+  sprintf(buf1, "%s.toggles / %s.writes", name, name);
+  stat_reg_formula(sdb, mystrdup(buf),
+		   "average register bits switched per write",
+		   mystrdup(buf1), NULL);
+  sprintf(buf, "%s.toggle_bits", name);
+  vp->toggle_dist =
+    stat_reg_dist(sdb, mystrdup(buf),
+		  "register bits switched per write",
+		  /* initial value */0, /* array size */64 + 1,
+		  /* bucket size */1, PF_COUNT|PF_PDF,
+		  /* format */NULL, /* index map */NULL, /* print fn */NULL);
+  sprintf(buf, "%s.reg_toggles", name);
+  vp->reg_dist =
+    stat_reg_dist(sdb, mystrdup(buf),
+		  "register bits switched, by register",
+		  /* initial value */0, /* array size */VPROF_NUM_REGS,
+		  /* bucket size */1, PF_COUNT|PF_PDF,
+		  /* format */NULL, vprof_regnames, /* print fn */NULL);
+  sprintf(buf, "%s.width", name);
+  vp->width_dist =
+    stat_reg_dist(sdb, mystrdup(buf),
+		  "significant bits of integer results (0 is zero)",
+		  /* initial value */0, /* array size */VPROF_MAX_WIDTH + 1,
+		  /* bucket size */1, PF_COUNT|PF_PDF|PF_CDF,
+		  /* format */NULL, /* index map */NULL, /* print fn */NULL);
+
+  sprintf(buf, "%s.reg_lv_hits", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "register writes of the value already held",
+		   &vp->reg_lv_hits, 0, NULL);
+  sprintf(buf, "%s.reg_lv_rate", name);
+  sprintf(buf1, "%s.reg_lv_hits / %s.writes", name, name);
+  stat_reg_formula(sdb, mystrdup(buf),
+		   "fraction of register writes that were silent",
+		   mystrdup(buf1), NULL);
+  sprintf(buf, "%s.loads", name);
+  stat_reg_counter(sdb, mystrdup(buf), "total number of loads profiled",
+		   &vp->loads, 0, NULL);
+  sprintf(buf, "%s.load_lv_hits", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "loads returning the last value loaded by the same inst",
+		   &vp->load_lv_hits, 0, NULL);
+  sprintf(buf, "%s.load_lv_rate", name);
+  sprintf(buf1, "%s.load_lv_hits / %s.loads", name, name);
+  stat_reg_formula(sdb, mystrdup(buf),
+		   "load last-value predictability",
+		   mystrdup(buf1), NULL);
+}
+
+/* note the register outputs of instruction OP before it executes */
+void
+vprof_begin(struct vprof_t *vp,		/* value profiler */
+	    enum md_opcode op,		/* instruction opcode */
+	    int out1, int out2)		/* output dependences, DNA if none */
+{
+  int n;
+
+  /* system calls may never return (exit), so fold the counts here */
+  if (MD_OP_FLAGS(op) & F_TRAP)
+    vprof_fold(vp);
+
+  /* writes to $r0 are discarded, DTMP is not architected */
+  n = vp->nbatch;
+  if (out1 > 0 && out1 < VPROF_NUM_REGS)
+    {
+      vp->reg[n] = out1;
+      vp->old[n] = vprof_read(vp->regs, out1);
+      n++;
+    }
+  if (out2 > 0 && out2 < VPROF_NUM_REGS && out2 != out1)
+    {
+      vp->reg[n] = out2;
+      vp->old[n] = vprof_read(vp->regs, out2);
+      n++;
+    }
+  vp->nopen = n - vp->nbatch;
+}
+
+/* record the new register values after OP, at PC, has executed */
+void
+vprof_end(struct vprof_t *vp,		/* value profiler */
+	  enum md_opcode op,		/* instruction opcode */
+	  md_addr_t pc)			/* instruction address */
+{
+  int i, n = vp->nbatch + vp->nopen;
+
+  for (i = vp->nbatch; i < n; i++)
+    vp->val[i] = vprof_read(vp->regs, vp->reg[i]);
+
+  /* the loaded value is the first output */
+  if ((MD_OP_FLAGS(op) & F_LOAD) && vp->nopen > 0)
+    {
+      int index = (pc >> 3) & (vp->lv_size - 1);
+      qword_t val = vp->val[vp->nbatch];
+
+      vp->loads++;
+      if (vp->lv_tag[index] == pc && vp->lv_val[index] == val)
+	vp->load_lv_hits++;
+      vp->lv_tag[index] = pc;
+      vp->lv_val[index] = val;
+    }
+
+  vp->nbatch = n;
+  vp->nopen = 0;
+
+  /* analyze at the end of each basic block, or when the batch fills */
+  if ((MD_OP_FLAGS(op) & F_CTRL) || vp->nbatch > VPROF_BATCH - 2)
+    vprof_flush(vp);
+}
+
+/* analyze all pending register writes */
+void
+vprof_flush(struct vprof_t *vp)		/* value profiler */
+{
+  int i, n = vp->nbatch;
+
+  /* popcounts first, a flat loop the host compiler can vectorize */
+  for (i = 0; i < n; i++)
+    vp->bits[i] = vprof_popcount(vp->old[i] ^ vp->val[i]);
+
+  for (i = 0; i < n; i++)
+    {
+      int reg = vp->reg[i];
+
+      vp->toggle_count[vp->bits[i]]++;
+      vp->reg_count[reg] += vp->bits[i];
+      vp->toggles += vp->bits[i];
+      if (vp->bits[i] == 0)
+	vp->reg_lv_hits++;
+
+      /* FP values are not integers, their width means nothing */
+      if (reg < 32 || reg >= 64)
+	vp->width_count[vprof_width((sword_t)vp->val[i])]++;
+    }
+
+  vp->writes += n;
+  vp->nbatch = 0;
+}
+
+/* add the counts in COUNT[0..N-1] to distribution DIST, and clear them */
+static void
+vprof_fold_dist(struct stat_stat_t *dist, counter_t *count, int n)
+{
+  int i, chunk;
+
+  for (i = 0; i < n; i++)
+    {
+      for (; count[i] != 0; count[i] -= chunk)
+	{
+	  chunk = (int)MIN(count[i], (counter_t)INT_MAX);
+	  stat_add_samples(dist, i, chunk);
+	}
+    }
+}
+
+/* analyze all pending register writes and add their counts to the
+   distributions, call before the statistics are printed */
+void
+vprof_fold(struct vprof_t *vp)		/* value profiler */
+{
+  vprof_flush(vp);
+  vprof_fold_dist(vp->toggle_dist, vp->toggle_count, 64 + 1);
+  vprof_fold_dist(vp->reg_dist, vp->reg_count, VPROF_NUM_REGS);
+  vprof_fold_dist(vp->width_dist, vp->width_count, VPROF_MAX_WIDTH + 1);
+}
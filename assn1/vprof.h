@@ -0,0 +1,170 @@
+/* vprof.h - register and memory value profiler interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef VPROF_H
+#define VPROF_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "regs.h"
+#include "stats.h"
+
+/*
+ * The value profiler watches every register write and every loaded value and
+ * reports, through the stats database:
+ *
+ *   <name>.writes	- register writes
+ *   <name>.toggles	- register bits switched, over all writes
+ *   <name>.toggle_bits	- distribution of bits switched per register write
+ *   <name>.reg_toggles	- bits switched, by register
+ *   <name>.width	- significant width of integer results, 0 is zero
+ *   <name>.reg_lv_hits	- register writes that rewrote the same value
+ *   <name>.load_lv_hits - loads that returned the last value loaded by
+ *			  the same instruction (last-value predictable)
+ *
+ * The interpreter only records (register, old value, new value) triples;
+ * the triples are analyzed in one pass at the end of each basic block, with
+ * the popcounts over flat arrays so the host compiler can vectorize them.
+ * The pass only bumps plain counters; they are folded into the distributions
+ * by vprof_fold(), before each system call (the program may exit in one)
+ * and at the end of the run.
+ *
+ * Usage, around the execution of each instruction:
+ *
+ *   vprof_begin(vp, op, out1, out2);	-- before, saves the old values
+ *   ... execute the instruction ...
+ *   vprof_end(vp, op, pc);		-- after, saves the new values
+ *
+ * and vprof_fold(vp) before the statistics are printed.
+ *
+ * Registers are named by their dependence index (see the DGPR() etc.
+ * decoders); double precision FP registers are treated as even/odd pairs.
+ */
+
+/* register writes buffered before analysis, two per instruction */
+#define VPROF_BATCH		128
+
+/* dependence indices tracked, integer + FP + HI/LO/FCC */
+#define VPROF_NUM_REGS		(32 + 32 + 3)
+
+/* integer result widths, 0 to 32 bits */
+#define VPROF_MAX_WIDTH		32
+
+/* value profiler */
+struct vprof_t {
+  struct regs_t *regs;			/* register file being profiled */
+
+  /* pending register writes, structure-of-arrays for the batch pass */
+  int nbatch;				/* number of writes pending */
+  int nopen;				/* writes opened by vprof_begin() */
+  int reg[VPROF_BATCH];			/* dependence index written */
+  qword_t old[VPROF_BATCH];		/* value before the write */
+  qword_t val[VPROF_BATCH];		/* value after the write */
+  int bits[VPROF_BATCH];		/* bits switched, batch pass scratch */
+
+  /* distribution counts not yet folded into the stats database */
+  counter_t toggle_count[64 + 1];	/* writes, by bits switched */
+  counter_t reg_count[VPROF_NUM_REGS];	/* bits switched, by register */
+  counter_t width_count[VPROF_MAX_WIDTH + 1]; /* results, by width */
+
+  /* last value loaded, by load instruction address */
+  int lv_size;				/* table entries, power-of-two */
+  md_addr_t *lv_tag;			/* load PC owning each entry */
+  qword_t *lv_val;			/* last value loaded */
+
+  /* profiler stats */
+  counter_t writes;			/* register writes */
+  counter_t toggles;			/* total bits switched */
+  counter_t reg_lv_hits;		/* writes of the value already held */
+  counter_t loads;			/* loads profiled */
+  counter_t load_lv_hits;		/* loads of their last loaded value */
+  struct stat_stat_t *toggle_dist;	/* bits switched per write */
+  struct stat_stat_t *reg_dist;		/* bits switched, by register */
+  struct stat_stat_t *width_dist;	/* integer result widths */
+};
+
+/* create a value profiler for register file REGS, with an LV_SIZE entry
+   load value table, LV_SIZE must be a power-of-two */
+struct vprof_t *
+vprof_create(struct regs_t *regs,	/* register file to profile */
+	     int lv_size);		/* load value table entries */
+
+/* register value profiler statistics */
+void
+vprof_reg_stats(struct vprof_t *vp,	/* value profiler */
+		struct stat_sdb_t *sdb,	/* stats database */
+		char *name);		/* profiler name, stats are <name>.* */
+
+/* note the register outputs of instruction OP before it executes */
+void
+vprof_begin(struct vprof_t *vp,		/* value profiler */
+	    enum md_opcode op,		/* instruction opcode */
+	    int out1, int out2);	/* output dependences, DNA if none */
+
+/* record the new register values after OP, at PC, has executed */
+void
+vprof_end(struct vprof_t *vp,		/* value profiler */
+	  enum md_opcode op,		/* instruction opcode */
+	  md_addr_t pc);		/* instruction address */
+
+/* analyze all pending register writes */
+void
+vprof_flush(struct vprof_t *vp);	/* value profiler */
+
+/* analyze all pending register writes and add their counts to the
+   distributions, call before the statistics are printed */
+void
+vprof_fold(struct vprof_t *vp);		/* value profiler */
+
+#endif /* VPROF_H */
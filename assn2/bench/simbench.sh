@@ -0,0 +1,172 @@
+#! /bin/sh
+#
+# simbench.sh - simulator speed benchmark over the shipped workloads
+#
+# Runs every simulator configuration over every workload for a fixed
+# number of instructions and reports wall clock time, simulation speed in
+# MIPS and peak resident set size, as measured by the simulator itself
+# (sim_wall_time, sim_mips and sim_peak_rss).  Each run is repeated and
+# the fastest repetition is kept, to filter out scheduling noise.
+#
+# The results are compared against a stored baseline, and the script exits
+# non-zero when any run is slower than its baseline by more than the
+# tolerance, or when any run did not finish; finished runs shorter than a
+# tenth of a second are too noisy to judge and are only reported.  With -u,
+# the baseline is rewritten from this run instead.
+#
+# usage: simbench.sh [-u] [-b <baseline>] [-o <results>]
+#
+# environment:
+#	SIM_DIR		directory holding sim-scalar-cpen411 (default: .)
+#	SAFE_BIN	sim-safe binary (default: ../assn1/sim-safe), skipped
+#			with a note when it has not been built
+#	BENCH_INSTS	instructions per run (default: 4000000)
+#	BENCH_REPS	repetitions per run (default: 3)
+#	BENCH_TOL	allowed slowdown, in percent (default: 10)
+#	BENCH_ONLY	only run configurations/workloads matching this
+#			egrep pattern against `<config> <workload>'
+#
+
+update=0
+baseline=bench/baseline
+results=bench/results
+while [ $# -gt 0 ]; do
+  case "$1" in
+    -u) update=1 ;;
+    -b) shift; baseline="$1" ;;
+    -o) shift; results="$1" ;;
+    *) echo "usage: $0 [-u] [-b <baseline>] [-o <results>]" >&2; exit 2 ;;
+  esac
+  shift
+done
+
+top=`pwd`
+SIM_DIR=${SIM_DIR:-.}
+SAFE_BIN=${SAFE_BIN:-../assn1/sim-safe}
+BENCH_INSTS=${BENCH_INSTS:-4000000}
+BENCH_REPS=${BENCH_REPS:-3}
+BENCH_TOL=${BENCH_TOL:-10}
+
+case "$SIM_DIR" in /*) ;; *) SIM_DIR="$top/$SIM_DIR" ;; esac
+case "$SAFE_BIN" in /*) ;; *) SAFE_BIN="$top/$SAFE_BIN" ;; esac
+case "$baseline" in /*) ;; *) baseline="$top/$baseline" ;; esac
+case "$results" in /*) ;; *) results="$top/$results" ;; esac
+SCALAR="$SIM_DIR/sim-scalar-cpen411"
+
+# simulator configurations: <name>|<binary>|<options>
+configs="safe|$SAFE_BIN|
+scalar|$SCALAR|
+bpred|$SCALAR|-bpred 2lev -bpred:btb 512 4 -bpred:ras 8
+cache|$SCALAR|-cache:il1 il1:512:32:1:l -cache:dl1 dl1:256:32:2:l -cache:dl2 ul2:1024:64:4:l"
+
+# workloads: <name>|<directory>|<stdin>|<program and arguments>
+workloads="anagram|tests|inputs/input.txt|bin.little/anagram inputs/words
+test-math|tests|/dev/null|bin.little/test-math
+test-printf|tests|/dev/null|bin.little/test-printf
+vpr|vpr|/dev/null|vpr.ss net.in arch.in place.in route.out -nodisp -route_only -route_chan_width 15 -pres_fac_mult 2 -acc_fac 1 -first_iter_pres_fac 4 -initial_pres_fac 8
+go|go|/dev/null|go.ss 9 9
+gcc|gcc|/dev/null|cc1.ss -O2 integrate.i
+fpppp|fpppp|natoms-input.in|fpppp.ss"
+
+# programs write their outputs next to their inputs, so every run gets a
+# scratch copy of its workload directory
+scratch=${TMPDIR:-/tmp}/simbench.$$
+trap 'rm -rf "$scratch"' 0 1 2 15
+mkdir -p "$scratch" || exit 1
+
+# print the value of stat <name> in simout file <file>
+getstat() {
+  awk -v n="$1" '$1 == n { print $2; exit }' "$2" 2>/dev/null
+}
+
+fail=0
+: > "$results.tmp"
+printf "%-8s %-12s %10s %10s %9s %9s %9s %7s\n" \
+  config workload insts "wall(s)" mips "base" "delta%" "rss(k)"
+
+echo "$configs" | while IFS='|' read cname bin opts; do
+  if [ ! -x "$bin" ]; then
+    echo "simbench: skipping \`$cname', $bin has not been built" >&2
+    continue
+  fi
+  echo "$workloads" | while IFS='|' read wname wdir win wcmd; do
+    if [ -n "$BENCH_ONLY" ] \
+       && ! echo "$cname $wname" | egrep -q "$BENCH_ONLY"; then
+      continue
+    fi
+
+    run="$scratch/$cname.$wname"
+    rm -rf "$run"; cp -r "$top/$wdir" "$run" || exit 1
+
+    best=; bwall=; binsts=; brss=; status=ok
+    rep=0
+    while [ $rep -lt "$BENCH_REPS" ]; do
+      # simulator options are deliberately split on blanks
+      (cd "$run" && "$bin" -max:inst "$BENCH_INSTS" \
+	 -redir:sim "$run/simout" -redir:prog /dev/null $opts $wcmd \
+	 < "$win" > /dev/null 2>&1)
+      mips=`getstat sim_mips "$run/simout"`
+      if [ -z "$mips" ]; then
+	if cp "$run/simout" "$results.$cname.$wname.simout" 2>/dev/null; then
+	  echo "simbench: $cname/$wname did not finish," \
+	    "see $results.$cname.$wname.simout" >&2
+	else
+	  echo "simbench: $cname/$wname did not finish, and wrote no output" >&2
+	fi
+	status=failed
+	mips=0
+      fi
+      if [ -z "$best" ] || awk "BEGIN { exit !($mips > $best) }"; then
+	best=$mips
+	bwall=`getstat sim_wall_time "$run/simout"`
+	binsts=`getstat sim_num_insn "$run/simout"`
+	brss=`getstat sim_peak_rss "$run/simout" | sed 's/k$//'`
+      fi
+      rep=`expr $rep + 1`
+    done
+    rm -rf "$run"
+
+    base=`awk -v c="$cname" -v w="$wname" \
+      '$1 == c && $2 == w { print $3; exit }' "$baseline" 2>/dev/null`
+    if [ $status = ok ]; then
+      echo "$cname $wname $best $bwall $binsts $brss" >> "$results.tmp"
+    fi
+    echo "$cname $wname ${binsts:-0} ${bwall:-0} $best ${base:--} ${brss:-0}" \
+	 "$status" \
+      | awk -v tol="$BENCH_TOL" -v upd=$update '{
+	  delta = "-"; flag = "";
+	  if ($8 != "ok")
+	    flag = "  FAILED";
+	  else if ($4 < 0.1)
+	    flag = "  (short)";
+	  else if ($6 != "-" && $6 > 0) {
+	    delta = sprintf("%+.1f", ($5 - $6) / $6 * 100);
+	    if (!upd && $5 < $6 * (1 - tol / 100))
+	      flag = "  SLOWER";
+	  }
+	  printf "%-8s %-12s %10d %10.4f %9.4f %9s %9s %7d%s\n",
+	    $1, $2, $3, $4, $5, $6, delta, $7, flag
+	}'
+  done
+done | tee "$results.log"
+
+if egrep -q 'SLOWER|FAILED' "$results.log"; then
+  fail=1
+fi
+
+if [ $update -eq 1 ]; then
+  {
+    echo "# simbench baseline: <config> <workload> <mips>"
+    echo "# $BENCH_INSTS insts/run, best of $BENCH_REPS, `uname -sm`"
+    awk '{ print $1, $2, $3 }' "$results.tmp"
+  } > "$baseline"
+  echo "simbench: baseline written to $baseline"
+fi
+rm -f "$results.tmp"
+
+if [ $fail -ne 0 ]; then
+  echo "simbench: runs failed or throughput regressed by more than" \
+    "$BENCH_TOL% (see above)"
+  exit 1
+fi
+exit 0
@@ -0,0 +1,456 @@
+/* bpred.c - branch predictor routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bpred.h"
+
+/* branch predictor type names, indexed by enum bpred_class */
+char *bpred_name[BPred_NUM] = { "nottaken", "taken", "bimod", "2lev" };
+
+/* allocate a table of N 2-bit counters, initialized to alternate between
+   weakly taken and weakly not taken */
+static unsigned char *
+bpred_counters(unsigned int n)
+{
+  unsigned char *table;
+  unsigned int i;
+
+  if (!(table = calloc(n, sizeof(unsigned char))))
+    fatal("cannot allocate branch predictor counters");
+  for (i = 0; i < n; i++)
+    table[i] = (i & 1) ? 2 : 1;
+  return table;
+}
+
+/* create a branch predictor of type CLASS */
+struct bpred_t *				/* branch predictor instance */
+bpred_create(enum bpred_class class,	/* type of predictor to create */
+	     unsigned int bimod_size,	/* bimod table size */
+	     unsigned int l1size,	/* 2lev l1 table size */
+	     unsigned int l2size,	/* 2lev l2 table size */
+	     unsigned int shift_width,	/* history register width */
+	     int xor,			/* history xor address for 2lev l2 */
+	     unsigned int btb_sets,	/* number of sets in BTB */
+	     unsigned int btb_assoc,	/* BTB associativity */
+	     unsigned int retstack_size)/* num entries in ret-addr stack */
+{
+  struct bpred_t *pred;
+
+  if (!(pred = calloc(1, sizeof(struct bpred_t))))
+    fatal("out of virtual memory");
+  pred->class = class;
+
+  switch (class)
+    {
+    case BPredNotTaken:
+      /* fetch always falls through, nothing else to allocate */
+      return pred;
+
+    case BPredTaken:
+      break;
+
+    case BPred2bit:
+      if (!bimod_size || (bimod_size & (bimod_size - 1)) != 0)
+	fatal("2bit table size, `%d', must be non-zero and a power of two",
+	      bimod_size);
+      pred->bimod.size = bimod_size;
+      pred->bimod.table = bpred_counters(bimod_size);
+      break;
+
+    case BPred2Level:
+      if (!l1size || (l1size & (l1size - 1)) != 0)
+	fatal("level-1 size, `%d', must be non-zero and a power of two",
+	      l1size);
+      if (!l2size || (l2size & (l2size - 1)) != 0)
+	fatal("level-2 size, `%d', must be non-zero and a power of two",
+	      l2size);
+      if (!shift_width || shift_width > 30)
+	fatal("shift register width, `%d', must be non-zero and positive",
+	      shift_width);
+      pred->twolev.l1size = l1size;
+      pred->twolev.l2size = l2size;
+      pred->twolev.shift_width = shift_width;
+      pred->twolev.xor = xor;
+      if (!(pred->twolev.shiftregs = calloc(l1size, sizeof(unsigned int))))
+	fatal("cannot allocate shift register table");
+      pred->twolev.l2table = bpred_counters(l2size);
+      break;
+
+    default:
+      panic("bogus predictor class");
+    }
+
+  /* predictors that may predict taken need a BTB to supply targets */
+  if (!btb_sets || (btb_sets & (btb_sets - 1)) != 0)
+    fatal("number of BTB sets, `%d', must be non-zero and a power of two",
+	  btb_sets);
+  if (!btb_assoc || (btb_assoc & (btb_assoc - 1)) != 0)
+    fatal("BTB associativity, `%d', must be non-zero and a power of two",
+	  btb_assoc);
+  pred->btb.sets = btb_sets;
+  pred->btb.assoc = btb_assoc;
+  if (!(pred->btb.btb_data = calloc(btb_sets * btb_assoc,
+				    sizeof(struct bpred_btb_ent_t))))
+    fatal("cannot allocate BTB");
+
+  pred->retstack.size = retstack_size;
+  if (retstack_size
+      && !(pred->retstack.stack = calloc(retstack_size,
+					 sizeof(struct bpred_btb_ent_t))))
+    fatal("cannot allocate return-address-stack");
+
+  return pred;
+}
+
+/* print branch predictor configuration */
+void
+bpred_config(struct bpred_t *pred,	/* branch predictor instance */
+	     FILE *stream)		/* output stream */
+{
+  switch (pred->class)
+    {
+    case BPredNotTaken:
+      fprintf(stream, "pred_dir: %s: predict not taken\n",
+	      bpred_name[pred->class]);
+      return;
+    case BPredTaken:
+      fprintf(stream, "pred_dir: %s: predict taken\n",
+	      bpred_name[pred->class]);
+      break;
+    case BPred2bit:
+      fprintf(stream, "pred_dir: %s: 2-bit: %d entries\n",
+	      bpred_name[pred->class], pred->bimod.size);
+      break;
+    case BPred2Level:
+      fprintf(stream,
+	      "pred_dir: %s: 2-lvl: %d l1-sz, %d bits/ent, %s xor, "
+	      "%d l2-sz\n", bpred_name[pred->class], pred->twolev.l1size,
+	      pred->twolev.shift_width, pred->twolev.xor ? "" : "no",
+	      pred->twolev.l2size);
+      break;
+    default:
+      panic("bogus predictor class");
+    }
+  fprintf(stream, "btb: %d sets x %d associativity\n",
+	  pred->btb.sets, pred->btb.assoc);
+  fprintf(stream, "ret_stack: %d entries\n", pred->retstack.size);
+}
+
+/* register branch predictor stats */
+void
+bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
+		struct stat_sdb_t *sdb,	/* stats database */
+		char *name)		/* stat name prefix */
+{
+  char buf[512], buf1[512];
+
+  sprintf(buf, "%s.lookups", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of control instructions predicted",
+		   &pred->lookups, 0, NULL);
+  sprintf(buf, "%s.updates", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of control instructions resolved",
+		   &pred->updates, 0, NULL);
+  sprintf(buf, "%s.addr_hits", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of address-predicted hits",
+		   &pred->addr_hits, 0, NULL);
+  sprintf(buf, "%s.dir_hits", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of direction-predicted hits",
+		   &pred->dir_hits, 0, NULL);
+  sprintf(buf, "%s.misses", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of mispredictions", &pred->misses, 0, NULL);
+  sprintf(buf, "%s.btb_misses", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of taken predictions without a BTB target",
+		   &pred->btb_misses, 0, NULL);
+
+  sprintf(buf, "%s.bpred_addr_rate", name);
+  sprintf(buf1, "%s.addr_hits / %s.updates", name, name);
+  stat_reg_formula(sdb, mystrdup(buf),
+		   "branch address-prediction rate (i.e., addr-hits/updates)",
+		   mystrdup(buf1), "%9.4f");
+  sprintf(buf, "%s.bpred_dir_rate", name);
+  sprintf(buf1, "%s.dir_hits / %s.updates", name, name);
+  stat_reg_formula(sdb, mystrdup(buf),
+		  "branch direction-prediction rate (i.e., all-hits/updates)",
+		   mystrdup(buf1), "%9.4f");
+
+  /* return address stack stats, if there is one */
+  if (!pred->retstack.size)
+    return;
+
+  sprintf(buf, "%s.used_ras", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of RAS predictions used",
+		   &pred->used_ras, 0, NULL);
+  sprintf(buf, "%s.ras_hits", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of RAS hits", &pred->ras_hits, 0, NULL);
+  sprintf(buf, "%s.retstack_pushes", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of address pushed onto ret-addr stack",
+		   &pred->retstack_pushes, 0, NULL);
+  sprintf(buf, "%s.retstack_pops", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of address popped off of ret-addr stack",
+		   &pred->retstack_pops, 0, NULL);
+  sprintf(buf, "%s.ras_rate", name);
+  sprintf(buf1, "%s.ras_hits / %s.used_ras", name, name);
+  stat_reg_formula(sdb, mystrdup(buf),
+		   "return address stack prediction rate (i.e., RAS hits/used RAS)",
+		   mystrdup(buf1), "%9.4f");
+}
+
+/* the 2-bit counter predicting the direction of the branch at BADDR */
+static unsigned char *
+bpred_dir_lookup(struct bpred_t *pred,	/* branch predictor instance */
+		 md_addr_t baddr)	/* branch address */
+{
+  unsigned int l1index, l2index;
+
+  switch (pred->class)
+    {
+    case BPred2bit:
+      return &pred->bimod.table[(baddr >> MD_BR_SHIFT)
+				& (pred->bimod.size - 1)];
+
+    case BPred2Level:
+      l1index = (baddr >> MD_BR_SHIFT) & (pred->twolev.l1size - 1);
+      l2index = pred->twolev.shiftregs[l1index];
+      if (pred->twolev.xor)
+	l2index = (((l2index ^ (baddr >> MD_BR_SHIFT))
+		    & ((1 << pred->twolev.shift_width) - 1))
+		   | ((baddr >> MD_BR_SHIFT) << pred->twolev.shift_width));
+      else
+	l2index = (l2index
+		   | ((baddr >> MD_BR_SHIFT) << pred->twolev.shift_width));
+      return &pred->twolev.l2table[l2index & (pred->twolev.l2size - 1)];
+
+    default:
+      return NULL;
+    }
+}
+
+/* the BTB set holding the branch at BADDR */
+static struct bpred_btb_ent_t *
+bpred_btb_set(struct bpred_t *pred,	/* branch predictor instance */
+	      md_addr_t baddr)		/* branch address */
+{
+  unsigned int index = (baddr >> MD_BR_SHIFT) & (pred->btb.sets - 1);
+
+  return &pred->btb.btb_data[index * pred->btb.assoc];
+}
+
+/* predict the next fetch address after control instruction OP at BADDR,
+   returns the predicted target, or 0 to fetch the fall-through path */
+md_addr_t				/* predicted branch target addr */
+bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
+	     md_addr_t baddr,		/* branch address */
+	     enum md_opcode op,		/* opcode of instruction */
+	     int is_call,		/* non-zero if inst is fn call */
+	     int is_return,		/* non-zero if inst is fn return */
+	     struct bpred_update_t *dir_update_ptr)/* pred state pointer */
+{
+  struct bpred_btb_ent_t *set;
+  md_addr_t target = 0;
+  unsigned int i;
+
+  if (!(MD_OP_FLAGS(op) & F_CTRL))
+    panic("predicting a non-control instruction");
+
+  pred->lookups++;
+  dir_update_ptr->pdir = NULL;
+  dir_update_ptr->pred_taken = FALSE;
+  dir_update_ptr->used_ras = FALSE;
+  dir_update_ptr->stack_recover_idx = pred->retstack.tos;
+
+  if (pred->class == BPredNotTaken)
+    return 0;
+
+  /* predict the direction, unconditional jumps are always taken */
+  if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) == (F_CTRL|F_UNCOND)
+      || pred->class == BPredTaken)
+    dir_update_ptr->pred_taken = TRUE;
+  else
+    {
+      dir_update_ptr->pdir = bpred_dir_lookup(pred, baddr);
+      dir_update_ptr->pred_taken = (*dir_update_ptr->pdir >= 2);
+    }
+
+  /* returns take their target from the return address stack; calls push
+     their return address */
+  if (is_return && pred->retstack.size)
+    {
+      target = pred->retstack.stack[pred->retstack.tos].target;
+      pred->retstack.tos =
+	(pred->retstack.tos + pred->retstack.size - 1) % pred->retstack.size;
+      pred->retstack_pops++;
+      pred->used_ras++;
+      dir_update_ptr->used_ras = TRUE;
+    }
+  else if (is_call && pred->retstack.size)
+    {
+      pred->retstack.tos = (pred->retstack.tos + 1) % pred->retstack.size;
+      pred->retstack.stack[pred->retstack.tos].target =
+	baddr + sizeof(md_inst_t);
+      pred->retstack_pushes++;
+    }
+
+  /* recovering from a misprediction of this branch restores the stack as
+     this branch left it */
+  dir_update_ptr->stack_recover_idx = pred->retstack.tos;
+
+  if (!dir_update_ptr->pred_taken)
+    return 0;
+  if (dir_update_ptr->used_ras)
+    return target;
+
+  /* the target of a branch predicted taken comes from the BTB */
+  set = bpred_btb_set(pred, baddr);
+  for (i = 0; i < pred->btb.assoc; i++)
+    if (set[i].addr == baddr)
+      return set[i].target;
+
+  /* no target known, fetch falls through */
+  pred->btb_misses++;
+  return 0;
+}
+
+/* undo the return address stack updates of instructions fetched after the
+   branch at BADDR, which was mispredicted */
+void
+bpred_recover(struct bpred_t *pred,	/* branch predictor instance */
+	      md_addr_t baddr,		/* branch address */
+	      struct bpred_update_t *dir_update_ptr)/* pred state pointer */
+{
+  if (pred->retstack.size)
+    pred->retstack.tos = dir_update_ptr->stack_recover_idx;
+}
+
+/* train the predictor with the outcome of the control instruction OP at
+   BADDR, which went to BTARGET */
+void
+bpred_update(struct bpred_t *pred,	/* branch predictor instance */
+	     md_addr_t baddr,		/* branch address */
+	     md_addr_t btarget,		/* resolved branch target */
+	     int taken,			/* non-zero if branch was taken */
+	     int correct,		/* was next PC predicted correctly? */
+	     enum md_opcode op,		/* opcode of instruction */
+	     struct bpred_update_t *dir_update_ptr)/* pred state pointer */
+{
+  struct bpred_btb_ent_t *set, ent;
+  unsigned int i, l1index;
+
+  if (!(MD_OP_FLAGS(op) & F_CTRL))
+    panic("updating a non-control instruction");
+
+  pred->updates++;
+  if (correct)
+    pred->addr_hits++;
+  else
+    pred->misses++;
+  if (!!dir_update_ptr->pred_taken == !!taken)
+    pred->dir_hits++;
+  if (dir_update_ptr->used_ras && correct)
+    pred->ras_hits++;
+
+  if (pred->class == BPredNotTaken)
+    return;
+
+  /* train the counter that made the prediction */
+  if (dir_update_ptr->pdir)
+    {
+      if (taken)
+	{
+	  if (*dir_update_ptr->pdir < 3)
+	    ++*dir_update_ptr->pdir;
+	}
+      else
+	{
+	  if (*dir_update_ptr->pdir > 0)
+	    --*dir_update_ptr->pdir;
+	}
+    }
+
+  /* shift the outcome of conditional branches into their history */
+  if (pred->class == BPred2Level
+      && (MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND))
+    {
+      l1index = (baddr >> MD_BR_SHIFT) & (pred->twolev.l1size - 1);
+      pred->twolev.shiftregs[l1index] =
+	((pred->twolev.shiftregs[l1index] << 1) | (!!taken))
+	& ((1 << pred->twolev.shift_width) - 1);
+    }
+
+  /* remember the target of taken branches, most recently used first */
+  if (taken)
+    {
+      set = bpred_btb_set(pred, baddr);
+      for (i = 0; i < pred->btb.assoc - 1; i++)
+	if (set[i].addr == baddr)
+	  break;
+      ent.addr = baddr;
+      ent.target = btarget;
+      memmove(&set[1], &set[0], i * sizeof(struct bpred_btb_ent_t));
+      set[0] = ent;
+    }
+}
@@ -0,0 +1,200 @@
+/* bpred.h - branch predictor interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef BPRED_H
+#define BPRED_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * This module implements the branch predictors used by the pipeline's
+ * fetch stage: a direction predictor (static not-taken or taken, a table
+ * of 2-bit counters, or a two-level adaptive predictor that may be
+ * configured as GAg, GAp, PAg, PAp or, with history XOR'ed into the
+ * address, gshare), a set-associative branch target buffer and a return
+ * address stack.
+ *
+ * Fetch calls bpred_lookup() for every control instruction it fetches and
+ * follows the predicted target; once the branch resolves, bpred_update()
+ * trains the predictor with the actual outcome, and bpred_recover() undoes
+ * return address stack updates made down a mispredicted path.  Branch
+ * history is only updated at resolution, i.e., non-speculatively.
+ */
+
+/* branch predictor types */
+enum bpred_class {
+  BPredNotTaken,			/* static predict not taken */
+  BPredTaken,				/* static predict taken */
+  BPred2bit,				/* 2-bit saturating counters */
+  BPred2Level,				/* two-level adaptive predictor */
+  BPred_NUM
+};
+
+/* branch predictor type names, indexed by enum bpred_class */
+extern char *bpred_name[BPred_NUM];
+
+/* a branch target buffer or return address stack entry */
+struct bpred_btb_ent_t {
+  md_addr_t addr;			/* address of branch, 0 if invalid */
+  md_addr_t target;			/* last destination of branch */
+};
+
+/* branch predictor state */
+struct bpred_t {
+  enum bpred_class class;		/* type of predictor */
+
+  /* direction predictor */
+  struct {
+    unsigned int size;			/* number of 2-bit counters */
+    unsigned char *table;		/* counter table */
+  } bimod;
+  struct {
+    unsigned int l1size;		/* number of history registers */
+    unsigned int l2size;		/* number of 2-bit counters */
+    unsigned int shift_width;		/* history bits */
+    int xor;				/* XOR history with address? */
+    unsigned int *shiftregs;		/* history registers */
+    unsigned char *l2table;		/* counter table */
+  } twolev;
+
+  /* branch target buffer */
+  struct {
+    unsigned int sets;			/* number of sets */
+    unsigned int assoc;			/* ways per set */
+    struct bpred_btb_ent_t *btb_data;	/* sets*assoc entries, each set
+					   ordered from MRU to LRU */
+  } btb;
+
+  /* return address stack */
+  struct {
+    unsigned int size;			/* number of entries, 0 if none */
+    unsigned int tos;			/* top of stack */
+    struct bpred_btb_ent_t *stack;	/* return addresses */
+  } retstack;
+
+  /* stats */
+  counter_t lookups;			/* control instructions predicted */
+  counter_t updates;			/* control instructions resolved */
+  counter_t addr_hits;			/* correct next PC predictions */
+  counter_t dir_hits;			/* correct direction predictions */
+  counter_t misses;			/* mispredictions */
+  counter_t btb_misses;			/* predicted taken, but no target */
+  counter_t used_ras;			/* returns predicted by the RAS */
+  counter_t ras_hits;			/* correct RAS predictions */
+  counter_t retstack_pushes;		/* calls pushed on the RAS */
+  counter_t retstack_pops;		/* returns popped off the RAS */
+};
+
+/* state recorded by a lookup, to be handed back at update/recovery */
+struct bpred_update_t {
+  unsigned char *pdir;			/* counter used for the prediction */
+  int pred_taken;			/* predicted direction */
+  int used_ras;				/* predicted by the RAS? */
+  unsigned int stack_recover_idx;	/* RAS top of stack before lookup */
+};
+
+/* create a branch predictor of type CLASS */
+struct bpred_t *				/* branch predictor instance */
+bpred_create(enum bpred_class class,	/* type of predictor to create */
+	     unsigned int bimod_size,	/* bimod table size */
+	     unsigned int l1size,	/* 2lev l1 table size */
+	     unsigned int l2size,	/* 2lev l2 table size */
+	     unsigned int shift_width,	/* history register width */
+	     int xor,			/* history xor address for 2lev l2 */
+	     unsigned int btb_sets,	/* number of sets in BTB */
+	     unsigned int btb_assoc,	/* BTB associativity */
+	     unsigned int retstack_size);/* num entries in ret-addr stack */
+
+/* print branch predictor configuration */
+void
+bpred_config(struct bpred_t *pred,	/* branch predictor instance */
+	     FILE *stream);		/* output stream */
+
+/* register branch predictor stats */
+void
+bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
+		struct stat_sdb_t *sdb,	/* stats database */
+		char *name);		/* stat name prefix */
+
+/* predict the next fetch address after control instruction OP at BADDR,
+   returns the predicted target, or 0 to fetch the fall-through path */
+md_addr_t				/* predicted branch target addr */
+bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
+	     md_addr_t baddr,		/* branch address */
+	     enum md_opcode op,		/* opcode of instruction */
+	     int is_call,		/* non-zero if inst is fn call */
+	     int is_return,		/* non-zero if inst is fn return */
+	     struct bpred_update_t *dir_update_ptr);/* pred state pointer */
+
+/* undo the return address stack updates of instructions fetched after the
+   branch at BADDR, which was mispredicted */
+void
+bpred_recover(struct bpred_t *pred,	/* branch predictor instance */
+	      md_addr_t baddr,		/* branch address */
+	      struct bpred_update_t *dir_update_ptr);/* pred state pointer */
+
+/* train the predictor with the outcome of the control instruction OP at
+   BADDR, which went to BTARGET */
+void
+bpred_update(struct bpred_t *pred,	/* branch predictor instance */
+	     md_addr_t baddr,		/* branch address */
+	     md_addr_t btarget,		/* resolved branch target */
+	     int taken,			/* non-zero if branch was taken */
+	     int correct,		/* was next PC predicted correctly? */
+	     enum md_opcode op,		/* opcode of instruction */
+	     struct bpred_update_t *dir_update_ptr);/* pred state pointer */
+
+#endif /* BPRED_H */
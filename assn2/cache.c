@@ -0,0 +1,346 @@
+/* cache.c - cache module routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "memory.h"
+#include "stats.h"
+#include "cache.h"
+
+/* create and initialize a general cache structure */
+struct cache_t *			/* pointer to cache created */
+cache_create(char *name,		/* name of the cache */
+	     int nsets,			/* total number of sets in cache */
+	     int bsize,			/* block (line) size of cache */
+	     int assoc,			/* associativity of cache */
+	     enum cache_policy policy,	/* replacement policy w/in sets */
+	     /* block access function, see description w/in struct cache def */
+	     unsigned int (*blk_access_fn)(enum mem_cmd cmd,
+					   md_addr_t baddr, int bsize,
+					   tick_t now),
+	     unsigned int hit_latency,	/* latency in cycles for a hit */
+	     int nmshrs)		/* number of MSHRs, 0 for no limit */
+{
+  struct cache_t *cp;
+
+  /* check all cache parameters */
+  if (nsets <= 0)
+    fatal("cache size (in sets) `%d' must be non-zero", nsets);
+  if ((nsets & (nsets-1)) != 0)
+    fatal("cache size (in sets) `%d' is not a power of two", nsets);
+  /* blocks must be at least one datum large, i.e., 8 bytes for SS */
+  if (bsize < 8)
+    fatal("cache block size (in bytes) `%d' must be 8 or greater", bsize);
+  if ((bsize & (bsize-1)) != 0)
+    fatal("cache block size (in bytes) `%d' must be a power of two", bsize);
+  if (assoc <= 0)
+    fatal("cache associativity `%d' must be non-zero and positive", assoc);
+  if ((assoc & (assoc-1)) != 0)
+    fatal("cache associativity `%d' must be a power of two", assoc);
+  if (hit_latency < 1)
+    fatal("cache hit latency `%d' must be at least one cycle", hit_latency);
+  if (nmshrs < 0)
+    fatal("number of MSHRs `%d' must be positive", nmshrs);
+  if (!blk_access_fn)
+    fatal("must specify miss/replacement functions");
+
+  cp = (struct cache_t *)calloc(1, sizeof(struct cache_t));
+  if (!cp)
+    fatal("out of virtual memory");
+
+  /* initialize user parameters */
+  cp->name = mystrdup(name);
+  cp->nsets = nsets;
+  cp->bsize = bsize;
+  cp->assoc = assoc;
+  cp->policy = policy;
+  cp->hit_latency = hit_latency;
+  cp->nmshrs = nmshrs;
+  cp->blk_access_fn = blk_access_fn;
+
+  /* compute derived parameters */
+  cp->blk_mask = bsize-1;
+  cp->set_shift = log_base2(bsize);
+  cp->set_mask = nsets-1;
+  cp->tag_shift = cp->set_shift + log_base2(nsets);
+
+  cp->data = (struct cache_blk_t *)
+    calloc(nsets * assoc, sizeof(struct cache_blk_t));
+  if (!cp->data)
+    fatal("out of virtual memory");
+  if (nmshrs)
+    {
+      cp->mshrs = (struct cache_mshr_t *)
+	calloc(nmshrs, sizeof(struct cache_mshr_t));
+      if (!cp->mshrs)
+	fatal("out of virtual memory");
+    }
+
+  return cp;
+}
+
+/* parse policy */
+enum cache_policy			/* replacement policy enum */
+cache_char2policy(char c)		/* replacement policy as a char */
+{
+  switch (c) {
+  case 'l': return LRU;
+  case 'r': return Random;
+  case 'f': return FIFO;
+  default: fatal("bogus replacement policy, `%c'", c);
+  }
+}
+
+/* print cache configuration */
+void
+cache_config(struct cache_t *cp,	/* cache instance */
+	     FILE *stream)		/* output stream */
+{
+  fprintf(stream,
+	  "cache: %s: %d sets, %d byte blocks, %d bytes user data/block\n",
+	  cp->name, cp->nsets, cp->bsize, cp->bsize);
+  fprintf(stream,
+	  "cache: %s: %d-way, `%s' replacement policy, write-back\n",
+	  cp->name, cp->assoc,
+	  cp->policy == LRU ? "LRU"
+	  : cp->policy == Random ? "Random"
+	  : cp->policy == FIFO ? "FIFO"
+	  : (abort(), ""));
+  if (cp->nmshrs)
+    fprintf(stream, "cache: %s: %d cycle hits, %d MSHRs\n",
+	    cp->name, cp->hit_latency, cp->nmshrs);
+  else
+    fprintf(stream, "cache: %s: %d cycle hits, unlimited misses\n",
+	    cp->name, cp->hit_latency);
+}
+
+/* register cache stats */
+void
+cache_reg_stats(struct cache_t *cp,	/* cache instance */
+		struct stat_sdb_t *sdb)	/* stats database */
+{
+  char buf[512], buf1[512], *name;
+
+  /* get a name for this cache */
+  if (!cp->name || !cp->name[0])
+    name = "<unknown>";
+  else
+    name = cp->name;
+
+  sprintf(buf, "%s.accesses", name);
+  sprintf(buf1, "%s.hits + %s.misses + %s.mshr_hits", name, name, name);
+  stat_reg_formula(sdb, mystrdup(buf), "total number of accesses",
+		   mystrdup(buf1), "%12.0f");
+  sprintf(buf, "%s.hits", name);
+  stat_reg_counter(sdb, mystrdup(buf), "total number of hits",
+		   &cp->hits, 0, NULL);
+  sprintf(buf, "%s.misses", name);
+  stat_reg_counter(sdb, mystrdup(buf), "total number of misses",
+		   &cp->misses, 0, NULL);
+  sprintf(buf, "%s.mshr_hits", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of misses merged with an outstanding miss",
+		   &cp->mshr_hits, 0, NULL);
+  sprintf(buf, "%s.mshr_full", name);
+  stat_reg_counter(sdb, mystrdup(buf),
+		   "total number of misses retried, all MSHRs were busy",
+		   &cp->mshr_full, 0, NULL);
+  sprintf(buf, "%s.replacements", name);
+  stat_reg_counter(sdb, mystrdup(buf), "total number of replacements",
+		   &cp->replacements, 0, NULL);
+  sprintf(buf, "%s.writebacks", name);
+  stat_reg_counter(sdb, mystrdup(buf), "total number of writebacks",
+		   &cp->writebacks, 0, NULL);
+  sprintf(buf, "%s.miss_rate", name);
+  sprintf(buf1, "(%s.misses + %s.mshr_hits) / %s.accesses",
+	  name, name, name);
+  stat_reg_formula(sdb, mystrdup(buf), "miss rate (i.e., misses/ref)",
+		   mystrdup(buf1), NULL);
+  sprintf(buf, "%s.repl_rate", name);
+  sprintf(buf1, "%s.replacements / %s.accesses", name, name);
+  stat_reg_formula(sdb, mystrdup(buf), "replacement rate (i.e., repls/ref)",
+		   mystrdup(buf1), NULL);
+  sprintf(buf, "%s.wb_rate", name);
+  sprintf(buf1, "%s.writebacks / %s.accesses", name, name);
+  stat_reg_formula(sdb, mystrdup(buf), "writeback rate (i.e., wrbks/ref)",
+		   mystrdup(buf1), NULL);
+}
+
+/* move block I of set SET to the head of the set, shifting the blocks
+   before it down one way */
+static void
+cache_move_to_head(struct cache_blk_t *set,	/* first block of the set */
+		   int i)			/* block to move */
+{
+  struct cache_blk_t blk = set[i];
+
+  memmove(&set[1], &set[0], i * sizeof(struct cache_blk_t));
+  set[0] = blk;
+}
+
+/* access the block holding ADDR at cycle NOW, returns the latency of the
+   access in cycles, or CACHE_MSHR_FULL if the access misses and no MSHR
+   is free */
+int					/* latency of access in cycles */
+cache_access(struct cache_t *cp,	/* cache to access */
+	     enum mem_cmd cmd,		/* access type, Read or Write */
+	     md_addr_t addr,		/* address of access */
+	     tick_t now)		/* time of access */
+{
+  md_addr_t tag = addr >> cp->tag_shift;
+  md_addr_t set_index = (addr >> cp->set_shift) & cp->set_mask;
+  md_addr_t baddr = addr & ~cp->blk_mask;
+  struct cache_blk_t *set = &cp->data[set_index * cp->assoc];
+  struct cache_mshr_t *mshr = NULL;
+  tick_t ready;
+  int i, victim;
+
+  /* look for the block in its set */
+  for (i=0; i < cp->assoc; i++)
+    {
+      if (set[i].valid && set[i].tag == tag)
+	break;
+    }
+
+  if (i < cp->assoc)
+    {
+      /* hit, or a hit on a block whose fill is still on its way */
+      if (set[i].ready > now + cp->hit_latency)
+	{
+	  cp->mshr_hits++;
+	  ready = set[i].ready;
+	}
+      else
+	{
+	  cp->hits++;
+	  ready = now + cp->hit_latency;
+	}
+      if (cmd == Write)
+	set[i].dirty = TRUE;
+      if (cp->policy == LRU)
+	cache_move_to_head(set, i);
+      return (int)(ready - now);
+    }
+
+  /* miss, find a free MSHR to track it */
+  if (cp->nmshrs)
+    {
+      for (i=0; i < cp->nmshrs; i++)
+	{
+	  if (cp->mshrs[i].ready <= now)
+	    {
+	      mshr = &cp->mshrs[i];
+	      break;
+	    }
+	}
+      if (!mshr)
+	{
+	  cp->mshr_full++;
+	  return CACHE_MSHR_FULL;
+	}
+    }
+  cp->misses++;
+
+  /* select the block to replace, invalid blocks go first */
+  for (victim=0; victim < cp->assoc; victim++)
+    {
+      if (!set[victim].valid)
+	break;
+    }
+  if (victim == cp->assoc)
+    {
+      cp->replacements++;
+      switch (cp->policy)
+	{
+	case LRU:
+	case FIFO:
+	  victim = cp->assoc - 1;
+	  break;
+	case Random:
+	  victim = myrand() & (cp->assoc - 1);
+	  break;
+	default:
+	  panic("bogus replacement policy");
+	}
+    }
+
+  /* write back a dirty victim, then fetch the missing block */
+  ready = now + cp->hit_latency;
+  if (set[victim].valid && set[victim].dirty)
+    {
+      cp->writebacks++;
+      ready += cp->blk_access_fn(Write,
+				 (set[victim].tag << cp->tag_shift)
+				 | (set_index << cp->set_shift),
+				 cp->bsize, ready);
+    }
+  ready += cp->blk_access_fn(Read, baddr, cp->bsize, ready);
+
+  /* install the block now, it becomes usable when its fill arrives */
+  set[victim].tag = tag;
+  set[victim].valid = TRUE;
+  set[victim].dirty = (cmd == Write);
+  set[victim].ready = ready;
+  cache_move_to_head(set, victim);
+
+  if (mshr)
+    {
+      mshr->baddr = baddr;
+      mshr->ready = ready;
+    }
+
+  return (int)(ready - now);
+}
@@ -0,0 +1,185 @@
+/* cache.h - cache module interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "memory.h"
+#include "stats.h"
+
+/*
+ * This module models the timing of a write-back, write-allocate cache;
+ * data itself always lives in simulated memory.  Every access returns its
+ * latency in cycles: the hit latency, or for a miss the hit latency plus
+ * the latency of the miss handler BLK_ACCESS_FN, which typically accesses
+ * the next level of the hierarchy or main memory.  Evicting a dirty block
+ * calls the miss handler to write it back.
+ *
+ * Caches are non-blocking: a missing block is installed at once, with the
+ * cycle its fill arrives, so a later access to the same block merges with
+ * the outstanding miss, and accesses to other blocks may hit under the
+ * miss.  A cache created with NMSHRS miss status holding registers tracks
+ * at most NMSHRS outstanding misses to different blocks; a further miss
+ * cannot be accepted and returns CACHE_MSHR_FULL, the caller retries it
+ * later.  NMSHRS of 0 puts no limit on outstanding misses.
+ */
+
+/* cache replacement policy */
+enum cache_policy {
+  LRU,		/* replace least recently used block (perfect LRU) */
+  Random,	/* replace a random block */
+  FIFO		/* replace the oldest block in the set */
+};
+
+/* cache_access() result when all MSHRs hold outstanding misses */
+#define CACHE_MSHR_FULL		(-1)
+
+/* cache block (or line) definition */
+struct cache_blk_t
+{
+  md_addr_t tag;		/* data block tag value */
+  int valid;			/* block holds data? */
+  int dirty;			/* block written since it was filled? */
+  tick_t ready;			/* cycle the block's fill arrives */
+};
+
+/* miss status holding register, tracks one outstanding miss */
+struct cache_mshr_t
+{
+  md_addr_t baddr;		/* address of the block being filled */
+  tick_t ready;			/* cycle the fill arrives */
+};
+
+/* cache definition */
+struct cache_t
+{
+  /* parameters */
+  char *name;			/* cache name */
+  int nsets;			/* number of sets */
+  int bsize;			/* block size in bytes */
+  int assoc;			/* cache associativity */
+  enum cache_policy policy;	/* cache replacement policy */
+  unsigned int hit_latency;	/* cache hit latency */
+  int nmshrs;			/* number of MSHRs, 0 for no limit */
+
+  /* miss/replacement handler, read or write BSIZE bytes starting at BADDR
+     from/into the next level at cycle NOW, returns the latency of the
+     operation */
+  unsigned int					/* latency of block access */
+    (*blk_access_fn)(enum mem_cmd cmd,		/* block access command */
+		     md_addr_t baddr,		/* program address to access */
+		     int bsize,			/* size of the cache block */
+		     tick_t now);		/* time of access */
+
+  /* derived data, for fast decoding */
+  md_addr_t blk_mask;
+  int set_shift;
+  md_addr_t set_mask;
+  int tag_shift;
+
+  /* per-cache stats */
+  counter_t hits;		/* total number of hits */
+  counter_t misses;		/* total number of misses */
+  counter_t mshr_hits;		/* misses merged with an outstanding miss */
+  counter_t mshr_full;		/* misses rejected, all MSHRs were busy */
+  counter_t replacements;	/* total number of replacements at misses */
+  counter_t writebacks;		/* total number of writebacks at misses */
+
+  struct cache_mshr_t *mshrs;	/* miss status holding registers */
+
+  /* NSETS*ASSOC blocks, each set ordered from most to least recently used
+     (LRU) or from most to least recently filled (FIFO, Random) */
+  struct cache_blk_t *data;
+};
+
+/* create and initialize a general cache structure */
+struct cache_t *			/* pointer to cache created */
+cache_create(char *name,		/* name of the cache */
+	     int nsets,			/* total number of sets in cache */
+	     int bsize,			/* block (line) size of cache */
+	     int assoc,			/* associativity of cache */
+	     enum cache_policy policy,	/* replacement policy w/in sets */
+	     /* block access function, see description w/in struct cache def */
+	     unsigned int (*blk_access_fn)(enum mem_cmd cmd,
+					   md_addr_t baddr, int bsize,
+					   tick_t now),
+	     unsigned int hit_latency,	/* latency in cycles for a hit */
+	     int nmshrs);		/* number of MSHRs, 0 for no limit */
+
+/* parse policy */
+enum cache_policy			/* replacement policy enum */
+cache_char2policy(char c);		/* replacement policy as a char */
+
+/* print cache configuration */
+void
+cache_config(struct cache_t *cp,	/* cache instance */
+	     FILE *stream);		/* output stream */
+
+/* register cache stats */
+void
+cache_reg_stats(struct cache_t *cp,	/* cache instance */
+		struct stat_sdb_t *sdb);/* stats database */
+
+/* access the block holding ADDR at cycle NOW, returns the latency of the
+   access in cycles, or CACHE_MSHR_FULL if the access misses and no MSHR
+   is free */
+int					/* latency of access in cycles */
+cache_access(struct cache_t *cp,	/* cache to access */
+	     enum mem_cmd cmd,		/* access type, Read or Write */
+	     md_addr_t addr,		/* address of access */
+	     tick_t now);		/* time of access */
+
+#endif /* CACHE_H */
@@ -51,10 +51,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #ifdef _MSC_VER
 #include <io.h>
 #else /* !_MSC_VER */
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #endif
 
 #include "host.h"
@@ -75,6 +80,11 @@
 
 #define EIO_FILE_HEADER							\
   "/* This is a SimpleScalar EIO file - DO NOT MOVE OR EDIT THIS LINE! */\n"
+
+/* binary EIO files carry this header line, then the same terms in the
+   binary EXO encoding (see libexo.h) */
+#define EIO_BIN_FILE_HEADER						\
+  "/* This is a SimpleScalar binary EIO file - DO NOT MOVE OR EDIT THIS LINE! */\n"
 /*
    EIO transaction format:
 
@@ -93,6 +103,442 @@
 /* EIO transaction count, i.e., number of last transaction completed */
 static counter_t eio_trans_icnt = -1;
 
+/* create new EIO files in the binary EXO encoding? */
+int eio_binary = FALSE;
+
+/* instructions between checkpoints embedded in EIO traces, 0 for none */
+unsigned int eio_chkpt_interval = 0;
+
+/* embedded checkpoints are single terms, tagged with this string, that
+   trace readers step over:
+
+   ("chkpt", icnt,
+    ... misc regs, integer regs and FP regs, as in a checkpoint ...
+    (icnt, PC, NPC, HI, LO, FCC), (r0, ...), (f0, ...),
+    ... break and stack limit ...
+    (brk, stack_min),
+    ... pages written since the previous checkpoint ...
+    ((addr, blob), ...)
+   )
+
+   binary traces end with an index of their embedded checkpoints,
+   ("index", ((icnt, offset), ...)), followed by an 8-byte blob holding the
+   offset of the index term, offsets count from the first term */
+#define EIO_CHKPT_TAG		"chkpt"
+#define EIO_INDEX_TAG		"index"
+
+/* size of the blob term at the end of an indexed binary trace */
+#define EIO_TRAILER_SIZE	(2 + 8)
+
+/* open binary EIO streams */
+#define EIO_MAX_BIN		8
+
+static struct eio_bin_t {
+  FILE *fd;				/* EIO stream, NULL if slot is free */
+  unsigned char *buf;			/* terms read from an input stream */
+  size_t size;				/* size of BUF */
+  int mapped;				/* BUF is mapped from the file? */
+  struct exo_reader_t rd;		/* reader over BUF */
+  struct exo_arena_t *arena;		/* arena for the terms read */
+} eio_bins[EIO_MAX_BIN];
+
+/* return the binary EIO state of stream FD, NULL for text streams */
+static struct eio_bin_t *
+eio_bin(FILE *fd)
+{
+  int i;
+
+  for (i=0; i < EIO_MAX_BIN; i++)
+    {
+      if (eio_bins[i].fd == fd)
+	return &eio_bins[i];
+    }
+  return NULL;
+}
+
+/* start binary EIO state for stream FD, for input the terms following the
+   current position of FD are mapped, or read in from a pipe */
+static struct eio_bin_t *
+eio_bin_open(FILE *fd, int input)
+{
+  struct eio_bin_t *bin;
+  size_t n, start = 0, maxsize = 64*1024;
+
+  bin = eio_bin(NULL);
+  if (!bin)
+    fatal("too many binary EIO files open");
+  bin->fd = fd;
+  bin->buf = NULL;
+  bin->size = 0;
+  bin->mapped = FALSE;
+  if (!bin->arena)
+    bin->arena = exo_arena_create();
+  if (!input)
+    return bin;
+
+#ifndef _MSC_VER
+  {
+    struct stat sbuf;
+    long pos = ftell(fd);
+    void *image;
+
+    if (pos >= 0
+	&& fstat(fileno(fd), &sbuf) == 0
+	&& S_ISREG(sbuf.st_mode)
+	&& sbuf.st_size >= pos)
+      {
+	image = mmap(NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE,
+		     fileno(fd), 0);
+	if (image != MAP_FAILED)
+	  {
+	    bin->buf = image;
+	    bin->size = sbuf.st_size;
+	    bin->mapped = TRUE;
+	    start = pos;
+	  }
+      }
+  }
+#endif /* !_MSC_VER */
+
+  if (!bin->mapped)
+    {
+      /* compressed, read the rest of the stream in */
+      for (;;)
+	{
+	  if (!bin->buf || bin->size == maxsize)
+	    {
+	      maxsize = bin->buf ? 2 * maxsize : maxsize;
+	      bin->buf = realloc(bin->buf, maxsize);
+	      if (!bin->buf)
+		fatal("out of virtual memory");
+	    }
+	  n = fread(bin->buf + bin->size, 1, maxsize - bin->size, fd);
+	  if (n == 0)
+	    break;
+	  bin->size += n;
+	}
+    }
+
+  exo_reader_init(&bin->rd, bin->buf + start, bin->size - start);
+  return bin;
+}
+
+/* read the next term from EIO stream FD, release it with eio_release() */
+static struct exo_term_t *
+eio_get(FILE *fd)
+{
+  struct eio_bin_t *bin = eio_bin(fd);
+
+  if (bin)
+    return exo_pull_tree(&bin->rd, bin->arena);
+  else
+    return exo_read(fd);
+}
+
+/* release term EXO read from EIO stream FD */
+static void
+eio_release(FILE *fd, struct exo_term_t *exo)
+{
+  struct eio_bin_t *bin = eio_bin(fd);
+
+  if (bin)
+    exo_arena_reset(bin->arena);
+  else if (exo)
+    exo_delete(exo);
+}
+
+/* EIO output streams are written by a background thread per stream, the
+   simulator only builds the terms and queues them, formatting, the write
+   and compression (by the gzip process behind a compressed stream) then
+   overlap with simulation */
+#define EIO_MAX_WRITER		8
+
+/* queued writes per output stream, the simulator blocks when full */
+#define EIO_QUEUE_SIZE		256
+
+/* a queued write: TEXT (if non-NULL), then term EXO (if non-NULL) */
+struct eio_job_t {
+  char *text;				/* raw text, or comment before EXO */
+  struct exo_term_t *exo;		/* term to write and release */
+  counter_t chkpt;			/* icnt of an embedded checkpoint EXO,
+					   or -1 */
+};
+
+static struct eio_writer_t {
+  FILE *fd;				/* EIO stream, NULL if slot is free */
+  int binary;				/* write the binary EXO encoding? */
+  pthread_t thread;			/* writer thread */
+  pthread_mutex_t lock;			/* protects the fields below */
+  pthread_cond_t not_empty;		/* signalled when a job is queued */
+  pthread_cond_t not_full;		/* signalled when a job is taken */
+  struct eio_job_t jobs[EIO_QUEUE_SIZE]; /* job ring */
+  int head, num;			/* next job and number of jobs queued */
+  int done;				/* no more jobs, writer should exit */
+
+  /* embedded checkpoint index, kept by the writer thread */
+  size_t pos;				/* offset of the next term written */
+  int nindex, maxindex;			/* entries used and allocated */
+  counter_t *index_icnt;		/* icnt of each checkpoint */
+  size_t *index_pos;			/* offset of each checkpoint */
+
+  /* embedded checkpoint state, kept by the simulator */
+  counter_t last_chkpt;			/* icnt of the last checkpoint */
+  struct mem_snap_t *snap;		/* memory as of the last checkpoint */
+} eio_writers[EIO_MAX_WRITER];
+
+/* return the writer of stream FD, NULL if FD is written directly */
+static struct eio_writer_t *
+eio_writer(FILE *fd)
+{
+  int i;
+
+  for (i=0; i < EIO_MAX_WRITER; i++)
+    {
+      if (eio_writers[i].fd == fd)
+	return &eio_writers[i];
+    }
+  return NULL;
+}
+
+/* write job JOB to stream FD, and release it, returns the number of bytes
+   written to a binary stream */
+static size_t
+eio_write_job(FILE *fd, int binary, struct eio_job_t *job)
+{
+  size_t n = 0;
+
+  if (binary)
+    {
+      if (job->exo)
+	n = exo_write(job->exo, fd);
+    }
+  else
+    {
+      if (job->text && job->exo)
+	fprintf(fd, "/* %s */\n", job->text);
+      else if (job->text)
+	fputs(job->text, fd);
+      if (job->exo)
+	{
+	  exo_print(job->exo, fd);
+	  fprintf(fd, "\n\n");
+	}
+    }
+  if (job->exo)
+    exo_delete(job->exo);
+  if (job->text)
+    free(job->text);
+  return n;
+}
+
+/* note an embedded checkpoint at icnt ICNT at the current offset of
+   writer W */
+static void
+eio_writer_index(struct eio_writer_t *w, counter_t icnt)
+{
+  if (w->nindex == w->maxindex)
+    {
+      w->maxindex = w->maxindex ? 2 * w->maxindex : 64;
+      w->index_icnt =
+	realloc(w->index_icnt, w->maxindex * sizeof(counter_t));
+      w->index_pos = realloc(w->index_pos, w->maxindex * sizeof(size_t));
+      if (!w->index_icnt || !w->index_pos)
+	fatal("out of virtual memory");
+    }
+  w->index_icnt[w->nindex] = icnt;
+  w->index_pos[w->nindex] = w->pos;
+  w->nindex++;
+}
+
+/* end the binary stream of writer W with its checkpoint index */
+static void
+eio_writer_trailer(struct eio_writer_t *w)
+{
+  int i;
+  size_t pos = w->pos, val;
+  unsigned char off[8];
+  struct exo_term_t *exo, *list = NULL;
+
+  for (i=0; i < w->nindex; i++)
+    list = exo_chain(list,
+		     exo_new(ec_list,
+			     exo_new(ec_integer,
+				     (exo_integer_t)w->index_icnt[i]),
+			     exo_new(ec_integer,
+				     (exo_integer_t)w->index_pos[i]),
+			     NULL));
+  exo = exo_new(ec_list, exo_new(ec_string, EIO_INDEX_TAG),
+		exo_new(ec_list, NULL), NULL);
+  exo->as_list.head->next->as_list.head = list;
+  w->pos += exo_write(exo, w->fd);
+  exo_delete(exo);
+
+  /* the index offset, little-endian */
+  for (i=0, val=pos; i < 8; i++, val >>= 8)
+    off[i] = (unsigned char)(val & 0xff);
+  exo = exo_new(ec_blob, 8, off);
+  w->pos += exo_write(exo, w->fd);
+  exo_delete(exo);
+}
+
+/* writer thread, drains the job queue of writer ARG until closed */
+static void *
+eio_writer_main(void *arg)
+{
+  struct eio_writer_t *w = arg;
+  struct eio_job_t job;
+
+  pthread_mutex_lock(&w->lock);
+  for (;;)
+    {
+      while (!w->num && !w->done)
+	pthread_cond_wait(&w->not_empty, &w->lock);
+      if (!w->num)
+	break;
+
+      job = w->jobs[w->head];
+      w->head = (w->head + 1) % EIO_QUEUE_SIZE;
+      w->num--;
+      pthread_cond_signal(&w->not_full);
+
+      /* write outside of the lock, so the simulator can keep queueing */
+      pthread_mutex_unlock(&w->lock);
+      if (job.chkpt != -1)
+	eio_writer_index(w, job.chkpt);
+      w->pos += eio_write_job(w->fd, w->binary, &job);
+      pthread_mutex_lock(&w->lock);
+    }
+  pthread_mutex_unlock(&w->lock);
+
+  if (w->binary && w->nindex > 0)
+    eio_writer_trailer(w);
+
+  fflush(w->fd);
+  return NULL;
+}
+
+/* stop the writer of stream FD, after all its queued jobs are written */
+static void
+eio_writer_stop(struct eio_writer_t *w)
+{
+  pthread_mutex_lock(&w->lock);
+  w->done = TRUE;
+  pthread_cond_signal(&w->not_empty);
+  pthread_mutex_unlock(&w->lock);
+
+  pthread_join(w->thread, NULL);
+  pthread_cond_destroy(&w->not_full);
+  pthread_cond_destroy(&w->not_empty);
+  pthread_mutex_destroy(&w->lock);
+  if (w->index_icnt)
+    free(w->index_icnt);
+  if (w->index_pos)
+    free(w->index_pos);
+  w->index_icnt = NULL;
+  w->index_pos = NULL;
+  if (w->snap)
+    mem_snap_free(w->snap);
+  w->snap = NULL;
+  w->fd = NULL;
+}
+
+/* flush all output streams still open at exit, so that a trace written up
+   to a fatal error is not lost */
+static void
+eio_writer_exit(void)
+{
+  int i;
+
+  for (i=0; i < EIO_MAX_WRITER; i++)
+    {
+      if (eio_writers[i].fd)
+	eio_writer_stop(&eio_writers[i]);
+    }
+}
+
+/* start a writer thread for output stream FD */
+static void
+eio_writer_start(FILE *fd, int binary)
+{
+  static int exit_hooked = FALSE;
+  struct eio_writer_t *w;
+
+  w = eio_writer(NULL);
+  if (!w)
+    fatal("too many EIO output files open");
+  w->fd = fd;
+  w->binary = binary;
+  w->head = w->num = 0;
+  w->done = FALSE;
+  w->pos = 0;
+  w->nindex = w->maxindex = 0;
+  w->last_chkpt = -1;
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->not_empty, NULL);
+  pthread_cond_init(&w->not_full, NULL);
+  if (pthread_create(&w->thread, NULL, eio_writer_main, w) != 0)
+    fatal("could not start EIO writer thread");
+
+  if (!exit_hooked)
+    {
+      atexit(eio_writer_exit);
+      exit_hooked = TRUE;
+    }
+}
+
+/* queue TEXT (copied, if non-NULL) and term EXO (if non-NULL) to writer W,
+   EXO is the embedded checkpoint at icnt CHKPT unless CHKPT is -1, waits
+   while the queue is full */
+static void
+eio_writer_put(struct eio_writer_t *w, char *text, struct exo_term_t *exo,
+	       counter_t chkpt)
+{
+  struct eio_job_t *job;
+
+  pthread_mutex_lock(&w->lock);
+  while (w->num == EIO_QUEUE_SIZE)
+    pthread_cond_wait(&w->not_full, &w->lock);
+
+  job = &w->jobs[(w->head + w->num) % EIO_QUEUE_SIZE];
+  job->text = text ? mystrdup(text) : NULL;
+  job->exo = exo;
+  job->chkpt = chkpt;
+  w->num++;
+  pthread_cond_signal(&w->not_empty);
+  pthread_mutex_unlock(&w->lock);
+}
+
+/* write term EXO to EIO stream FD, after comment COMMENT (if non-NULL) on
+   text streams, and release it */
+static void
+eio_put(FILE *fd, char *comment, struct exo_term_t *exo)
+{
+  struct eio_writer_t *w = eio_writer(fd);
+  struct eio_job_t job;
+
+  if (w)
+    eio_writer_put(w, w->binary ? NULL : comment, exo, /* !chkpt */-1);
+  else
+    {
+      job.text = comment ? mystrdup(comment) : NULL;
+      job.exo = exo;
+      job.chkpt = -1;
+      eio_write_job(fd, eio_bin(fd) != NULL, &job);
+    }
+}
+
+/* write raw text TEXT to text EIO stream FD, in order with its terms */
+static void
+eio_put_text(FILE *fd, char *text)
+{
+  struct eio_writer_t *w = eio_writer(fd);
+
+  if (w)
+    eio_writer_put(w, text, NULL, /* !chkpt */-1);
+  else
+    fputs(text, fd);
+}
+
 FILE *
 eio_create(char *fname)
 {
@@ -107,17 +553,28 @@ eio_create(char *fname)
     fatal("unable to create EIO file `%s'", fname);
 
   /* emit EIO file header */
-  fprintf(fd, "%s\n", EIO_FILE_HEADER);
-  fprintf(fd, "/* file_format: %d, file_version: %d, big_endian: %d */\n", 
-	  MD_EIO_FILE_FORMAT, EIO_FILE_VERSION, ld_target_big_endian);
+  if (eio_binary)
+    {
+      fprintf(fd, "%s", EIO_BIN_FILE_HEADER);
+      eio_bin_open(fd, /* !input */FALSE);
+    }
+  else
+    {
+      fprintf(fd, "%s\n", EIO_FILE_HEADER);
+      fprintf(fd, "/* file_format: %d, file_version: %d, big_endian: %d */\n", 
+	      MD_EIO_FILE_FORMAT, EIO_FILE_VERSION, ld_target_big_endian);
+    }
+
+  /* the terms that follow are written in the background */
+  fflush(fd);
+  eio_writer_start(fd, eio_binary);
+
   exo = exo_new(ec_list,
 		exo_new(ec_integer, (exo_integer_t)MD_EIO_FILE_FORMAT),
 		exo_new(ec_integer, (exo_integer_t)EIO_FILE_VERSION),
 		exo_new(ec_integer, (exo_integer_t)target_big_endian),
 		NULL);
-  exo_print(exo, fd);
-  exo_delete(exo);
-  fprintf(fd, "\n\n");
+  eio_put(fd, NULL, exo);
 
   return fd;
 }
@@ -126,6 +583,7 @@ FILE *
 eio_open(char *fname)
 {
   FILE *fd;
+  char buf[512];
   struct exo_term_t *exo;
   int file_format, file_version, big_endian, target_big_endian;
 
@@ -135,8 +593,16 @@ eio_open(char *fname)
   if (!fd)
     fatal("unable to open EIO file `%s'", fname);
 
+  /* the header line tells the encoding */
+  if (!fgets(buf, 512, fd))
+    fatal("could not read EIO file header");
+  if (!strcmp(buf, EIO_BIN_FILE_HEADER))
+    eio_bin_open(fd, /* input */TRUE);
+  else if (strcmp(buf, EIO_FILE_HEADER))
+    fatal("`%s' is not an EIO file", fname);
+
   /* read and check EIO file header */
-  exo = exo_read(fd);
+  exo = eio_get(fd);
   if (!exo
       || exo->ec != ec_list
       || !exo->as_list.head
@@ -151,7 +617,7 @@ eio_open(char *fname)
   file_format = exo->as_list.head->as_integer.val;
   file_version = exo->as_list.head->next->as_integer.val;
   big_endian = exo->as_list.head->next->next->as_integer.val;
-  exo_delete(exo);
+  eio_release(fd, exo);
 
   if (file_format != MD_EIO_FILE_FORMAT)
     fatal("EIO file `%s' has incompatible format", fname);
@@ -187,8 +653,11 @@ eio_valid(char *fname)
   fgets(buf, 512, fd);
 
   /* check the header */
-  if (strcmp(buf, EIO_FILE_HEADER))
-    return FALSE;
+  if (strcmp(buf, EIO_FILE_HEADER) && strcmp(buf, EIO_BIN_FILE_HEADER))
+    {
+      gzclose(fd);
+      return FALSE;
+    }
 
   /* all done, close up file */
   gzclose(fd);
@@ -200,6 +669,23 @@ eio_valid(char *fname)
 void
 eio_close(FILE *fd)
 {
+  struct eio_bin_t *bin = eio_bin(fd);
+  struct eio_writer_t *w = eio_writer(fd);
+
+  /* drain all queued writes first */
+  if (w)
+    eio_writer_stop(w);
+
+  if (bin)
+    {
+#ifndef _MSC_VER
+      if (bin->mapped)
+	munmap(bin->buf, bin->size);
+      else
+#endif /* !_MSC_VER */
+	free(bin->buf);
+      bin->fd = NULL;
+    }
   gzclose(fd);
 }
 
@@ -211,78 +697,60 @@ eio_write_chkpt(struct regs_t *regs,		/* regs to dump */
 		FILE *fd)			/* stream to write to */
 {
   int i;
+  char buf[128];
   struct exo_term_t *exo;
   struct mem_pte_t *pte;
+  struct eio_writer_t *w;
 
-  myfprintf(fd, "/* ** start checkpoint @ %n... */\n\n", eio_trans_icnt);
+  if (!eio_bin(fd))
+    {
+      mysprintf(buf, "/* ** start checkpoint @ %n... */\n\n", eio_trans_icnt);
+      eio_put_text(fd, buf);
+    }
 
-  myfprintf(fd, "/* EIO file pointer: %n... */\n", eio_trans_icnt);
   exo = exo_new(ec_integer, (exo_integer_t)eio_trans_icnt);
-  exo_print(exo, fd);
-  fprintf(fd, "\n\n");
-  exo_delete(exo);
+  eio_put(fd, "EIO file pointer...", exo);
 
   /* dump misc regs: icnt, PC, NPC, etc... */
-  fprintf(fd, "/* misc regs icnt, PC, NPC, etc... */\n");
   exo = MD_MISC_REGS_TO_EXO(regs);
-  exo_print(exo, fd);
-  fprintf(fd, "\n\n");
-  exo_delete(exo);
+  eio_put(fd, "misc regs icnt, PC, NPC, etc...", exo);
 
   /* dump integer registers */
-  fprintf(fd, "/* integer regs */\n");
   exo = exo_new(ec_list, NULL);
   for (i=0; i < MD_NUM_IREGS; i++)
     exo->as_list.head = exo_chain(exo->as_list.head, MD_IREG_TO_EXO(regs, i));
-  exo_print(exo, fd);
-  fprintf(fd, "\n\n");
-  exo_delete(exo);
+  eio_put(fd, "integer regs", exo);
 
   /* dump FP registers */
-  fprintf(fd, "/* FP regs (integer format) */\n");
   exo = exo_new(ec_list, NULL);
   for (i=0; i < MD_NUM_FREGS; i++)
     exo->as_list.head = exo_chain(exo->as_list.head, MD_FREG_TO_EXO(regs, i));
-  exo_print(exo, fd);
-  fprintf(fd, "\n\n");
-  exo_delete(exo);
+  eio_put(fd, "FP regs (integer format)", exo);
 
-  fprintf(fd, "/* writing `%d' memory pages... */\n", (int)mem->page_count);
   exo = exo_new(ec_list,
 		exo_new(ec_integer, (exo_integer_t)mem->page_count),
 		exo_new(ec_address, (exo_integer_t)ld_brk_point),
 		exo_new(ec_address, (exo_integer_t)ld_stack_min),
 		NULL);
-  exo_print(exo, fd);
-  fprintf(fd, "\n\n");
-  exo_delete(exo);
+  eio_put(fd, "memory page count, break and stack limit", exo);
 
-  fprintf(fd, "/* text segment specifiers (base & size) */\n");
   exo = exo_new(ec_list,
 		exo_new(ec_address, (exo_integer_t)ld_text_base),
 		exo_new(ec_integer, (exo_integer_t)ld_text_size),
 		NULL);
-  exo_print(exo, fd);
-  fprintf(fd, "\n\n");
-  exo_delete(exo);
+  eio_put(fd, "text segment specifiers (base & size)", exo);
 
-  fprintf(fd, "/* data segment specifiers (base & size) */\n");
   exo = exo_new(ec_list,
 		exo_new(ec_address, (exo_integer_t)ld_data_base),
 		exo_new(ec_integer, (exo_integer_t)ld_data_size),
 		NULL);
-  exo_print(exo, fd);
-  fprintf(fd, "\n\n");
-  exo_delete(exo);
+  eio_put(fd, "data segment specifiers (base & size)", exo);
 
-  fprintf(fd, "/* stack segment specifiers (base & size) */\n");
   exo = exo_new(ec_list,
 		exo_new(ec_address, (exo_integer_t)ld_stack_base),
 		exo_new(ec_integer, (exo_integer_t)ld_stack_size),
 		NULL);
-  exo_print(exo, fd);
-  fprintf(fd, "\n\n");
-  exo_delete(exo);
+  eio_put(fd, "stack segment specifiers (base & size)", exo);
 
   /* visit all active memory pages, and dump them to the checkpoint file */
   MEM_FORALL(mem, i, pte)
@@ -292,12 +760,25 @@ eio_write_chkpt(struct regs_t *regs,		/* regs to dump */
 		    exo_new(ec_address, (exo_integer_t)MEM_PTE_ADDR(pte, i)),
 		    exo_new(ec_blob, MD_PAGE_SIZE, pte->page),
 		    NULL);
-      exo_print(exo, fd);
-      fprintf(fd, "\n\n");
-      exo_delete(exo);
+      eio_put(fd, NULL, exo);
+    }
+
+  if (!eio_bin(fd))
+    {
+      mysprintf(buf, "/* ** end checkpoint @ %n... */\n\n", eio_trans_icnt);
+      eio_put_text(fd, buf);
     }
 
-  myfprintf(fd, "/* ** end checkpoint @ %n... */\n\n", eio_trans_icnt);
+  /* checkpoints embedded later in the stream hold the pages written after
+     this one */
+  w = eio_writer(fd);
+  if (w && eio_chkpt_interval)
+    {
+      if (w->snap)
+	mem_snap_free(w->snap);
+      w->snap = mem_snapshot(mem);
+      w->last_chkpt = sim_num_insn;
+    }
 
   return eio_trans_icnt;
 }
@@ -314,20 +795,20 @@ eio_read_chkpt(struct regs_t *regs,		/* regs to dump */
   struct exo_term_t *exo, *elt;
 
   /* read the EIO file pointer */
-  exo = exo_read(fd);
+  exo = eio_get(fd);
   if (!exo
       || exo->ec != ec_integer)
     fatal("could not read EIO file pointer");
   trans_icnt = exo->as_integer.val;
-  exo_delete(exo);
+  eio_release(fd, exo);
 
   /* read misc regs: icnt, PC, NPC, HI, LO, FCC */
-  exo = exo_read(fd);
+  exo = eio_get(fd);
   MD_EXO_TO_MISC_REGS(exo, sim_num_insn, regs);
-  exo_delete(exo);
+  eio_release(fd, exo);
 
   /* read integer registers */
-  exo = exo_read(fd);
+  exo = eio_get(fd);
   if (!exo
       || exo->ec != ec_list)
     fatal("could not read EIO integer regs");
@@ -345,10 +826,10 @@ eio_read_chkpt(struct regs_t *regs,		/* regs to dump */
     }
   if (elt != NULL)
     fatal("could not read EIO integer regs (too many)");
-  exo_delete(exo);
+  eio_release(fd, exo);
 
   /* read FP registers */
-  exo = exo_read(fd);
+  exo = eio_get(fd);
   if (!exo
       || exo->ec != ec_list)
     fatal("could not read EIO FP regs");
@@ -366,10 +847,10 @@ eio_read_chkpt(struct regs_t *regs,		/* regs to dump */
     }
   if (elt != NULL)
     fatal("could not read EIO FP regs (too many)");
-  exo_delete(exo);
+  eio_release(fd, exo);
 
   /* read the number of page defs, and memory config */
-  exo = exo_read(fd);
+  exo = eio_get(fd);
   if (!exo
       || exo->ec != ec_list
       || !exo->as_list.head
@@ -383,10 +864,10 @@ eio_read_chkpt(struct regs_t *regs,		/* regs to dump */
   page_count = exo->as_list.head->as_integer.val;
   ld_brk_point = (md_addr_t)exo->as_list.head->next->as_address.val;
   ld_stack_min = (md_addr_t)exo->as_list.head->next->next->as_address.val;
-  exo_delete(exo);
+  eio_release(fd, exo);
 
   /* read text segment specifiers */
-  exo = exo_read(fd);
+  exo = eio_get(fd);
   if (!exo
       || exo->ec != ec_list
       || !exo->as_list.head
@@ -397,10 +878,10 @@ eio_read_chkpt(struct regs_t *regs,		/* regs to dump */
     fatal("count not read EIO text segment specifiers");
   ld_text_base = (md_addr_t)exo->as_list.head->as_address.val;
   ld_text_size = (unsigned int)exo->as_list.head->next->as_integer.val;
-  exo_delete(exo);
+  eio_release(fd, exo);
 
   /* read data segment specifiers */
-  exo = exo_read(fd);
+  exo = eio_get(fd);
   if (!exo
       || exo->ec != ec_list
       || !exo->as_list.head
@@ -411,10 +892,10 @@ eio_read_chkpt(struct regs_t *regs,		/* regs to dump */
     fatal("count not read EIO data segment specifiers");
   ld_data_base = (md_addr_t)exo->as_list.head->as_address.val;
   ld_data_size = (unsigned int)exo->as_list.head->next->as_integer.val;
-  exo_delete(exo);
+  eio_release(fd, exo);
 
   /* read stack segment specifiers */
-  exo = exo_read(fd);
+  exo = eio_get(fd);
   if (!exo
       || exo->ec != ec_list
       || !exo->as_list.head
@@ -425,16 +906,15 @@ eio_read_chkpt(struct regs_t *regs,		/* regs to dump */
     fatal("count not read EIO stack segment specifiers");
   ld_stack_base = (md_addr_t)exo->as_list.head->as_address.val;
   ld_stack_size = (unsigned int)exo->as_list.head->next->as_integer.val;
-  exo_delete(exo);
+  eio_release(fd, exo);
 
   for (i=0; i < page_count; i++)
     {
-      int j;
       md_addr_t page_addr;
       struct exo_term_t *blob;
 
       /* read the page */
-      exo = exo_read(fd);
+      exo = eio_get(fd);
       if (!exo
 	  || exo->ec != ec_list
 	  || !exo->as_list.head
@@ -446,17 +926,10 @@ eio_read_chkpt(struct regs_t *regs,		/* regs to dump */
       page_addr = (md_addr_t)exo->as_list.head->as_address.val;
       blob = exo->as_list.head->next;
 
-      /* write data to simulator memory */
-      for (j=0; j < blob->as_blob.size; j++)
-	{
-	  byte_t val;
-
-	  val = blob->as_blob.data[j];
-	  /* unchecked access... */
-	  MEM_WRITE_BYTE(mem, page_addr, val);
-	  page_addr++;
-	}
-      exo_delete(exo);
+      /* write data to simulator memory, a page at a time */
+      mem_bulk_access(mem, Write, page_addr,
+		      blob->as_blob.data, blob->as_blob.size);
+      eio_release(fd, exo);
     }
 
   return trans_icnt;
@@ -564,6 +1037,69 @@ my_mem_fn(struct mem_t *mem,		/* memory space to access */
   return fault;
 }
 
+/* embed a checkpoint at instruction ICNT in the trace written by writer W,
+   called just after the system call at ICNT, it holds the state at the
+   next instruction and the pages written since the previous checkpoint */
+static void
+eio_embed_chkpt(struct eio_writer_t *w,		/* trace writer */
+		counter_t icnt,			/* instruction count */
+		struct regs_t *regs,		/* registers to dump */
+		struct mem_t *mem)		/* memory to dump */
+{
+  int i;
+  struct regs_t next;
+  struct exo_term_t *exo, *iregs, *fregs, *pages;
+  struct mem_pte_t *pte;
+
+  /* the system call is done, execution resumes at the next instruction */
+  next = *regs;
+  next.regs_PC = regs->regs_NPC;
+  next.regs_NPC = next.regs_PC + sizeof(md_inst_t);
+
+  iregs = exo_new(ec_list, NULL);
+  for (i=0; i < MD_NUM_IREGS; i++)
+    iregs->as_list.head = exo_chain(iregs->as_list.head,
+				    MD_IREG_TO_EXO(&next, i));
+  fregs = exo_new(ec_list, NULL);
+  for (i=0; i < MD_NUM_FREGS; i++)
+    fregs->as_list.head = exo_chain(fregs->as_list.head,
+				    MD_FREG_TO_EXO(&next, i));
+
+  /* pages written since the last checkpoint are no longer shared with its
+     snapshot, new pages never were */
+  pages = exo_new(ec_list, NULL);
+  MEM_FORALL(mem, i, pte)
+    {
+      if (!pte->shared)
+	{
+	  exo = exo_new(ec_list,
+			exo_new(ec_address, (exo_integer_t)MEM_PTE_ADDR(pte, i)),
+			exo_new(ec_blob, MD_PAGE_SIZE, pte->page),
+			NULL);
+	  exo->next = pages->as_list.head;
+	  pages->as_list.head = exo;
+	}
+    }
+
+  exo = exo_new(ec_list,
+		exo_new(ec_string, EIO_CHKPT_TAG),
+		exo_new(ec_integer, (exo_integer_t)icnt),
+		MD_MISC_REGS_TO_EXO(&next),
+		iregs, fregs,
+		exo_new(ec_list,
+			exo_new(ec_address, (exo_integer_t)ld_brk_point),
+			exo_new(ec_address, (exo_integer_t)ld_stack_min),
+			NULL),
+		pages,
+		NULL);
+  eio_writer_put(w, w->binary ? NULL : "embedded checkpoint", exo, icnt);
+
+  /* the next checkpoint starts from this one */
+  mem_snap_free(w->snap);
+  w->snap = mem_snapshot(mem);
+  w->last_chkpt = icnt;
+}
+
 /* syscall proxy handler, with EIO tracing support, architect registers
    and memory are assumed to be precise when this function is called,
    register and memory are updated with the results of the sustem call */
@@ -577,6 +1113,7 @@ eio_write_trace(FILE *eio_fd,			/* EIO stream file desc */
 {
   int i;
   struct exo_term_t *exo;
+  struct eio_writer_t *w;
 
   /* write syscall register inputs ($r2..$r7) */
   input_regs = exo_new(ec_list, NULL);
@@ -619,14 +1156,27 @@ eio_write_trace(FILE *eio_fd,			/* EIO stream file desc */
 		input_regs, input_mem,
 		output_regs, output_mem,
 		NULL);
-  exo_print(exo, eio_fd);
-  fprintf(eio_fd, "\n\n");
-
-  /* release input storage */
-  exo_delete(exo);
+  /* write and release the transaction */
+  eio_put(eio_fd, NULL, exo);
 
   /* one more transaction processed */
   eio_trans_icnt = icnt;
+
+  /* time for another embedded checkpoint? */
+  w = eio_writer(eio_fd);
+  if (w && w->snap && icnt - w->last_chkpt >= (counter_t)eio_chkpt_interval)
+    eio_embed_chkpt(w, icnt, regs, mem);
+}
+
+/* returns non-zero if term EXO is a checkpoint embedded in a trace */
+static int
+eio_is_chkpt(struct exo_term_t *exo)
+{
+  return (exo
+	  && exo->ec == ec_list
+	  && exo->as_list.head
+	  && exo->as_list.head->ec == ec_string
+	  && !strcmp((char *)exo->as_list.head->as_string.str, EIO_CHKPT_TAG));
 }
 
 /* syscall proxy handler from an EIO trace, architect registers
@@ -652,8 +1202,14 @@ eio_read_trace(FILE *eio_fd,			/* EIO stream file desc */
       panic("returned from exit() system call");
     }
 
-  /* else, read the external I/O (EIO) transaction */
-  exo = exo_read(eio_fd);
+  /* else, read the external I/O (EIO) transaction, stepping over any
+     embedded checkpoints */
+  exo = eio_get(eio_fd);
+  while (eio_is_chkpt(exo))
+    {
+      eio_release(eio_fd, exo);
+      exo = eio_get(eio_fd);
+    }
 
   /* one more transaction processed */
   eio_trans_icnt = icnt;
@@ -738,17 +1294,9 @@ eio_read_trace(FILE *eio_fd,			/* EIO stream file desc */
       /* simulate view'able I/O */
       if (MD_OUTPUT_SYSCALL(regs))
 	{
-	  if (sim_progfd)
-	    {
-	      /* redirect program output to file */
-	      fwrite(blob->as_blob.data, 1, blob->as_blob.size, sim_progfd);
-	    }
-	  else
-	    {
-	      /* write the output to stdout/stderr */
-	      write(MD_STREAM_FILENO(regs),
-		    blob->as_blob.data, blob->as_blob.size);
-	    }
+	  /* through the program output buffer, see syscall.c */
+	  sys_output(MD_STREAM_FILENO(regs),
+		     blob->as_blob.data, blob->as_blob.size);
 	}
     }
 
@@ -807,7 +1355,7 @@ eio_read_trace(FILE *eio_fd,			/* EIO stream file desc */
     }
 
   /* release the EIO EXO node */
-  exo_delete(exo);
+  eio_release(eio_fd, exo);
 }
 
 /* fast forward EIO trace EIO_FD to the transaction just after ICNT */
@@ -815,8 +1363,38 @@ void
 eio_fast_forward(FILE *eio_fd, counter_t icnt)
 {
   struct exo_term_t *exo, *exo_icnt;
+  struct eio_bin_t *bin = eio_bin(eio_fd);
 
-  do
+  if (bin)
+    {
+      struct exo_term_t trans, icnt_term;
+
+      /* pull each transaction's ICNT and skip the rest, no tree is built */
+      for (;;)
+	{
+	  if (!exo_pull(&bin->rd, &trans))
+	    fatal("could not fast forward to EIO checkpoint");
+	  if (trans.ec != ec_list
+	      || !exo_pull(&bin->rd, &icnt_term)
+	      || (icnt_term.ec != ec_integer && icnt_term.ec != ec_string))
+	    fatal("cannot read EIO transaction (during fast forward)");
+	  while (exo_peek(&bin->rd) != ec_null)
+	    exo_skip(&bin->rd);
+	  exo_pull(&bin->rd, &trans);
+
+	  /* embedded checkpoints are not transactions */
+	  if (icnt_term.ec == ec_string)
+	    continue;
+
+	  /* one more transaction processed */
+	  eio_trans_icnt = icnt;
+
+	  if ((counter_t)icnt_term.as_integer.val == icnt)
+	    return;
+	}
+    }
+
+  for (;;)
     {
       /* read the next external I/O (EIO) transaction */
       exo = exo_read(eio_fd);
@@ -824,6 +1402,13 @@ eio_fast_forward(FILE *eio_fd, counter_t icnt)
       if (!exo)
 	fatal("could not fast forward to EIO checkpoint");
 
+      /* embedded checkpoints are not transactions */
+      if (eio_is_chkpt(exo))
+	{
+	  exo_delete(exo);
+	  continue;
+	}
+
       /* one more transaction processed */
       eio_trans_icnt = icnt;
 
@@ -833,8 +1418,268 @@ eio_fast_forward(FILE *eio_fd, counter_t icnt)
 	  || !(exo_icnt = exo->as_list.head)
 	  || exo_icnt->ec != ec_integer)
 	fatal("cannot read EIO transaction (during fast forward)");
+
+      if ((counter_t)exo_icnt->as_integer.val == icnt)
+	break;
     }
-  while ((counter_t)exo_icnt->as_integer.val != icnt);
 
   /* found it! */
 }
+
+/* restore the embedded checkpoint CHKPT to REGS and MEM, returns its
+   instruction count */
+static counter_t
+eio_apply_chkpt(struct exo_term_t *chkpt,	/* embedded checkpoint */
+		struct regs_t *regs,		/* regs to restore */
+		struct mem_t *mem)		/* memory to restore */
+{
+  int i;
+  counter_t icnt;
+  struct exo_term_t *exo, *elt, *iregs, *fregs, *limits, *pages;
+
+  if (!eio_is_chkpt(chkpt)
+      || !(exo = chkpt->as_list.head->next)
+      || exo->ec != ec_integer
+      || !(exo = exo->next)
+      || !(iregs = exo->next)
+      || iregs->ec != ec_list
+      || !(fregs = iregs->next)
+      || fregs->ec != ec_list
+      || !(limits = fregs->next)
+      || limits->ec != ec_list
+      || !limits->as_list.head
+      || limits->as_list.head->ec != ec_address
+      || !limits->as_list.head->next
+      || limits->as_list.head->next->ec != ec_address
+      || !(pages = limits->next)
+      || pages->ec != ec_list
+      || pages->next != NULL)
+    fatal("could not read EIO embedded checkpoint");
+  icnt = (counter_t)chkpt->as_list.head->next->as_integer.val;
+
+  /* misc regs: icnt, PC, NPC, HI, LO, FCC */
+  MD_EXO_TO_MISC_REGS(exo, sim_num_insn, regs);
+
+  for (i=0, elt=iregs->as_list.head; i < MD_NUM_IREGS; i++, elt=elt->next)
+    {
+      if (!elt || elt->ec != ec_address)
+	fatal("could not read EIO integer regs (embedded checkpoint)");
+      MD_EXO_TO_IREG(elt, regs, i);
+    }
+  for (i=0, elt=fregs->as_list.head; i < MD_NUM_FREGS; i++, elt=elt->next)
+    {
+      if (!elt || elt->ec != ec_address)
+	fatal("could not read EIO FP regs (embedded checkpoint)");
+      MD_EXO_TO_FREG(elt, regs, i);
+    }
+
+  ld_brk_point = (md_addr_t)limits->as_list.head->as_address.val;
+  ld_stack_min = (md_addr_t)limits->as_list.head->next->as_address.val;
+
+  for (elt=pages->as_list.head; elt != NULL; elt=elt->next)
+    {
+      if (elt->ec != ec_list
+	  || !elt->as_list.head
+	  || elt->as_list.head->ec != ec_address
+	  || !elt->as_list.head->next
+	  || elt->as_list.head->next->ec != ec_blob
+	  || elt->as_list.head->next->next != NULL)
+	fatal("could not read EIO memory page (embedded checkpoint)");
+      mem_bulk_access(mem, Write,
+		      (md_addr_t)elt->as_list.head->as_address.val,
+		      elt->as_list.head->next->as_blob.data,
+		      elt->as_list.head->next->as_blob.size);
+    }
+
+  return icnt;
+}
+
+/* add checkpoint ICNT at offset POS to the index in *PICNT and *PPOS, which
+   has *PN entries */
+static void
+eio_index_add(counter_t icnt, size_t pos,
+	      counter_t **picnt, size_t **ppos, int *pn)
+{
+  if ((*pn & 63) == 0)
+    {
+      *picnt = realloc(*picnt, (*pn + 64) * sizeof(counter_t));
+      *ppos = realloc(*ppos, (*pn + 64) * sizeof(size_t));
+      if (!*picnt || !*ppos)
+	fatal("out of virtual memory");
+    }
+  (*picnt)[*pn] = icnt;
+  (*ppos)[*pn] = pos;
+  (*pn)++;
+}
+
+/* read the embedded checkpoint index of binary trace BIN into *PICNT and
+   *PPOS, from its trailer or else by scanning the trace, returns the
+   number of checkpoints */
+static int
+eio_read_index(struct eio_bin_t *bin, counter_t **picnt, size_t **ppos)
+{
+  int i, n = 0;
+  size_t size, pos;
+  unsigned char *start, *trailer;
+  struct exo_reader_t rd = bin->rd;
+  struct exo_term_t *exo, *elt, term;
+
+  *picnt = NULL;
+  *ppos = NULL;
+  size = rd.end - rd.buf;
+
+  /* the trailer points at the index term */
+  trailer = rd.end - EIO_TRAILER_SIZE;
+  if (size > EIO_TRAILER_SIZE
+      && trailer[0] == ec_blob && trailer[1] == 8)
+    {
+      for (i=7, pos=0; i >= 0; i--)
+	pos = (pos << 8) | trailer[2 + i];
+      if (pos < size - EIO_TRAILER_SIZE && rd.buf[pos] == ec_list)
+	{
+	  rd.p = rd.buf + pos;
+	  exo = exo_pull_tree(&rd, bin->arena);
+	  if (exo
+	      && exo->ec == ec_list
+	      && exo->as_list.head
+	      && exo->as_list.head->ec == ec_string
+	      && !strcmp((char *)exo->as_list.head->as_string.str,
+			 EIO_INDEX_TAG)
+	      && exo->as_list.head->next
+	      && exo->as_list.head->next->ec == ec_list)
+	    {
+	      for (elt=exo->as_list.head->next->as_list.head;
+		   elt != NULL; elt=elt->next)
+		{
+		  if (elt->ec != ec_list
+		      || !elt->as_list.head
+		      || elt->as_list.head->ec != ec_integer
+		      || !elt->as_list.head->next
+		      || elt->as_list.head->next->ec != ec_integer)
+		    fatal("could not read EIO checkpoint index");
+		  eio_index_add(elt->as_list.head->as_integer.val,
+				elt->as_list.head->next->as_integer.val,
+				picnt, ppos, &n);
+		}
+	      exo_arena_reset(bin->arena);
+	      return n;
+	    }
+	  exo_arena_reset(bin->arena);
+	}
+    }
+
+  /* no index, find the checkpoints by stepping over every term */
+  rd.p = rd.buf;
+  while (exo_peek(&rd) != ec_NUM)
+    {
+      start = rd.p;
+      if (exo_peek(&rd) == ec_list
+	  && exo_pull(&rd, &term)
+	  && exo_pull(&rd, &term)
+	  && term.ec == ec_string
+	  && !strcmp((char *)term.as_string.str, EIO_CHKPT_TAG)
+	  && exo_pull(&rd, &term)
+	  && term.ec == ec_integer)
+	eio_index_add(term.as_integer.val, start - rd.buf, picnt, ppos, &n);
+      rd.p = start;
+      exo_skip(&rd);
+    }
+  return n;
+}
+
+/* restore the last checkpoint embedded in EIO trace EIO_FD at or before
+   instruction ICNT, and leave the trace at the transaction after it;
+   returns the instruction count of the checkpoint, or -1 if there is
+   none and nothing was done */
+counter_t
+eio_seek(FILE *eio_fd,				/* EIO stream file desc */
+	 counter_t icnt,			/* instruction to seek to */
+	 struct regs_t *regs,			/* regs to restore */
+	 struct mem_t *mem)			/* memory to restore */
+{
+  int i, n;
+  counter_t *index_icnt, found = -1;
+  size_t *index_pos;
+  struct exo_term_t *exo;
+  struct eio_bin_t *bin = eio_bin(eio_fd);
+
+  if (!bin)
+    fatal("can only seek in binary EIO traces");
+
+  /* each checkpoint holds the pages written since the one before, so all
+     of them up to ICNT are applied in order */
+  n = eio_read_index(bin, &index_icnt, &index_pos);
+  for (i=0; i < n && index_icnt[i] <= icnt; i++)
+    {
+      if (index_pos[i] >= (size_t)(bin->rd.end - bin->rd.buf))
+	fatal("bad EIO checkpoint index");
+      bin->rd.p = bin->rd.buf + index_pos[i];
+      exo = exo_pull_tree(&bin->rd, bin->arena);
+      found = eio_apply_chkpt(exo, regs, mem);
+      exo_arena_reset(bin->arena);
+    }
+
+  if (index_icnt)
+    free(index_icnt);
+  if (index_pos)
+    free(index_pos);
+
+  /* the last transaction before the checkpoint was at its icnt */
+  if (found != -1)
+    eio_trans_icnt = found;
+
+  return found;
+}
+
+/* returns the instruction count of the last transaction in EIO file FNAME,
+   0 if it has none */
+counter_t
+eio_last_icnt(char *fname)			/* EIO file name */
+{
+  counter_t icnt = 0;
+  FILE *fd;
+  struct eio_bin_t *bin;
+  struct exo_term_t *exo, term, icnt_term;
+  unsigned char *start;
+
+  /* transactions are the only lists that start with an integer, an
+     address and a list: (icnt, pc, [inregs], ...) */
+  fd = eio_open(fname);
+  bin = eio_bin(fd);
+  if (bin)
+    {
+      /* step over every term, noting the ICNT of each transaction */
+      while (exo_peek(&bin->rd) != ec_NUM)
+	{
+	  start = bin->rd.p;
+	  if (exo_peek(&bin->rd) == ec_list
+	      && exo_pull(&bin->rd, &term)
+	      && exo_pull(&bin->rd, &icnt_term)
+	      && icnt_term.ec == ec_integer
+	      && exo_pull(&bin->rd, &term)
+	      && term.ec == ec_address
+	      && exo_peek(&bin->rd) == ec_list)
+	    icnt = icnt_term.as_integer.val;
+	  bin->rd.p = start;
+	  exo_skip(&bin->rd);
+	}
+    }
+  else
+    {
+      while ((exo = exo_read(fd)) != NULL)
+	{
+	  if (exo->ec == ec_list
+	      && exo->as_list.head
+	      && exo->as_list.head->ec == ec_integer
+	      && exo->as_list.head->next
+	      && exo->as_list.head->next->ec == ec_address
+	      && exo->as_list.head->next->next
+	      && exo->as_list.head->next->next->ec == ec_list)
+	    icnt = exo->as_list.head->as_integer.val;
+	  exo_delete(exo);
+	}
+    }
+
+  eio_close(fd);
+  return icnt;
+}
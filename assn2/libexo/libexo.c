@@ -51,6 +51,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
 #include <ctype.h>
 #include <limits.h>
@@ -1216,3 +1217,391 @@ exo_read(FILE *stream)
 
   return ent;
 }
+
+
+/*
+ * EXO binary encoding, see libexo.h for the format
+ */
+
+/* write varint VAL to STREAM, returns the number of bytes written */
+static size_t
+write_varint(exo_integer_t val, FILE *stream)
+{
+  size_t n = 1;
+
+  while (val >= 0x80)
+    {
+      putc((int)(val & 0x7f) | 0x80, stream);
+      val >>= 7;
+      n++;
+    }
+  putc((int)val, stream);
+  return n;
+}
+
+/* write EXO term EXO to STREAM in the binary encoding, returns the number
+   of bytes written */
+size_t
+exo_write(struct exo_term_t *exo, FILE *stream)
+{
+  int i;
+  size_t len, n = 1;
+
+  if (!stream)
+    stream = stdout;
+
+  putc(exo->ec, stream);
+  switch (exo->ec)
+    {
+    case ec_integer:
+      n += write_varint(exo->as_integer.val, stream);
+      break;
+
+    case ec_address:
+      n += write_varint((exo_integer_t)exo->as_address.val, stream);
+      break;
+
+    case ec_float:
+      fwrite(&exo->as_float.val, sizeof(exo_float_t), 1, stream);
+      n += sizeof(exo_float_t);
+      break;
+
+    case ec_char:
+      putc((unsigned char)exo->as_char.val, stream);
+      n++;
+      break;
+
+    case ec_string:
+      len = strlen((char *)exo->as_string.str);
+      n += write_varint((exo_integer_t)len, stream);
+      fwrite(exo->as_string.str, 1, len + 1, stream);
+      n += len + 1;
+      break;
+
+    case ec_token:
+      len = strlen(exo->as_token.ent->str);
+      n += write_varint((exo_integer_t)len, stream);
+      fwrite(exo->as_token.ent->str, 1, len + 1, stream);
+      n += len + 1;
+      break;
+
+    case ec_list:
+      {
+	struct exo_term_t *ent;
+
+	for (ent=exo->as_list.head; ent != NULL; ent=ent->next)
+	  n += exo_write(ent, stream);
+	putc(ec_null, stream);
+	n++;
+      }
+      break;
+
+    case ec_array:
+      n += write_varint((exo_integer_t)exo->as_array.size, stream);
+      for (i=0; i < exo->as_array.size; i++)
+	{
+	  if (exo->as_array.array[i] != NULL)
+	    n += exo_write(exo->as_array.array[i], stream);
+	  else
+	    {
+	      putc(ec_null, stream);
+	      n++;
+	    }
+	}
+      break;
+
+    case ec_blob:
+      n += write_varint((exo_integer_t)exo->as_blob.size, stream);
+      fwrite(exo->as_blob.data, 1, exo->as_blob.size, stream);
+      n += exo->as_blob.size;
+      break;
+
+    default:
+      panic("bogus EXO class");
+    }
+  return n;
+}
+
+/* arena chunk, allocations follow the header */
+struct exo_chunk_t {
+  struct exo_chunk_t *next;	/* next chunk in the arena */
+  size_t size;			/* bytes available in this chunk */
+  size_t used;			/* bytes allocated from this chunk */
+};
+
+/* default arena chunk size, in bytes */
+#define EXO_CHUNK_SIZE		(64*1024)
+
+/* round arena allocations up to this alignment */
+#define EXO_ARENA_ALIGN		sizeof(double)
+
+/* create an EXO node arena */
+struct exo_arena_t *
+exo_arena_create(void)
+{
+  struct exo_arena_t *arena;
+
+  arena = (struct exo_arena_t *)calloc(1, sizeof(struct exo_arena_t));
+  if (!arena)
+    fatal("out of virtual memory");
+  return arena;
+}
+
+/* release every term built in ARENA, its memory is kept for reuse */
+void
+exo_arena_reset(struct exo_arena_t *arena)
+{
+  arena->cur = arena->head;
+  if (arena->cur)
+    arena->cur->used = 0;
+}
+
+/* allocate NBYTES of zeroed memory from ARENA */
+static void *
+exo_arena_alloc(struct exo_arena_t *arena, size_t nbytes)
+{
+  struct exo_chunk_t *chunk;
+  unsigned char *p;
+  size_t hdr;
+
+  hdr = (sizeof(struct exo_chunk_t) + EXO_ARENA_ALIGN - 1)
+    & ~(EXO_ARENA_ALIGN - 1);
+  nbytes = (nbytes + EXO_ARENA_ALIGN - 1) & ~(EXO_ARENA_ALIGN - 1);
+
+  /* move on to the next chunk that can hold it, reusing old chunks */
+  while (!arena->cur || arena->cur->used + nbytes > arena->cur->size)
+    {
+      if (arena->cur && arena->cur->next)
+	{
+	  arena->cur = arena->cur->next;
+	  arena->cur->used = 0;
+	  continue;
+	}
+
+      chunk = (struct exo_chunk_t *)malloc(hdr + MAX(nbytes, EXO_CHUNK_SIZE));
+      if (!chunk)
+	fatal("out of virtual memory");
+      chunk->size = MAX(nbytes, EXO_CHUNK_SIZE);
+      chunk->used = 0;
+
+      /* add it after the current chunk */
+      if (arena->cur)
+	{
+	  chunk->next = arena->cur->next;
+	  arena->cur->next = chunk;
+	}
+      else
+	{
+	  chunk->next = arena->head;
+	  arena->head = chunk;
+	}
+      arena->cur = chunk;
+    }
+
+  p = (unsigned char *)arena->cur + hdr + arena->cur->used;
+  arena->cur->used += nbytes;
+  memset(p, 0, nbytes);
+  return p;
+}
+
+/* start reader RD on the SIZE bytes of encoded terms at BUF */
+void
+exo_reader_init(struct exo_reader_t *rd, unsigned char *buf, size_t size)
+{
+  rd->buf = rd->p = buf;
+  rd->end = buf + size;
+}
+
+/* read a varint from RD */
+static exo_integer_t
+read_varint(struct exo_reader_t *rd)
+{
+  exo_integer_t val = 0;
+  int shift = 0, c;
+
+  do {
+    if (rd->p >= rd->end)
+      fatal("truncated binary EXO data");
+    c = *rd->p++;
+    val |= (exo_integer_t)(c & 0x7f) << shift;
+    shift += 7;
+  } while (c & 0x80);
+
+  return val;
+}
+
+/* return a pointer to the next NBYTES of RD, and skip over them */
+static unsigned char *
+read_bytes(struct exo_reader_t *rd, size_t nbytes)
+{
+  unsigned char *p = rd->p;
+
+  if ((size_t)(rd->end - rd->p) < nbytes)
+    fatal("truncated binary EXO data");
+  rd->p += nbytes;
+  return p;
+}
+
+/* return the class of the next term of RD, ec_null at the end of a list,
+   or ec_NUM at the end of the buffer */
+enum exo_class_t
+exo_peek(struct exo_reader_t *rd)
+{
+  if (rd->p >= rd->end)
+    return ec_NUM;
+  if (*rd->p > ec_null)
+    fatal("bad binary EXO class %d", *rd->p);
+  return (enum exo_class_t)*rd->p;
+}
+
+/* pull the next node of RD into TERM, returns FALSE at the end of the
+   buffer; scalars, strings and blobs are decoded in full, a list or array
+   yields only its header (arrays with their size, and a NULL array) and
+   its elements are pulled next, the end of a list pulls as ec_null */
+int
+exo_pull(struct exo_reader_t *rd, struct exo_term_t *term)
+{
+  size_t len;
+
+  term->next = NULL;
+  term->ec = exo_peek(rd);
+  if (term->ec == ec_NUM)
+    return FALSE;
+  rd->p++;
+
+  switch (term->ec)
+    {
+    case ec_integer:
+      term->as_integer.val = read_varint(rd);
+      break;
+
+    case ec_address:
+      term->as_address.val = (exo_address_t)read_varint(rd);
+      break;
+
+    case ec_float:
+      memcpy(&term->as_float.val,
+	     read_bytes(rd, sizeof(exo_float_t)), sizeof(exo_float_t));
+      break;
+
+    case ec_char:
+      term->as_char.val = *read_bytes(rd, 1);
+      break;
+
+    case ec_string:
+      len = (size_t)read_varint(rd);
+      term->as_string.str = read_bytes(rd, len + 1);
+      if (term->as_string.str[len] != '\0')
+	fatal("bad binary EXO string");
+      break;
+
+    case ec_token:
+      {
+	unsigned char *s;
+
+	len = (size_t)read_varint(rd);
+	s = read_bytes(rd, len + 1);
+	if (s[len] != '\0')
+	  fatal("bad binary EXO token");
+	term->as_token.ent = exo_intern((char *)s);
+      }
+      break;
+
+    case ec_list:
+      term->as_list.head = NULL;
+      break;
+
+    case ec_array:
+      term->as_array.size = (int)read_varint(rd);
+      term->as_array.array = NULL;
+      break;
+
+    case ec_blob:
+      term->as_blob.size = (int)read_varint(rd);
+      term->as_blob.data = read_bytes(rd, term->as_blob.size);
+      break;
+
+    case ec_null:
+      break;
+
+    default:
+      panic("bogus EXO class");
+    }
+
+  return TRUE;
+}
+
+/* skip over the next term of RD, lists and arrays included */
+void
+exo_skip(struct exo_reader_t *rd)
+{
+  int i;
+  struct exo_term_t term;
+
+  if (!exo_pull(rd, &term))
+    fatal("truncated binary EXO data");
+
+  if (term.ec == ec_list)
+    {
+      while (exo_peek(rd) != ec_null)
+	exo_skip(rd);
+      rd->p++;
+    }
+  else if (term.ec == ec_array)
+    {
+      for (i=0; i < term.as_array.size; i++)
+	exo_skip(rd);
+    }
+}
+
+/* pull the next whole term of RD, with its nodes taken from ARENA, returns
+   NULL at the end of the buffer */
+struct exo_term_t *
+exo_pull_tree(struct exo_reader_t *rd, struct exo_arena_t *arena)
+{
+  int i;
+  struct exo_term_t *exo, *elt, *tail;
+
+  if (exo_peek(rd) == ec_NUM)
+    return NULL;
+
+  exo = (struct exo_term_t *)exo_arena_alloc(arena, sizeof(struct exo_term_t));
+  exo_pull(rd, exo);
+
+  switch (exo->ec)
+    {
+    case ec_list:
+      for (tail=NULL; exo_peek(rd) != ec_null; tail=elt)
+	{
+	  elt = exo_pull_tree(rd, arena);
+	  if (!elt)
+	    fatal("truncated binary EXO data");
+	  if (tail)
+	    tail->next = elt;
+	  else
+	    exo->as_list.head = elt;
+	}
+      rd->p++;
+      break;
+
+    case ec_array:
+      exo->as_array.array = (struct exo_term_t **)
+	exo_arena_alloc(arena, exo->as_array.size * sizeof(struct exo_term_t *));
+      for (i=0; i < exo->as_array.size; i++)
+	{
+	  if (exo_peek(rd) == ec_null)
+	    rd->p++;
+	  else if (!(exo->as_array.array[i] = exo_pull_tree(rd, arena)))
+	    fatal("truncated binary EXO data");
+	}
+      break;
+
+    case ec_null:
+      fatal("unexpected end of binary EXO list");
+
+    default:
+      break;
+    }
+
+  return exo;
+}
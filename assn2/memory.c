@@ -51,6 +51,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "host.h"
 #include "misc.h"
@@ -58,8 +59,45 @@
 #include "options.h"
 #include "stats.h"
 #include "memory.h"
+#include "hostprof.h"
 
 
+/* pages released by mem_restore() and mem_snap_free(), for reuse */
+static byte_t *mem_free_pages = NULL;
+
+/* get a host page, its contents are undefined */
+static byte_t *
+mem_getpage(void)
+{
+  byte_t *page;
+
+  if (mem_free_pages)
+    {
+      /* reuse a released page, the list is threaded through the pages */
+      page = mem_free_pages;
+      mem_free_pages = *(byte_t **)page;
+      return page;
+    }
+
+  /* see misc.c for details on the getcore() function */
+  page = getcore(MD_PAGE_SIZE);
+  if (!page)
+    fatal("out of virtual memory");
+  return page;
+}
+
+/* drop a reference to shared page SHARED, releasing it with the last one */
+static void
+mem_unshare(struct mem_shared_t *shared)
+{
+  if (--shared->refs == 0)
+    {
+      *(byte_t **)shared->page = mem_free_pages;
+      mem_free_pages = shared->page;
+      free(shared);
+    }
+}
+
 /* create a flat memory space */
 struct mem_t *
 mem_create(char *name)			/* name of the memory space */
@@ -80,6 +118,11 @@ mem_translate(struct mem_t *mem,	/* memory space to access */
 	      md_addr_t addr)		/* virtual address to translate */
 {
   struct mem_pte_t *pte, *prev;
+#ifdef HOST_PROFILE
+  enum hostprof_comp_t hp_prev;
+#endif
+
+  HOSTPROF_ENTER(hp_xlate, hp_prev);
 
   /* got here via a first level miss in the page tables */
   mem->ptab_misses++; mem->ptab_accesses++;
@@ -98,12 +141,14 @@ mem_translate(struct mem_t *mem,	/* memory space to access */
 	      pte->next = mem->ptab[MEM_PTAB_SET(addr)];
 	      mem->ptab[MEM_PTAB_SET(addr)] = pte;
 	    }
-	  return pte->page;
+	  break;
 	}
     }
 
-  /* no translation found, return NULL */
-  return NULL;
+  HOSTPROF_LEAVE(hp_prev);
+
+  /* the host page, or NULL if no translation was found */
+  return pte != NULL ? pte->page : NULL;
 }
 
 /* allocate a memory page */
@@ -114,10 +159,9 @@ mem_newpage(struct mem_t *mem,		/* memory space to allocate in */
   byte_t *page;
   struct mem_pte_t *pte;
 
-  /* see misc.c for details on the getcore() function */
-  page = getcore(MD_PAGE_SIZE);
-  if (!page)
-    fatal("out of virtual memory");
+  /* new pages read as zeros */
+  page = mem_getpage();
+  memset(page, 0, MD_PAGE_SIZE);
 
   /* generate a new PTE */
   pte = calloc(1, sizeof(struct mem_pte_t));
@@ -134,6 +178,190 @@ mem_newpage(struct mem_t *mem,		/* memory space to allocate in */
   mem->page_count++;
 }
 
+/* give page at address ADDR its own copy if it is shared with a snapshot,
+   call only after a MEM_PAGE() hit on ADDR */
+void
+mem_cowpage(struct mem_t *mem,		/* memory space to access */
+	    md_addr_t addr)		/* virtual address to write */
+{
+  /* MEM_PAGE() left the PTE at the head of its bucket */
+  struct mem_pte_t *pte = mem->ptab[MEM_PTAB_SET(addr)];
+  struct mem_shared_t *shared = pte->shared;
+
+  if (!shared)
+    return;
+
+  if (shared->refs == 1)
+    {
+      /* the snapshots are gone, the page is ours again */
+      free(shared);
+    }
+  else
+    {
+      pte->page = mem_getpage();
+      memcpy(pte->page, shared->page, MD_PAGE_SIZE);
+      mem_unshare(shared);
+      mem->cow_copies++;
+    }
+  pte->shared = NULL;
+}
+
+/* back the NBYTES of simulated memory at ADDR with host memory HOST, which
+   must stay valid and unchanged while the memory space exists; pages HOST
+   covers entirely are shared, and copied on their first write, the rest are
+   copied in now */
+void
+mem_map(struct mem_t *mem,		/* memory space to map into */
+	md_addr_t addr,			/* target address to map */
+	byte_t *host,			/* host memory to map */
+	int nbytes)			/* number of bytes to map */
+{
+  int count;
+  struct mem_pte_t *pte;
+
+  while (nbytes > 0)
+    {
+      count = MIN(nbytes, MD_PAGE_SIZE - MEM_OFFSET(addr));
+
+      if (count < MD_PAGE_SIZE
+	  || MEM_PAGE(mem, addr)
+	  || ((unsigned long)host & (sizeof(dfloat_t) - 1)) != 0)
+	{
+	  /* partial, already allocated or misaligned, copy it */
+	  mem_bulk_access(mem, Write, addr, host, count);
+	}
+      else
+	{
+	  pte = calloc(1, sizeof(struct mem_pte_t));
+	  if (!pte)
+	    fatal("out of virtual memory");
+	  pte->tag = MEM_PTAB_TAG(addr);
+	  pte->page = host;
+
+	  /* one reference for the page table and one for the mapping, which
+	     is never dropped, so the host page is never written or freed */
+	  pte->shared = calloc(1, sizeof(struct mem_shared_t));
+	  if (!pte->shared)
+	    fatal("out of virtual memory");
+	  pte->shared->page = host;
+	  pte->shared->refs = 2;
+
+	  pte->next = mem->ptab[MEM_PTAB_SET(addr)];
+	  mem->ptab[MEM_PTAB_SET(addr)] = pte;
+
+	  mem->page_count++;
+	  mem->mapped_pages++;
+	}
+
+      addr += count;
+      host += count;
+      nbytes -= count;
+    }
+}
+
+/* take a snapshot of memory space MEM; no pages are copied, each page is
+   shared until the next write to it */
+struct mem_snap_t *
+mem_snapshot(struct mem_t *mem)		/* memory space to snapshot */
+{
+  int i, n;
+  struct mem_pte_t *pte;
+  struct mem_snap_t *snap;
+
+  snap = calloc(1, sizeof(struct mem_snap_t));
+  if (!snap)
+    fatal("out of virtual memory");
+  snap->addrs = calloc(mem->page_count + 1, sizeof(md_addr_t));
+  snap->pages = calloc(mem->page_count + 1, sizeof(struct mem_shared_t *));
+  if (!snap->addrs || !snap->pages)
+    fatal("out of virtual memory");
+
+  for (n=0, i=0; i < MEM_PTAB_SIZE; i++)
+    {
+      for (pte=mem->ptab[i]; pte != NULL; pte=pte->next)
+	{
+	  if (!pte->shared)
+	    {
+	      /* share the page, the next write to it will copy it */
+	      pte->shared = calloc(1, sizeof(struct mem_shared_t));
+	      if (!pte->shared)
+		fatal("out of virtual memory");
+	      pte->shared->page = pte->page;
+	      pte->shared->refs = 1;
+	    }
+	  pte->shared->refs++;
+
+	  snap->addrs[n] = MEM_PTE_ADDR(pte, i);
+	  snap->pages[n] = pte->shared;
+	  n++;
+	}
+    }
+  snap->npages = n;
+
+  mem->snapshots++;
+  return snap;
+}
+
+/* rewind memory space MEM to snapshot SNAP, which stays valid and can be
+   restored again; pages written since the snapshot are released */
+void
+mem_restore(struct mem_t *mem,		/* memory space to rewind */
+	    struct mem_snap_t *snap)	/* snapshot to restore */
+{
+  int i;
+  struct mem_pte_t *pte, *next;
+
+  /* drop the current pages */
+  for (i=0; i < MEM_PTAB_SIZE; i++)
+    {
+      for (pte=mem->ptab[i]; pte != NULL; pte=next)
+	{
+	  next = pte->next;
+	  if (pte->shared)
+	    mem_unshare(pte->shared);
+	  else
+	    {
+	      *(byte_t **)pte->page = mem_free_pages;
+	      mem_free_pages = pte->page;
+	    }
+	  free(pte);
+	}
+      mem->ptab[i] = NULL;
+    }
+
+  /* map the snapshot pages, shared until they are next written */
+  for (i=0; i < snap->npages; i++)
+    {
+      pte = calloc(1, sizeof(struct mem_pte_t));
+      if (!pte)
+	fatal("out of virtual memory");
+      pte->tag = MEM_PTAB_TAG(snap->addrs[i]);
+      pte->page = snap->pages[i]->page;
+      pte->shared = snap->pages[i];
+      pte->shared->refs++;
+
+      pte->next = mem->ptab[MEM_PTAB_SET(snap->addrs[i])];
+      mem->ptab[MEM_PTAB_SET(snap->addrs[i])] = pte;
+    }
+  mem->page_count = snap->npages;
+
+  mem->restores++;
+}
+
+/* release snapshot SNAP */
+void
+mem_snap_free(struct mem_snap_t *snap)	/* snapshot to release */
+{
+  int i;
+
+  for (i=0; i < snap->npages; i++)
+    mem_unshare(snap->pages[i]);
+
+  free(snap->addrs);
+  free(snap->pages);
+  free(snap);
+}
+
 /* generic memory access function, it's safe because alignments and permissions
    are checked, handles any natural transfer sizes; note, faults out if nbytes
    is not a power-of-two or larger then MD_PAGE_SIZE */
@@ -245,6 +473,22 @@ mem_reg_stats(struct mem_t *mem,	/* memory space to declare */
   sprintf(buf, "%s.ptab_miss_rate", mem->name);
   sprintf(buf1, "%s.ptab_misses / %s.ptab_accesses", mem->name, mem->name);
   stat_reg_formula(sdb, buf, "first level page table miss rate", buf1, NULL);
+
+  sprintf(buf, "%s.mapped_pages", mem->name);
+  stat_reg_counter(sdb, buf, "total pages mapped from the host",
+		   &mem->mapped_pages, mem->mapped_pages, NULL);
+
+  sprintf(buf, "%s.snapshots", mem->name);
+  stat_reg_counter(sdb, buf, "total memory snapshots taken",
+		   &mem->snapshots, mem->snapshots, NULL);
+
+  sprintf(buf, "%s.restores", mem->name);
+  stat_reg_counter(sdb, buf, "total memory snapshots restored",
+		   &mem->restores, mem->restores, NULL);
+
+  sprintf(buf, "%s.cow_copies", mem->name);
+  stat_reg_counter(sdb, buf, "total shared pages copied on write",
+		   &mem->cow_copies, mem->cow_copies, NULL);
 }
 
 /* initialize memory system, call before loader.c */
@@ -260,6 +504,10 @@ mem_init(struct mem_t *mem)	/* memory space to initialize */
   mem->page_count = 0;
   mem->ptab_misses = 0;
   mem->ptab_accesses = 0;
+  mem->snapshots = 0;
+  mem->restores = 0;
+  mem->cow_copies = 0;
+  mem->mapped_pages = 0;
 }
 
 /* dump a block of memory, returns any faults encountered */
@@ -291,6 +539,120 @@ mem_dump(struct mem_t *mem,		/* memory space to display */
   return md_fault_none;
 }
 
+/* copy NBYTES to/from simulated memory space a page at a time, returns any
+   faults encountered; unlike mem_access(), transfers may be any length and
+   alignment, reads of unallocated pages return zeros */
+enum md_fault_type
+mem_bulk_access(struct mem_t *mem,	/* memory space to access */
+		enum mem_cmd cmd,	/* Read (from sim mem) or Write */
+		md_addr_t addr,		/* target address to access */
+		void *vp,		/* host memory address to access */
+		int nbytes)		/* number of bytes to access */
+{
+  byte_t *p = vp, *page;
+  int count;
+
+  while (nbytes > 0)
+    {
+      /* transfer up to the end of this page */
+      count = MIN(nbytes, MD_PAGE_SIZE - MEM_OFFSET(addr));
+
+      switch (cmd)
+	{
+	case Read:
+	  page = MEM_PAGE(mem, addr);
+	  if (page)
+	    memcpy(p, page + MEM_OFFSET(addr), count);
+	  else
+	    memset(p, 0, count);
+	  break;
+
+	case Write:
+	  MEM_TICKLE(mem, addr);
+	  memcpy(MEM_PAGE(mem, addr) + MEM_OFFSET(addr), p, count);
+	  break;
+
+	default:
+	  return md_fault_internal;
+	}
+
+      addr += count;
+      p += count;
+      nbytes -= count;
+    }
+
+  /* no faults... */
+  return md_fault_none;
+}
+
+/* set NBYTES of simulated memory to C a page at a time, returns any faults
+   encountered; zeroing skips unallocated pages, they already read as zeros */
+enum md_fault_type
+mem_bulk_set(struct mem_t *mem,		/* memory space to access */
+	     md_addr_t addr,		/* target address to access */
+	     int c,			/* value to store in each byte */
+	     int nbytes)		/* number of bytes to set */
+{
+  int count;
+
+  while (nbytes > 0)
+    {
+      count = MIN(nbytes, MD_PAGE_SIZE - MEM_OFFSET(addr));
+
+      if (c != 0 || MEM_PAGE(mem, addr))
+	{
+	  MEM_TICKLE(mem, addr);
+	  memset(MEM_PAGE(mem, addr) + MEM_OFFSET(addr), c, count);
+	}
+
+      addr += count;
+      nbytes -= count;
+    }
+
+  /* no faults... */
+  return md_fault_none;
+}
+
+/* copy a '\0' terminated string from simulated memory space a page at a
+   time, returns any faults encountered */
+static enum md_fault_type
+mem_bulk_strread(struct mem_t *mem,	/* memory space to access */
+		 md_addr_t addr,	/* target address to access */
+		 char *s)		/* host memory string buffer */
+{
+  byte_t *page, *src, *end;
+  int count;
+
+  for (;;)
+    {
+      count = MD_PAGE_SIZE - MEM_OFFSET(addr);
+
+      page = MEM_PAGE(mem, addr);
+      if (!page)
+	{
+	  /* page not yet allocated, reads as the terminator */
+	  *s = '\0';
+	  break;
+	}
+      src = page + MEM_OFFSET(addr);
+
+      /* copy through the terminator, if it is on this page */
+      end = memchr(src, '\0', count);
+      if (end)
+	{
+	  memcpy(s, src, end - src + 1);
+	  break;
+	}
+      memcpy(s, src, count);
+
+      addr += count;
+      s += count;
+    }
+
+  /* no faults... */
+  return md_fault_none;
+}
+
 /* copy a '\0' terminated string to/from simulated memory space, returns
    the number of bytes copied, returns any fault encountered */
 enum md_fault_type
@@ -304,6 +666,15 @@ mem_strcpy(mem_access_fn mem_fn,	/* user-specified memory accessor */
   char c;
   enum md_fault_type fault;
 
+  /* the plain accessor does not need to see each byte, go by pages */
+  if (mem_fn == mem_access)
+    {
+      if (cmd == Read)
+	return mem_bulk_strread(mem, addr, s);
+      else if (cmd == Write)
+	return mem_bulk_access(mem, Write, addr, s, strlen(s) + 1);
+    }
+
   switch (cmd)
     {
     case Read:
@@ -348,6 +719,10 @@ mem_bcopy(mem_access_fn mem_fn,		/* user-specified memory accessor */
   byte_t *p = vp;
   enum md_fault_type fault;
 
+  /* the plain accessor does not need to see each byte, go by pages */
+  if (mem_fn == mem_access)
+    return mem_bulk_access(mem, cmd, addr, vp, nbytes);
+
   /* copy NBYTES bytes to/from simulator memory */
   while (nbytes-- > 0)
     {
@@ -375,6 +750,15 @@ mem_bcopy4(mem_access_fn mem_fn,	/* user-specified memory accessor */
   int words = nbytes >> 2;		/* note: nbytes % 2 == 0 is assumed */
   enum md_fault_type fault;
 
+  /* the plain accessor does not need to see each word, go by pages, but
+     it still faults on misaligned words, like mem_access() would */
+  if (mem_fn == mem_access)
+    {
+      if ((addr & (sizeof(word_t)-1)) != 0)
+	return md_fault_alignment;
+      return mem_bulk_access(mem, cmd, addr, vp, words << 2);
+    }
+
   while (words-- > 0)
     {
       fault = mem_fn(mem, cmd, addr, p, sizeof(word_t));
@@ -399,6 +783,10 @@ mem_bzero(mem_access_fn mem_fn,		/* user-specified memory accessor */
   byte_t c = 0;
   enum md_fault_type fault;
 
+  /* the plain accessor does not need to see each byte, go by pages */
+  if (mem_fn == mem_access)
+    return mem_bulk_set(mem, addr, 0, nbytes);
+
   /* zero out NBYTES of simulator memory */
   while (nbytes-- > 0)
     {
@@ -0,0 +1,189 @@
+/* ptrace.c - pipeline tracing routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "range.h"
+#include "ptrace.h"
+
+/* pipetrace output file, NULL if not tracing */
+FILE *ptrace_outfd = NULL;
+
+/* pipetrace instruction range */
+struct range_range_t ptrace_range;
+
+/* current cycle, and cycle of the last record written */
+static counter_t ptrace_cycle = 0;
+static counter_t ptrace_last_cycle = 0;
+
+/* instructions retired in the trace */
+static counter_t ptrace_num_retired = 0;
+
+/* open pipetrace file FNAME, tracing instructions in range RANGE (NULL for
+   all instructions) */
+void
+ptrace_open(char *fname,			/* output filename */
+	    char *range)			/* trace range */
+{
+  char *errstr;
+
+  /* parse the output range */
+  if (!range)
+    range = ":";
+  errstr = range_parse_range(range, &ptrace_range);
+  if (errstr)
+    fatal("cannot parse pipetrace range, use: {<start>}:{<end>}");
+
+  /* open output trace file */
+  if (!fname || !strcmp(fname, "-") || !strcmp(fname, "stderr"))
+    ptrace_outfd = stderr;
+  else if (!strcmp(fname, "stdout"))
+    ptrace_outfd = stdout;
+  else
+    {
+      ptrace_outfd = fopen(fname, "w");
+      if (!ptrace_outfd)
+	fatal("cannot open pipetrace output file `%s'", fname);
+    }
+
+  fprintf(ptrace_outfd, "Kanata\t0004\n");
+  fprintf(ptrace_outfd, "C=\t0\n");
+}
+
+/* close pipetrace file */
+void
+ptrace_close(void)
+{
+  if (ptrace_outfd != NULL && ptrace_outfd != stderr && ptrace_outfd != stdout)
+    fclose(ptrace_outfd);
+  ptrace_outfd = NULL;
+}
+
+/* advance the trace to cycle CYCLE */
+void
+ptrace_newcycle(counter_t cycle)		/* current cycle */
+{
+  /* records are stamped lazily, so idle cycles cost no trace volume */
+  ptrace_cycle = cycle;
+}
+
+/* stamp the next record with the current cycle */
+static void
+ptrace_sync(void)
+{
+  if (ptrace_cycle != ptrace_last_cycle)
+    {
+      myfprintf(ptrace_outfd, "C\t%n\n", ptrace_cycle - ptrace_last_cycle);
+      ptrace_last_cycle = ptrace_cycle;
+    }
+}
+
+/* start tracing instruction ISEQ, fetched from PC */
+void
+ptrace_newinst(unsigned int iseq,		/* instruction sequence number */
+	       md_inst_t inst,			/* new instruction */
+	       md_addr_t pc)			/* program counter of inst */
+{
+  if (!ptrace_outfd)
+    return;
+
+  ptrace_sync();
+  fprintf(ptrace_outfd, "I\t%u\t%u\t0\n", iseq, iseq);
+  myfprintf(ptrace_outfd, "L\t%u\t0\t0x%08p: ", iseq, pc);
+  md_print_insn(inst, pc, ptrace_outfd);
+  fprintf(ptrace_outfd, "\n");
+  fprintf(ptrace_outfd, "S\t%u\t0\t%s\n", iseq, PST_IFETCH);
+}
+
+/* instruction ISEQ enters pipeline stage PSTAGE */
+void
+ptrace_newstage(unsigned int iseq,		/* instruction sequence number */
+		char *pstage)			/* pipeline stage entered */
+{
+  if (!ptrace_outfd)
+    return;
+
+  /* entering a stage ends the previous one */
+  ptrace_sync();
+  fprintf(ptrace_outfd, "S\t%u\t0\t%s\n", iseq, pstage);
+}
+
+/* attach label LABEL to instruction ISEQ */
+void
+ptrace_label(unsigned int iseq,			/* instruction sequence number */
+	     char *label)			/* hover label text */
+{
+  if (!ptrace_outfd)
+    return;
+
+  ptrace_sync();
+  fprintf(ptrace_outfd, "L\t%u\t1\t%s; \n", iseq, label);
+}
+
+/* instruction ISEQ leaves the pipeline, retired or squashed if FLUSH */
+void
+ptrace_endinst(unsigned int iseq,		/* instruction sequence number */
+	       int flush)			/* squashed instruction? */
+{
+  if (!ptrace_outfd)
+    return;
+
+  ptrace_sync();
+  if (flush)
+    fprintf(ptrace_outfd, "R\t%u\t0\t1\n", iseq);
+  else
+    myfprintf(ptrace_outfd, "R\t%u\t%n\t0\n", iseq, ptrace_num_retired++);
+}
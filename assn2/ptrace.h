@@ -0,0 +1,129 @@
+/* ptrace.h - pipeline tracing definitions and interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef PTRACE_H
+#define PTRACE_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "range.h"
+
+/*
+ * The pipeline tracer writes the stages each instruction passes through,
+ * cycle by cycle, in the Kanata text format read by the Konata pipeline
+ * viewer.  Every instruction is labelled with its PC and disassembly; stall
+ * reasons and stall cycle totals are attached as hover labels, and
+ * squashed instructions are marked as flushed.
+ *
+ * Only instructions fetched inside the trace range are traced, so that the
+ * volume of a trace stays bounded; an instruction traced at fetch is traced
+ * to its end even if the range has been left by then.  The range has the
+ * usual {<start>}:{<end>} syntax, positions are instruction counts, cycle
+ * counts (#<cycle>) or PCs (@<addr>).
+ */
+
+/* pipeline stage names */
+#define PST_IFETCH		"F"
+#define PST_DECODE		"D"
+#define PST_EXECUTE		"X"
+#define PST_MEMORY		"M"
+#define PST_WRITEBACK		"W"
+
+/* pipetrace output file, NULL if not tracing */
+extern FILE *ptrace_outfd;
+
+/* pipetrace instruction range */
+extern struct range_range_t ptrace_range;
+
+/* open pipetrace file FNAME, tracing instructions in range RANGE (NULL for
+   all instructions) */
+void
+ptrace_open(char *fname,			/* output filename */
+	    char *range);			/* trace range */
+
+/* close pipetrace file */
+void
+ptrace_close(void);
+
+/* returns non-zero if an instruction fetched now should be traced */
+#define ptrace_check_active(PC, ICNT, CYCLE)				\
+  (ptrace_outfd != NULL							\
+   && !range_cmp_range1(&ptrace_range, (PC), (ICNT), (CYCLE)))
+
+/* advance the trace to cycle CYCLE */
+void
+ptrace_newcycle(counter_t cycle);		/* current cycle */
+
+/* start tracing instruction ISEQ, fetched from PC */
+void
+ptrace_newinst(unsigned int iseq,		/* instruction sequence number */
+	       md_inst_t inst,			/* new instruction */
+	       md_addr_t pc);			/* program counter of inst */
+
+/* instruction ISEQ enters pipeline stage PSTAGE */
+void
+ptrace_newstage(unsigned int iseq,		/* instruction sequence number */
+		char *pstage);			/* pipeline stage entered */
+
+/* attach label LABEL to instruction ISEQ */
+void
+ptrace_label(unsigned int iseq,			/* instruction sequence number */
+	     char *label);			/* hover label text */
+
+/* instruction ISEQ leaves the pipeline, retired or squashed if FLUSH */
+void
+ptrace_endinst(unsigned int iseq,		/* instruction sequence number */
+	       int flush);			/* squashed instruction? */
+
+#endif /* PTRACE_H */
@@ -56,6 +56,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 #include <stdbool.h>
@@ -69,6 +70,13 @@
 #include "syscall.h"
 #include "options.h"
 #include "stats.h"
+#include "resource.h"
+#include "ptrace.h"
+#include "bpred.h"
+#include "cache.h"
+#include "symbol.h"
+#include "eio.h"
+#include "hostprof.h"
 #include "sim.h"
 
 /*
@@ -90,9 +98,304 @@ static counter_t sim_num_refs = 0;
 /* maximum number of inst's to execute */
 static unsigned int max_insts;
 
+/* maximum pipeline depth, in stages */
+#define MAX_PIPE_STAGES		16
+
+/* pipeline stage kinds */
+enum stage_kind {
+  STAGE_IF = 0,			/* instruction fetch */
+  STAGE_ID,			/* decode and register read */
+  STAGE_EX,			/* execute */
+  STAGE_MEM,			/* memory access */
+  STAGE_WB,			/* writeback */
+  NUM_STAGE_KINDS
+};
+
+/* forwarding networks */
+enum forwarding {
+  FWD_NONE = 0,			/* results are read from the register file */
+  FWD_MEM,			/* results are forwarded from the end of MEM */
+  FWD_FULL			/* ALU results are also forwarded from EX */
+};
+
+/* number of fetch, decode, execute and memory access stages */
+static int pipe_fetch_stages;
+static int pipe_decode_stages;
+static int pipe_exec_stages;
+static int pipe_mem_stages;
+
+/* stage that resolves branches, i.e., id, ex or mem */
+static char *pipe_resolve;
+static enum stage_kind pipe_resolve_kind;
+
+/* forwarding network, i.e., full, mem or none */
+static char *pipe_forward;
+static enum forwarding pipe_fwd;
+
+/* branch predictor type {nottaken|taken|bimod|2lev} */
+static char *pred_type;
+
+/* bimodal predictor config (<table_size>) */
+static int bimod_nelt = 1;
+static int bimod_config[1] =
+  { /* bimod tbl size */2048 };
+
+/* 2-level predictor config (<l1size> <l2size> <hist_size> <xor>) */
+static int twolev_nelt = 4;
+static int twolev_config[4] =
+  { /* l1size */1, /* l2size */1024, /* hist */8, /* xor */FALSE};
+
+/* BTB predictor config (<num_sets> <associativity>) */
+static int btb_nelt = 2;
+static int btb_config[2] =
+  { /* nsets */512, /* assoc */4 };
+
+/* return address stack (RAS) size */
+static int ras_size = 8;
+
+/* branch predictor consulted by fetch */
+static struct bpred_t *pred;
+
+/* l1 instruction cache config, i.e., {<config>|none} */
+static char *cache_il1_opt;
+
+/* l1 instruction cache hit latency (in cycles) */
+static int cache_il1_lat;
+
+/* l1 data cache config, i.e., {<config>|none} */
+static char *cache_dl1_opt;
+
+/* l1 data cache hit latency (in cycles) */
+static int cache_dl1_lat;
+
+/* l1 data cache MSHRs, 0 for a blocking cache */
+static int cache_dl1_mshrs;
+
+/* unified l2 cache config, i.e., {<config>|none} */
+static char *cache_dl2_opt;
+
+/* l2 cache hit latency (in cycles) */
+static int cache_dl2_lat;
+
+/* memory access latency (<first_chunk> <inter_chunk>) */
+static int mem_nelt = 2;
+static int mem_lat[2] =
+  { /* lat to first chunk */18, /* lat between remaining chunks */2 };
+
+/* memory access bus width (in bytes) */
+static int mem_bus_width;
+
+/* write buffer entries, 0 for stores to write the l1 data cache in MEM */
+static int wbuf_size;
+
+/* write buffer entry, a store on its way into the l1 data cache */
+struct wbuf_ent {
+  md_addr_t addr;			/* address stored to */
+  tick_t done;				/* cycle the cache write completes */
+};
+
+/* write buffer, a ring of WBUF_SIZE entries in store order */
+static struct wbuf_ent *wbuf = NULL;
+static int wbuf_tail = 0;
+
+/* level 1 instruction cache, entry level instruction cache */
+static struct cache_t *cache_il1 = NULL;
+
+/* level 1 data cache, entry level data cache */
+static struct cache_t *cache_dl1 = NULL;
+
+/* level 2 cache, shared by instructions and data */
+static struct cache_t *cache_dl2 = NULL;
+
+/* memory access latency, assumed to not cross a page boundary */
+static unsigned int			/* total latency of access */
+mem_access_latency(int blk_sz)		/* block size accessed */
+{
+  int chunks = (blk_sz + (mem_bus_width - 1)) / mem_bus_width;
+
+  assert(chunks > 0);
+
+  return (/* first chunk latency */mem_lat[0] +
+	  (/* remainder chunk latency */mem_lat[1] * (chunks - 1)));
+}
+
+/* l1 cache block miss handler function, shared by both l1 caches */
+static unsigned int			/* latency of block access */
+l1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
+	     md_addr_t baddr,		/* block address to access */
+	     int bsize,			/* size of block to access */
+	     tick_t now)		/* time of access */
+{
+  if (cache_dl2)
+    {
+      /* access next level of data cache hierarchy, the l2 cache tracks any
+	 number of misses so it always accepts the access */
+      return cache_access(cache_dl2, cmd, baddr, now);
+    }
+  else
+    {
+      /* access main memory */
+      return mem_access_latency(bsize);
+    }
+}
+
+/* l2 cache block miss handler function */
+static unsigned int			/* latency of block access */
+l2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
+	     md_addr_t baddr,		/* block address to access */
+	     int bsize,			/* size of block to access */
+	     tick_t now)		/* time of access */
+{
+  /* access main memory */
+  return mem_access_latency(bsize);
+}
+
+/* create cache NAME from option string OPT, {<config>|none} */
+static struct cache_t *
+cache_from_opt(char *opt,		/* cache option string */
+	       unsigned int (*blk_access_fn)(enum mem_cmd cmd,
+					     md_addr_t baddr, int bsize,
+					     tick_t now),
+	       int lat,			/* hit latency */
+	       int nmshrs)		/* MSHRs, 0 for no limit */
+{
+  char name[128], c;
+  int nsets, bsize, assoc;
+
+  if (!mystricmp(opt, "none"))
+    return NULL;
+  if (sscanf(opt, "%[^:]:%d:%d:%d:%c",
+	     name, &nsets, &bsize, &assoc, &c) != 5)
+    fatal("bad cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
+  return cache_create(name, nsets, bsize, assoc, cache_char2policy(c),
+		      blk_access_fn, lat, nmshrs);
+}
+
 /* cycle counter */
 unsigned sim_cycle;
 
+/* functional unit latency overrides, <unit>:<oplat>:<issuelat> each */
+static char *fu_lat_specs[NUM_FU_CLASSES];
+static int fu_lat_nspecs = 0;
+
+/* pipetrace output file and range */
+static char *ptrace_opts[2];
+static int ptrace_nelt = 0;
+
+/* cycles EX waited for a busy functional unit */
+static counter_t sim_fu_stalls = 0;
+
+/* cycles WB waited for a long-latency result */
+static counter_t sim_wb_stalls = 0;
+
+/* CPI stack components, every cycle either retires an instruction or is
+   charged to the cause of the bubble that reached writeback instead */
+enum cpi_component {
+  CPI_BASE = 0,			/* an instruction retired */
+  CPI_RAW_LOAD,			/* decode waited for a load result */
+  CPI_RAW_ALU,			/* decode waited for any other result */
+  CPI_BRANCH,			/* a mispredicted branch squashed fetch */
+  CPI_STRUCTURAL,		/* no functional unit accepted the operation */
+  CPI_LATENCY,			/* writeback waited for a long-latency result */
+  CPI_ICACHE,			/* fetch waited for an instruction cache miss */
+  CPI_DCACHE,			/* waited for a data cache miss or MSHR */
+  CPI_FILL,			/* pipeline filling at simulation start */
+  NUM_CPI_COMPONENTS
+};
+
+/* CPI stack component names, stats are cpi.<name> */
+static char *cpi_name[NUM_CPI_COMPONENTS] = {
+  "base", "raw_load", "raw_alu", "branch", "structural", "latency",
+  "icache", "dcache", "fill"
+};
+
+/* CPI stack component descriptions */
+static char *cpi_desc[NUM_CPI_COMPONENTS] = {
+  "cycles retiring an instruction",
+  "cycles lost to RAW stalls on loads",
+  "cycles lost to RAW stalls on non-load results",
+  "cycles lost to branch mispredictions",
+  "cycles lost to busy functional units",
+  "cycles lost waiting for long-latency results at writeback",
+  "cycles lost to instruction cache misses",
+  "cycles lost to data cache misses and write buffer stalls",
+  "cycles lost filling the pipeline"
+};
+
+/* cycles charged to each CPI stack component */
+static counter_t cpi_cycles[NUM_CPI_COMPONENTS];
+
+/* number of functions with a CPI stack of their own in the stats output */
+static int cpi_nfuncs;
+
+/* cycles charged to each CPI stack component by function, indexed by text
+   symbol, the last entry collects cycles outside all functions */
+static counter_t (*cpi_fn_cycles)[NUM_CPI_COMPONENTS] = NULL;
+
+/*
+ * functional unit resource configuration, latencies follow sim-outorder
+ */
+
+/* resource pool indices, NOTE: update these if you change FU_CONFIG */
+#define FU_IALU_INDEX			0
+#define FU_IMULT_INDEX			1
+#define FU_MEMPORT_INDEX		2
+#define FU_FPALU_INDEX			3
+#define FU_FPMULT_INDEX			4
+
+/* resource pool definition, NOTE: update FU_*_INDEX defs if you change this */
+static struct res_desc fu_config[] = {
+  {
+    "integer-ALU",
+    1,
+    0,
+    {
+      { IntALU, 1, 1 }
+    }
+  },
+  {
+    "integer-MULT/DIV",
+    1,
+    0,
+    {
+      { IntMULT, 3, 1 },
+      { IntDIV, 20, 19 }
+    }
+  },
+  {
+    "memory-port",
+    1,
+    0,
+    {
+      { RdPort, 1, 1 },
+      { WrPort, 1, 1 }
+    }
+  },
+  {
+    "FP-adder",
+    1,
+    0,
+    {
+      { FloatADD, 2, 1 },
+      { FloatCMP, 2, 1 },
+      { FloatCVT, 2, 1 }
+    }
+  },
+  {
+    "FP-MULT/DIV",
+    1,
+    0,
+    {
+      { FloatMULT, 4, 1 },
+      { FloatDIV, 12, 12 },
+      { FloatSQRT, 24, 24 }
+    }
+  },
+};
+
+/* functional unit resource pool */
+static struct res_pool *fu_pool = NULL;
+
 /* register simulator-specific options */
 void
 sim_reg_options(struct opt_odb_t *odb)
@@ -110,19 +413,397 @@ sim_reg_options(struct opt_odb_t *odb)
            &max_insts, /* default */0,
            /* print */TRUE, /* format */NULL);
 
+  /* pipeline organization options */
+  opt_reg_int(odb, "-pipe:fetch", "number of instruction fetch stages",
+	      &pipe_fetch_stages, /* default */1,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-pipe:decode", "number of decode stages",
+	      &pipe_decode_stages, /* default */1,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-pipe:exec", "number of execute stages",
+	      &pipe_exec_stages, /* default */1,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-pipe:mem", "number of memory access stages",
+	      &pipe_mem_stages, /* default */1,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-pipe:resolve",
+		 "stage that resolves branches, i.e., {id|ex|mem}",
+		 &pipe_resolve, /* default */"id",
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-pipe:fwd",
+		 "forwarding network, i.e., {full|mem|none}",
+		 &pipe_forward, /* default */"full",
+		 /* print */TRUE, /* format */NULL);
+
+  /* branch predictor options */
+  opt_reg_note(odb,
+"  Branch predictor configuration examples for 2-level predictor:\n"
+"    Configurations:   N, M, W, X\n"
+"      N   # entries in first level (# of shift register(s))\n"
+"      M   # entries in 2nd level (# of counters, or other FSM)\n"
+"      W   width of shift register(s)\n"
+"      X   (yes-1/no-0) xor history and address for 2nd level index\n"
+"    Sample predictors:\n"
+"      GAg     : 1, 2^W, W, 0\n"
+"      GAp     : 1, M (M > 2^W), W, 0\n"
+"      PAg     : N, 2^W, W, 0\n"
+"      PAp     : N, M (M == 2^(N+W)), W, 0\n"
+"      gshare  : 1, 2^W, W, 1\n"
+"  The default, nottaken, always fetches the fall-through path, so every\n"
+"  taken branch or jump squashes the instructions fetched behind it.\n"
+	       );
+
+  opt_reg_string(odb, "-bpred",
+		 "branch predictor type {nottaken|taken|bimod|2lev}",
+		 &pred_type, /* default */"nottaken",
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_int_list(odb, "-bpred:bimod",
+		   "bimodal predictor config (<table size>)",
+		   bimod_config, bimod_nelt, &bimod_nelt,
+		   /* default */bimod_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:2lev",
+		   "2-level predictor config "
+		   "(<l1size> <l2size> <hist_size> <xor>)",
+		   twolev_config, twolev_nelt, &twolev_nelt,
+		   /* default */twolev_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:btb",
+		   "BTB config (<num_sets> <associativity>)",
+		   btb_config, btb_nelt, &btb_nelt,
+		   /* default */btb_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-bpred:ras",
+	      "return address stack size (0 for no return stack)",
+	      &ras_size, /* default */ras_size,
+	      /* print */TRUE, /* format */NULL);
+
+  /* cache options */
+  opt_reg_string(odb, "-cache:il1",
+		 "l1 inst cache config, i.e., {<config>|none}",
+		 &cache_il1_opt, "none",
+		 /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-cache:il1lat",
+	      "l1 instruction cache hit latency (in cycles)",
+	      &cache_il1_lat, /* default */1,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-cache:dl1",
+		 "l1 data cache config, i.e., {<config>|none}",
+		 &cache_dl1_opt, "none",
+		 /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-cache:dl1lat",
+	      "l1 data cache hit latency (in cycles)",
+	      &cache_dl1_lat, /* default */1,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:dl1:mshrs",
+	      "l1 data cache MSHRs, i.e., outstanding misses (0 for blocking)",
+	      &cache_dl1_mshrs, /* default */4,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-cache:dl2",
+		 "unified l2 cache config, i.e., {<config>|none}",
+		 &cache_dl2_opt, "none",
+		 /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-cache:dl2lat",
+	      "l2 cache hit latency (in cycles)",
+	      &cache_dl2_lat, /* default */6,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:wbuf",
+	      "store write buffer entries (0 for no write buffer)",
+	      &wbuf_size, /* default */8,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int_list(odb, "-mem:lat",
+		   "memory access latency (<first_chunk> <inter_chunk>)",
+		   mem_lat, mem_nelt, &mem_nelt, mem_lat,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-mem:width", "memory access bus width (in bytes)",
+	      &mem_bus_width, /* default */8,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_note(odb,
+"  The cache config parameter <config> has the following format:\n"
+"\n"
+"    <name>:<nsets>:<bsize>:<assoc>:<repl>\n"
+"\n"
+"    <name>   - name of the cache being defined\n"
+"    <nsets>  - number of sets in the cache\n"
+"    <bsize>  - block size of the cache\n"
+"    <assoc>  - associativity of the cache\n"
+"    <repl>   - block replacement strategy, 'l'-LRU, 'f'-FIFO, 'r'-random\n"
+"\n"
+"    Examples:   -cache:dl1 dl1:4096:32:1:l\n"
+"                -cache:dl2 ul2:1024:64:2:l\n"
+"\n"
+"  Caches are off by default, i.e., every access hits in one cycle.  The\n"
+"  l1 data cache is non-blocking: a load that misses leaves the pipeline\n"
+"  once it has an MSHR, and only instructions that use its result wait.\n"
+"  Stores retire into the write buffer, which drains to the l1 data cache\n"
+"  in the background.\n"
+	       );
+
+  /* functional unit options */
+  opt_reg_string_list(odb, "-fu:lat",
+		      "functional unit latencies, <unit>:<oplat>:<issuelat> "
+		      "(e.g., fu-int-divide:20:19)",
+		      fu_lat_specs, NUM_FU_CLASSES, &fu_lat_nspecs,
+		      /* default */NULL, /* print */TRUE, /* format */NULL,
+		      /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-res:ialu",
+	      "total number of integer ALU's available",
+	      &fu_config[FU_IALU_INDEX].quantity,
+	      /* default */fu_config[FU_IALU_INDEX].quantity,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-res:imult",
+	      "total number of integer multiplier/dividers available",
+	      &fu_config[FU_IMULT_INDEX].quantity,
+	      /* default */fu_config[FU_IMULT_INDEX].quantity,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-res:memport",
+	      "total number of memory system ports available (to CPU)",
+	      &fu_config[FU_MEMPORT_INDEX].quantity,
+	      /* default */fu_config[FU_MEMPORT_INDEX].quantity,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-res:fpalu",
+	      "total number of floating point ALU's available",
+	      &fu_config[FU_FPALU_INDEX].quantity,
+	      /* default */fu_config[FU_FPALU_INDEX].quantity,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-res:fpmult",
+	      "total number of floating point multiplier/dividers available",
+	      &fu_config[FU_FPMULT_INDEX].quantity,
+	      /* default */fu_config[FU_FPMULT_INDEX].quantity,
+	      /* print */TRUE, /* format */NULL);
+
+  /* pipetrace options */
+  opt_reg_string_list(odb, "-ptrace",
+		      "generate pipetrace, i.e., <fname|stdout|stderr> <range>",
+		      ptrace_opts, /* arr_sz */2, &ptrace_nelt, /* default */NULL,
+		      /* !print */FALSE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_note(odb,
+"  Pipetraces are written in the Kanata format of the Konata pipeline viewer.\n"
+"  Pipetrace range arguments are formatted as follows:\n"
+"\n"
+"    {{@|#}<start>}:{{@|#|+}<end>}\n"
+"\n"
+"  Both ends of the range are optional, if neither are specified, the entire\n"
+"  execution is traced.  Ranges that start with a `@' designate an address\n"
+"  range to be traced, those that start with an `#' designate a cycle count\n"
+"  range.  All other range values represent an instruction count range.  The\n"
+"  second argument, if specified with a `+', indicates a value relative\n"
+"  to the first argument, e.g., 1000:+100 == 1000:1100.\n"
+"\n"
+"    Examples:   -ptrace FOO.trc #0:#1000\n"
+"                -ptrace BAR.trc @0x400140:\n"
+"                -ptrace BLAH.trc :1500\n"
+"                -ptrace UXXE.trc :\n"
+	       );
+
+  opt_reg_int(odb, "-cpi:funcs",
+	      "print the CPI stacks of this many functions with the most cycles",
+	      &cpi_nfuncs, /* default */0, /* print */TRUE, /* format */NULL);
+}
+
+/* set the latencies of functional unit class NAME in all units */
+static void
+fu_set_latency(char *name, int oplat, int issuelat)
+{
+  int i, j, class;
+
+  for (class=1; class < NUM_FU_CLASSES; class++)
+    {
+      if (!strcmp(MD_FU_NAME(class), name))
+	break;
+    }
+  if (class == NUM_FU_CLASSES)
+    fatal("unknown functional unit class `%s'", name);
+
+  for (i=0; i < N_ELT(fu_config); i++)
+    {
+      for (j=0; j < MAX_RES_CLASSES && fu_config[i].x[j].class; j++)
+	{
+	  if (fu_config[i].x[j].class == class)
+	    {
+	      fu_config[i].x[j].oplat = oplat;
+	      fu_config[i].x[j].issuelat = issuelat;
+	    }
+	}
+    }
 }
 
 /* check simulator-specific option values */
 void
 sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 {
-  /* nada */
+  int i, oplat, issuelat;
+  char name[128];
+
+  if (pipe_fetch_stages < 1 || pipe_decode_stages < 1
+      || pipe_exec_stages < 1 || pipe_mem_stages < 1)
+    fatal("every pipeline stage kind needs at least one stage");
+  if (pipe_fetch_stages + pipe_decode_stages + pipe_exec_stages
+      + pipe_mem_stages + /* WB */1 > MAX_PIPE_STAGES)
+    fatal("pipelines are limited to %d stages", MAX_PIPE_STAGES);
+
+  if (!mystricmp(pipe_resolve, "id"))
+    pipe_resolve_kind = STAGE_ID;
+  else if (!mystricmp(pipe_resolve, "ex"))
+    pipe_resolve_kind = STAGE_EX;
+  else if (!mystricmp(pipe_resolve, "mem"))
+    pipe_resolve_kind = STAGE_MEM;
+  else
+    fatal("unknown branch resolution stage `%s'", pipe_resolve);
+
+  if (!mystricmp(pipe_forward, "full"))
+    pipe_fwd = FWD_FULL;
+  else if (!mystricmp(pipe_forward, "mem"))
+    pipe_fwd = FWD_MEM;
+  else if (!mystricmp(pipe_forward, "none"))
+    pipe_fwd = FWD_NONE;
+  else
+    fatal("unknown forwarding network `%s'", pipe_forward);
+
+  if (btb_nelt != 2)
+    fatal("bad btb config (<num_sets> <associativity>)");
+  if (ras_size < 0)
+    fatal("bad return address stack size `%d'", ras_size);
+
+  if (!mystricmp(pred_type, "nottaken"))
+    {
+      /* static predictor, not taken */
+      pred = bpred_create(BPredNotTaken, 0, 0, 0, 0, 0, 0, 0, 0);
+    }
+  else if (!mystricmp(pred_type, "taken"))
+    {
+      /* static predictor, taken */
+      pred = bpred_create(BPredTaken, 0, 0, 0, 0, 0,
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* ret-addr stack size */ras_size);
+    }
+  else if (!mystricmp(pred_type, "bimod"))
+    {
+      /* bimodal predictor, bpred_create() checks BTB_SIZE */
+      if (bimod_nelt != 1)
+	fatal("bad bimod predictor config (<table_size>)");
+
+      pred = bpred_create(BPred2bit,
+			  /* bimod table size */bimod_config[0],
+			  /* 2lev l1 size */0,
+			  /* 2lev l2 size */0,
+			  /* history reg size */0,
+			  /* history xor address */0,
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* ret-addr stack size */ras_size);
+    }
+  else if (!mystricmp(pred_type, "2lev"))
+    {
+      /* 2-level adaptive predictor, bpred_create() checks args */
+      if (twolev_nelt != 4)
+	fatal("bad 2-level pred config (<l1size> <l2size> <hist_size> <xor>)");
+
+      pred = bpred_create(BPred2Level,
+			  /* bimod table size */0,
+			  /* 2lev l1 size */twolev_config[0],
+			  /* 2lev l2 size */twolev_config[1],
+			  /* history reg size */twolev_config[2],
+			  /* history xor address */twolev_config[3],
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* ret-addr stack size */ras_size);
+    }
+  else
+    fatal("cannot parse predictor type `%s'", pred_type);
+
+  if (mem_nelt != 2)
+    fatal("bad memory access latency (<first_chunk> <inter_chunk>)");
+  if (mem_lat[0] < 1 || mem_lat[1] < 1)
+    fatal("all memory access latencies must be greater than zero");
+  if (mem_bus_width < 1 || (mem_bus_width & (mem_bus_width-1)) != 0)
+    fatal("memory bus width must be a positive power-of-two");
+  if (cache_dl1_mshrs < 0)
+    fatal("number of l1 data cache MSHRs must be positive");
+  if (wbuf_size < 0)
+    fatal("number of write buffer entries must be positive");
+
+  /* the l2 cache and the l1 instruction cache, which has a single
+     outstanding fetch at a time, track any number of misses */
+  cache_dl2 = cache_from_opt(cache_dl2_opt, l2_access_fn, cache_dl2_lat, 0);
+  cache_il1 = cache_from_opt(cache_il1_opt, l1_access_fn, cache_il1_lat, 0);
+  cache_dl1 = cache_from_opt(cache_dl1_opt, l1_access_fn, cache_dl1_lat,
+			     cache_dl1_mshrs);
+  if (wbuf_size)
+    wbuf = (struct wbuf_ent *)calloc(wbuf_size, sizeof(struct wbuf_ent));
+
+  for (i=0; i < N_ELT(fu_config); i++)
+    {
+      if (fu_config[i].quantity < 1
+	  || fu_config[i].quantity > MAX_INSTS_PER_CLASS)
+	fatal("number of %s units must be between 1 and %d",
+	      fu_config[i].name, MAX_INSTS_PER_CLASS);
+    }
+
+  for (i=0; i < fu_lat_nspecs; i++)
+    {
+      if (sscanf(fu_lat_specs[i], "%127[^:]:%d:%d",
+		 name, &oplat, &issuelat) != 3)
+	fatal("bad functional unit latency `%s', "
+	      "use <unit>:<oplat>:<issuelat>", fu_lat_specs[i]);
+      if (oplat < 1 || issuelat < 1)
+	fatal("functional unit latencies must be at least one cycle");
+      fu_set_latency(name, oplat, issuelat);
+    }
+
+  /* the pool copies the unit templates, so create it after the overrides */
+  fu_pool = res_create_pool("fu-pool", fu_config, N_ELT(fu_config));
+
+  if (ptrace_nelt == 2)
+    {
+      /* generate a pipeline trace */
+      ptrace_open(/* fname */ptrace_opts[0], /* range */ptrace_opts[1]);
+    }
+  else if (ptrace_nelt == 1)
+    {
+      /* trace the whole execution */
+      ptrace_open(/* fname */ptrace_opts[0], /* range */NULL);
+    }
+  else if (ptrace_nelt != 0)
+    fatal("bad pipetrace args, use: <fname|stdout|stderr> <range>");
+
+  if (cpi_nfuncs < 0)
+    fatal("number of CPI stack functions must be positive");
 }
 
 /* register simulator-specific statistics */
 void
 sim_reg_stats(struct stat_sdb_t *sdb)
 {
+  int i;
+  char buf[512], buf1[512], buf2[512];
+
   stat_reg_counter(sdb, "sim_num_insn",
            "total number of instructions executed",
            &sim_num_insn, sim_num_insn, NULL);
@@ -133,17 +814,50 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 
   stat_reg_formula(sdb, "sim_cpi",
            "cycles per instruction (CPI)",
-           "sim_cycles / sim_num_insn", NULL);
+           "sim_cycles / (sim_num_insn - sim_insn_base)", NULL);
 
   stat_reg_counter(sdb, "sim_num_refs",
            "total number of loads and stores executed",
            &sim_num_refs, 0, NULL);
+  stat_reg_counter(sdb, "sim_fu_stalls",
+           "cycles EX waited for a busy functional unit",
+           &sim_fu_stalls, 0, NULL);
+  stat_reg_counter(sdb, "sim_wb_stalls",
+           "cycles WB waited for a long-latency result",
+           &sim_wb_stalls, 0, NULL);
+
+  /* register predictor stats */
+  sprintf(buf, "bpred_%s", pred_type);
+  bpred_reg_stats(pred, sdb, mystrdup(buf));
+
+  /* register cache stats */
+  if (cache_il1)
+    cache_reg_stats(cache_il1, sdb);
+  if (cache_dl1)
+    cache_reg_stats(cache_dl1, sdb);
+  if (cache_dl2)
+    cache_reg_stats(cache_dl2, sdb);
+
+  for (i=0; i < NUM_CPI_COMPONENTS; i++)
+    {
+      sprintf(buf, "cpi.%s", cpi_name[i]);
+      stat_reg_counter(sdb, mystrdup(buf), cpi_desc[i],
+		       &cpi_cycles[i], 0, NULL);
+    }
+  for (i=0; i < NUM_CPI_COMPONENTS; i++)
+    {
+      sprintf(buf, "cpi.%s_cpi", cpi_name[i]);
+      sprintf(buf1, "cpi.%s / (sim_num_insn - sim_insn_base)", cpi_name[i]);
+      sprintf(buf2, "CPI stack, %s", cpi_desc[i]);
+      stat_reg_formula(sdb, mystrdup(buf), mystrdup(buf2),
+		       mystrdup(buf1), NULL);
+    }
   stat_reg_int(sdb, "sim_elapsed_time",
            "total simulation time in seconds",
            &sim_elapsed_time, 0, NULL);
   stat_reg_formula(sdb, "sim_inst_rate",
            "simulation speed (in insts/sec)",
-           "sim_num_insn / sim_elapsed_time", NULL);
+           "(sim_num_insn - sim_insn_base) / sim_elapsed_time", NULL);
   ld_reg_stats(sdb);
   mem_reg_stats(mem, sdb);
 }
@@ -157,6 +871,9 @@ sim_init(void)
   /* allocate and initialize register file */
   regs_init(&regs);
 
+  /* the host profiler samples the PC of the instruction being simulated */
+  HOSTPROF_GUEST_PC(&regs.regs_PC);
+
   /* allocate and initialize memory space */
   mem = mem_create("mem");
   mem_init(mem);
@@ -170,27 +887,108 @@ sim_load_prog(char *fname,      /* program to load */
 {
   /* load program text and data, set up environment, memory, and regs */
   ld_load_prog(fname, argc, argv, envp, &regs, mem, TRUE);
+
+  if (cpi_nfuncs > 0)
+    {
+      if (eio_valid(fname))
+	fatal("per-function CPI stacks need the program binary, not a trace");
+
+      /* one CPI stack per text symbol, plus one for unknown code */
+      sym_loadsyms(ld_prog_fname, /* !locals */FALSE);
+      cpi_fn_cycles = calloc(sym_ntextsyms + 1, sizeof(*cpi_fn_cycles));
+      if (!cpi_fn_cycles)
+	fatal("out of virtual memory");
+    }
 }
 
 /* print simulator-specific configuration information */
 void
 sim_aux_config(FILE *stream)        /* output stream */
 {
-  /* nothing currently */
+  int class, i, j;
+
+  bpred_config(pred, stream);
+  if (cache_il1)
+    cache_config(cache_il1, stream);
+  if (cache_dl1)
+    cache_config(cache_dl1, stream);
+  if (cache_dl2)
+    cache_config(cache_dl2, stream);
+
+  /* effective latencies of each functional unit class */
+  for (class=1; class < NUM_FU_CLASSES; class++)
+    {
+      for (i=0; i < N_ELT(fu_config); i++)
+	{
+	  for (j=0; j < MAX_RES_CLASSES && fu_config[i].x[j].class; j++)
+	    {
+	      if (fu_config[i].x[j].class == class)
+		fprintf(stream, "fu: %-18s %-18s oplat %2d issuelat %2d\n",
+			MD_FU_NAME(class), fu_config[i].name,
+			fu_config[i].x[j].oplat, fu_config[i].x[j].issuelat);
+	    }
+	}
+    }
 }
 
 /* dump simulator-specific auxiliary simulator statistics */
 void
 sim_aux_stats(FILE *stream)     /* output stream */
 {
-  /* nada */
+  int i, j, n, *order;
+  counter_t total;
+
+  if (!cpi_fn_cycles)
+    return;
+
+  /* sort functions by cycles, with a simple selection of the top N */
+  order = (int *)calloc(sym_ntextsyms + 1, sizeof(int));
+  if (!order)
+    fatal("out of virtual memory");
+  for (i=0; i <= sym_ntextsyms; i++)
+    order[i] = i;
+
+  fprintf(stream, "\ncpi stack by function, cycles per component:\n");
+  fprintf(stream, "%-24s %12s", "function", "cycles");
+  for (j=0; j < NUM_CPI_COMPONENTS; j++)
+    fprintf(stream, " %11s", cpi_name[j]);
+  fprintf(stream, "\n");
+
+  for (n=0; n < cpi_nfuncs && n <= sym_ntextsyms; n++)
+    {
+      int best = n;
+      counter_t best_total = 0;
+
+      for (i=n; i <= sym_ntextsyms; i++)
+	{
+	  for (total=0, j=0; j < NUM_CPI_COMPONENTS; j++)
+	    total += cpi_fn_cycles[order[i]][j];
+	  if (total > best_total)
+	    {
+	      best = i;
+	      best_total = total;
+	    }
+	}
+      if (best_total == 0)
+	break;
+      i = order[n]; order[n] = order[best]; order[best] = i;
+
+      fprintf(stream, "%-24.24s ", order[n] < sym_ntextsyms
+	      ? sym_textsyms[order[n]]->name : "<unknown>");
+      myfprintf(stream, "%12n", best_total);
+      for (j=0; j < NUM_CPI_COMPONENTS; j++)
+	myfprintf(stream, " %11n", cpi_fn_cycles[order[n]][j]);
+      fprintf(stream, "\n");
+    }
+
+  free(order);
 }
 
 /* un-initialize simulator-specific state */
 void
 sim_uninit(void)
 {
-  /* nada */
+  ptrace_close();
 }
 
 
@@ -280,13 +1078,18 @@ sim_uninit(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-// pipeline registeres
-enum pipeline_register {
-    IF_ID_REGISTER=0,
-    ID_EX_REGISTER,
-    EX_MEM_REGISTER,
-    MEM_WB_REGISTER,
-    PIPEDEPTH
+// pipeline stages: -pipe:fetch IF stages, -pipe:decode ID stages and so on,
+// followed by WB; the pipeline register after stage k is g_piperegister[k],
+// and stage k works on the instruction in g_piperegister[k-1]
+int             g_depth = 0;                          // number of stages
+enum stage_kind g_stage_kind[MAX_PIPE_STAGES];        // kind of each stage
+int             g_stage_first[MAX_PIPE_STAGES];       // first of its kind?
+int             g_stage_last[MAX_PIPE_STAGES];        // last of its kind?
+char            g_stage_name[MAX_PIPE_STAGES][8];     // e.g., "EX2"
+
+// pipetrace stage of each stage kind
+char *stage_pst[NUM_STAGE_KINDS] = {
+    PST_IFETCH, PST_DECODE, PST_EXECUTE, PST_MEMORY, PST_WRITEBACK
 };
 
 // instruction status
@@ -299,70 +1102,216 @@ enum instruction_status {
     DONE
 };
 
-// the instruction type
+// instruction sequence number, i.e., position in the instruction window;
+// these are 64 bits wide so that they never wrap around
+typedef qword_t inst_seq_t;
+#define NO_PRODUCER 0       // sequence number of no instruction
+
+// the instruction type; the fields other instructions read to check their
+// dependencies come first
 typedef struct Inst {
+    inst_seq_t   seq;       // sequence number
+    unsigned     donecycle; // cycle when destination operand(s) generated
+    int          dmiss;     // the data cache access missed
+    md_inst_t    inst;      // instruction bits from memory
+    int          status;    // where is the instruction in the pipeline?
     unsigned     uid;       // instruction number
     unsigned     pc;	    // instruction address
     unsigned	 next_pc;   // next instruction address
-    md_inst_t    inst;      // instruction bits from memory
     enum md_opcode op;	    // opcode
     int          taken;     // if branch, is it taken?
-    int          status;    // where is the instruction in the pipeline?
-    struct Inst *src[3];    // src operand instructions
+    md_addr_t    pred_pc;   // next instruction address fetch predicted
+    int          mispredicted; // pred_pc is not next_pc
+    struct bpred_update_t bp_update; // predictor state for update/recovery
+    inst_seq_t   src[3];    // instructions producing the source operands
     int          dst[2];    // registers written by this instruction
     int          stalled;   // instruction is stalled
-    unsigned     donecycle; // cycle when destination operand(s) generated
-    struct Inst *next;      // used for custom memory allocation/deallocation
+    unsigned     fucycle;   // cycle when its functional unit produces the result
+    int          wrongpath; // fetched behind an unresolved mispredicted branch
+    int          srcreg[3]; // registers read by this instruction
+    md_addr_t    addr;      // address accessed by a load or store
+    unsigned     memcycle;  // cycle its data cache access completes
+    int          traced;    // instruction is pipetraced
+    char        *stage;     // last pipeline stage entered (PST_*)
+    unsigned     stallcycles; // cycles spent stalled so far
+    int          stallreason; // reason of the last stall
 } inst_t;
 
-// fast memory allocator for instruction type (improves simulation speed)
-#define NI 32
-inst_t g_inst[NI];
-inst_t *g_head, *g_tail;
+// stall reasons
+enum stall_reason {
+    STALL_NONE=0,
+    STALL_RAW,          // waiting for a source operand
+    STALL_FU,           // no functional unit can accept the operation
+    STALL_LATENCY,      // waiting for its own long-latency result
+    STALL_PIPELINE,     // next pipeline register is occupied
+    STALL_DCACHE,       // waiting for the data cache or write buffer
+    NUM_STALL_REASONS
+};
+
+char *stall_name[NUM_STALL_REASONS] = {
+    "none", "raw", "fu", "latency", "pipeline", "dcache"
+};
+
+// global pipeline variables
+inst_t   *g_piperegister[MAX_PIPE_STAGES];
+inst_seq_t g_raw[MD_TOTAL_REGS];    // track register dependencies
+unsigned  g_reg_ready[MD_TOTAL_REGS]; // cycle a retired load's data arrives
+unsigned  g_ifetch_ready = 0;       // cycle an instruction cache miss ends
+int       g_misfetch;
+md_addr_t g_fetch_pc = 0;
+md_addr_t g_target_pc = 0;
+md_addr_t g_redirect_pc = 0;        // address of the branch redirecting fetch
+int       g_fetch_redirected = 0;
+int       g_branch_pending = 0;     // a mispredicted branch has not been resolved
+unsigned g_uid = 1;
 
-void init_pool()
+// instruction window: the instructions in flight, oldest to youngest, are
+// the records g_win_head..g_win_tail-1 of a ring indexed by sequence number;
+// instructions leave at the head when they retire and at the tail when
+// they are squashed, so allocation is O(1) and never searches
+#define WIN_LINE 64                 // records start on a cache line
+#define WIN_SLOT(SEQ) (&g_win[(SEQ) & (g_win_size - 1)])
+inst_t     *g_win = NULL;           // g_win_size records, a power of two
+void       *g_win_mem = NULL;       // allocation holding g_win
+unsigned    g_win_size = 0;
+inst_seq_t  g_win_head = 1;         // oldest instruction in flight
+inst_seq_t  g_win_tail = 1;         // next instruction to allocate
+
+// resize the instruction window to size records, moving the instructions in
+// flight (sequence numbers stay valid, record addresses do not)
+void grow_window(unsigned size)
 {
-    int i;
-    for( i=0; i<(NI-1); ++i ) {
-        g_inst[i].next = &g_inst[i+1];
+    void *mem;
+    inst_t *win, *x;
+    inst_seq_t seq;
+    int k;
+
+    mem = calloc(size * sizeof(inst_t) + WIN_LINE, 1);
+    if( mem == NULL )
+        fatal("out of virtual memory");
+    win = (inst_t *)(((unsigned long)mem + WIN_LINE - 1)
+                     & ~(unsigned long)(WIN_LINE - 1));
+    for( seq=g_win_head; seq<g_win_tail; ++seq )
+        win[seq & (size - 1)] = *WIN_SLOT(seq);
+    for( k=0; k<g_depth; ++k ) {
+        x = g_piperegister[k];
+        if( x != NULL )
+            g_piperegister[k] = &win[x->seq & (size - 1)];
     }
-    g_head = g_inst;
-    g_tail = g_inst;
-    while( g_tail->next ) g_tail = g_tail->next;
+    free(g_win_mem);
+    g_win_mem = mem;
+    g_win = win;
+    g_win_size = size;
+}
+
+void init_window()
+{
+    grow_window(32);
 }
 
 inst_t *alloc_inst()
 {
-    inst_t *tmp = g_head;
-    g_head = g_head->next; // seg. fault only if there is a "memory leak"
-    assert( g_head );
-    tmp->next = NULL;
-    return tmp;
+    inst_t *x;
+
+    if( g_win_tail - g_win_head == g_win_size )
+        grow_window(2 * g_win_size);
+    x = WIN_SLOT(g_win_tail);
+    x->seq = g_win_tail++;
+    return x;
 }
 
 void free_inst( inst_t *x )
 {
-    assert( g_tail->next == NULL );
-    assert( x->next == NULL );
-    g_tail->next = x;
-    g_tail = x;
+    if( x->seq == g_win_head )
+        g_win_head++;               // retired
+    else if( x->seq == g_win_tail - 1 )
+        g_win_tail--;               // squashed
+    else
+        panic("instruction %u left the window out of order", x->uid);
 }
 
-// global pipeline variables
-inst_t   *g_piperegister[PIPEDEPTH];
-inst_t   *g_raw[MD_TOTAL_REGS];     // track register dependencies
-int       g_misfetch;
-int       g_resolve_at_decode=1; 
-md_addr_t g_fetch_pc = 0;
-md_addr_t g_target_pc = 0;
-int       g_fetch_redirected = 0;
-unsigned g_uid = 1;
+// the instruction in flight with sequence number seq, or NULL if it has
+// retired, i.e., its result is in the register file, or there is none
+inst_t *producer(inst_seq_t seq)
+{
+    if( seq < g_win_head || seq >= g_win_tail )
+        return NULL;
+    return WIN_SLOT(seq);
+}
+
+// cause and blamed instruction address of the bubble in each empty
+// pipeline register
+struct bubble {
+    enum cpi_component cause;
+    md_addr_t          pc;
+} g_bubble[MAX_PIPE_STAGES];
+
+// CPI stack component and blamed instruction address of this cycle
+struct bubble g_cycle;
+
+// text symbol of the last cycle charged to a function
+struct sym_sym_t *g_cpi_sym = NULL;
+int               g_cpi_sym_index = 0;
+
+// charge this cycle to CPI stack component c, and to the function at pc
+void charge_cycle(enum cpi_component c, md_addr_t pc)
+{
+    cpi_cycles[c]++;
+    if( cpi_fn_cycles == NULL )
+        return;
+
+    // consecutive cycles are mostly spent in the same function
+    if( g_cpi_sym == NULL || pc < g_cpi_sym->addr
+        || pc >= g_cpi_sym->addr + g_cpi_sym->size ) {
+        g_cpi_sym = sym_bind_addr(pc, &g_cpi_sym_index, FALSE, sdb_text);
+        if( g_cpi_sym == NULL )
+            g_cpi_sym_index = sym_ntextsyms;
+    }
+    cpi_fn_cycles[g_cpi_sym_index][c]++;
+}
+
+// empty pipeline register r holds a bubble caused by c, blamed on pc
+void set_bubble(int r, enum cpi_component c, md_addr_t pc)
+{
+    g_bubble[r].cause = c;
+    g_bubble[r].pc = pc;
+}
+
+// append n stages of the given kind to the pipeline
+void add_stages(enum stage_kind kind, int n)
+{
+    static char *name[NUM_STAGE_KINDS] = { "IF", "ID", "EX", "MEM", "WB" };
+    int i, k;
+
+    for( i=0; i<n; ++i ) {
+        k = g_depth++;
+        g_stage_kind[k] = kind;
+        g_stage_first[k] = (i == 0);
+        g_stage_last[k] = (i == n-1);
+        if( n > 1 )
+            sprintf(g_stage_name[k], "%s%d", name[kind], i+1);
+        else
+            strcpy(g_stage_name[k], name[kind]);
+    }
+}
 
 void cpen411_init()
 {
+    int i;
+
     fprintf(stderr, "sim: ** starting CPEN 411 pipeline simulation **\n");
 
-    init_pool();
+    init_window();
+
+    add_stages(STAGE_IF, pipe_fetch_stages);
+    add_stages(STAGE_ID, pipe_decode_stages);
+    add_stages(STAGE_EX, pipe_exec_stages);
+    add_stages(STAGE_MEM, pipe_mem_stages);
+    add_stages(STAGE_WB, 1);
+
+    // all pipeline registers start out empty
+    for( i=0; i<g_depth; ++i )
+        set_bubble(i, CPI_FILL, regs.regs_PC);
 
     /* set up initial default next PC */
     g_fetch_pc = regs.regs_PC;
@@ -375,14 +1324,47 @@ bool is_load(inst_t* i){
     return (MD_OP_FLAGS(op) & F_LOAD); // (MD_OP_FLAGS(op) & F_FCOMP);
 }
 
+bool is_store(inst_t* i){
+    enum md_opcode op;
+    MD_SET_OPCODE(op, i->inst);
+    return (MD_OP_FLAGS(op) & F_STORE);
+}
+
 bool is_branch(inst_t* i){
     enum md_opcode op;
     MD_SET_OPCODE(op, i->inst);
     return (MD_OP_FLAGS(op) & F_CTRL);
 }
 
+// instruction x is in pipeline stage pstage this cycle
+void enter_stage(inst_t *x, char *pstage)
+{
+    if( x->stage == pstage )
+        return;
+    x->stage = pstage;
+    if( x->traced )
+        ptrace_newstage(x->uid, pstage);
+}
+
+// instruction x spends this cycle stalled for the given reason
+void stall(inst_t *x, enum stall_reason reason)
+{
+    char buf[64];
+
+    x->stallcycles++;
+    if( x->traced && x->stallreason != reason ) {
+        sprintf(buf, "%s %s stall @%u", x->stage, stall_name[reason], sim_cycle);
+        ptrace_label(x->uid, buf);
+    }
+    x->stallreason = reason;
+}
+
 void forward(inst_t* i){
-    i->donecycle = sim_cycle;
+    // a result is forwarded from the first forwarding point it reaches, but
+    // not before its functional unit produces it
+    if( i->donecycle != 0xFFFFFFFF )
+        return;
+    i->donecycle = MAX(sim_cycle, i->fucycle);
     i->status = DONE; // i.e., finished writing back this cycle
 
     // release destination regs
@@ -400,30 +1382,155 @@ void forward(inst_t* i){
     */
 }
 
+// the instruction stage k works on this cycle, or NULL for a bubble, which
+// moves on into the next pipeline register if that one is free
+inst_t *stage_input(int k)
+{
+    inst_t *pI = g_piperegister[k-1];
+
+    if( pI == NULL ) {
+        if( k < g_depth-1 && g_piperegister[k] == NULL )
+            g_bubble[k] = g_bubble[k-1];
+        return NULL;
+    }
+    enter_stage(pI, stage_pst[g_stage_kind[k]]);
+    return pI;
+}
+
+// returns non-zero, after charging a stall to pI, if the pipeline register
+// after stage k is still occupied
+int blocked(int k, inst_t *pI)
+{
+    if( g_piperegister[k] == NULL )
+        return 0;
+    stall(pI, STALL_PIPELINE);
+    return 1;
+}
+
+// branch pI leaves stage k: train the predictor with its outcome and, if it
+// was mispredicted, squash the younger instructions fetched down the wrong
+// path and redirect fetch to the correct next instruction
+void resolve(int k, inst_t *pI)
+{
+    int r;
+    inst_t *x;
+
+    HOSTPROF_SWITCH(hp_bpred);
+    bpred_update(pred, pI->pc, pI->next_pc, pI->taken, !pI->mispredicted,
+                 pI->op, &pI->bp_update);
+    if( pI->mispredicted )
+        bpred_recover(pred, pI->pc, &pI->bp_update);
+    HOSTPROF_SWITCH(hp_timing);
+    if( !pI->mispredicted )
+        return;
+
+    for( r=0; r<k-1; ++r ) {
+        x = g_piperegister[r];
+        if( x != NULL ) {
+            assert( x->wrongpath || x->status == FETCHED );
+            if( x->traced )
+                ptrace_endinst(x->uid, /* flush */TRUE);
+            free_inst(x);
+            g_piperegister[r] = NULL;
+        }
+        set_bubble(r, CPI_BRANCH, pI->pc);
+    }
+    g_branch_pending = 0;
+    g_fetch_redirected = 1;
+    g_target_pc = pI->next_pc;
+    g_redirect_pc = pI->pc;
+}
+
+// move instruction pI from the pipeline register before stage k to the one
+// after it
+void advance(int k, inst_t *pI)
+{
+    g_piperegister[k] = pI;
+    g_piperegister[k-1] = NULL;
+    if( g_stage_last[k] && g_stage_kind[k] == pipe_resolve_kind
+        && (MD_OP_FLAGS(pI->op) & F_CTRL) )
+        resolve(k, pI);
+}
+
+// a stage that only moves instructions along, e.g., the second of two
+// fetch stages
+void pass(int k)
+{
+    inst_t *pI = stage_input(k);
+
+    if( pI == NULL || blocked(k, pI) )
+        return;
+    advance(k, pI);
+}
+
 
 
 
 void fetch(void)
 {
     md_inst_t inst;
+    enum md_opcode op;
+    md_addr_t target;
     inst_t *pI = NULL;
+    int lat;
 
-    if( g_piperegister[IF_ID_REGISTER] != NULL )
+    if( g_piperegister[0] != NULL )
         return; // pipeline is stalled
 
+    // wait for an instruction cache miss to be serviced, unless fetch is
+    // redirected, which abandons a miss down the wrong path
+    if( g_fetch_redirected ) {
+        g_ifetch_ready = 0;
+    } else if( cache_il1 != NULL && g_ifetch_ready == 0 ) {
+        HOSTPROF_SWITCH(hp_cache);
+        lat = cache_access(cache_il1, Read, g_fetch_pc, sim_cycle);
+        HOSTPROF_SWITCH(hp_timing);
+        if( lat > 1 )
+            g_ifetch_ready = sim_cycle + lat - 1;
+    }
+    if( g_ifetch_ready != 0 ) {
+        if( sim_cycle < g_ifetch_ready ) {
+            set_bubble(0, CPI_ICACHE, g_fetch_pc);
+            return;
+        }
+        g_ifetch_ready = 0;
+    }
+
     // allocate an instruction record, fill in basic information
     pI            = alloc_inst();
     pI->taken     = 0;
+    pI->mispredicted = 0;
     pI->stalled   = 0;
     pI->pc        = g_fetch_pc;
     pI->status    = ALLOCATED;
     pI->op        = 0;
     pI->donecycle = 0xFFFFFFFF; // i.e., largest unsigned integer
+    pI->fucycle   = 0;
+    pI->wrongpath = 0;
+    pI->src[0] = pI->src[1] = pI->src[2] = NO_PRODUCER;
+    pI->srcreg[0] = pI->srcreg[1] = pI->srcreg[2] = DNA;
+    pI->dst[0] = pI->dst[1] = DNA;
+    pI->memcycle  = 0xFFFFFFFF;
+    pI->dmiss     = 0;
     pI->uid       = g_uid++;
-
-    /* get the instruction bits from the instruction memory */
-    MD_FETCH_INST(inst, mem, g_fetch_pc);
+    pI->stage     = PST_IFETCH;
+    pI->stallcycles = 0;
+    pI->stallreason = STALL_NONE;
+
+    /* get the instruction bits from the instruction memory, a wrong path
+       may lead outside of the text segment, fetch a nop from there */
+    HOSTPROF_SWITCH(hp_decode);
+    if( ld_text_base <= g_fetch_pc && g_fetch_pc < ld_text_base+ld_text_size
+        && !(g_fetch_pc & (sizeof(md_inst_t)-1)) ) {
+        MD_FETCH_INST(inst, mem, g_fetch_pc);
+    } else
+        inst = MD_NOP_INST;
     pI->inst = inst;
+    HOSTPROF_SWITCH(hp_timing);
+
+    pI->traced = ptrace_check_active(g_fetch_pc, sim_num_insn, sim_cycle);
+    if( pI->traced )
+        ptrace_newinst(pI->uid, inst, g_fetch_pc);
 
     if( g_fetch_redirected ) {
        // set PC to target of branch/jump
@@ -432,19 +1539,38 @@ void fetch(void)
        // Opps... it looks like we fetched the wrong instruction. So, turn it into a "bubble" by 
        // deleting the instruction and leaving the IF/ID register "empty".  Note that, in 
        // hardware we would mux a nop (all zeros) into the IF/ID instruction register field.
+       if( pI->traced )
+           ptrace_endinst(pI->uid, /* flush */TRUE);
+       set_bubble(0, CPI_BRANCH, g_redirect_pc);
        free_inst(pI);
        g_fetch_redirected = 0;
     } else {
-       // set PC to point to next sequential instruction
-       g_fetch_pc += sizeof(md_inst_t);
+       // decode just enough to find control instructions, without executing
+       // anything (instructions fetched down a wrong path never execute),
+       // and ask the branch predictor where they go
+       HOSTPROF_SWITCH(hp_decode);
+       MD_SET_OPCODE(op, inst);
+       pI->op = op;
+       pI->pred_pc = g_fetch_pc + sizeof(md_inst_t);
+       if( MD_OP_FLAGS(op) & F_CTRL ) {
+           HOSTPROF_SWITCH(hp_bpred);
+           target = bpred_lookup(pred, g_fetch_pc, op, MD_IS_CALL(op),
+                                 MD_IS_RETURN(op), &pI->bp_update);
+           if( target != 0 )
+               pI->pred_pc = target;
+       }
+       HOSTPROF_SWITCH(hp_timing);
+
+       // set PC to point to the predicted next instruction
+       g_fetch_pc = pI->pred_pc;
 
        // place the instruction in the IF/ID register
        pI->status = FETCHED; 
-       g_piperegister[IF_ID_REGISTER] = pI; 
+       g_piperegister[0] = pI; 
     }
 }
 
-void decode(void)
+void decode(int k)
 {
     md_inst_t inst;
     register md_addr_t addr;
@@ -454,15 +1580,28 @@ void decode(void)
     int i;
     int i1, i2, i3, o1, o2;
 
-    inst_t *pI = g_piperegister[IF_ID_REGISTER];
+    inst_t *pI, *src;
 
-    if( g_piperegister[ID_EX_REGISTER] != NULL )
-        return; // stall
+    if( !g_stage_last[k] ) {
+        pass(k); // instructions are decoded in the last decode stage
+        return;
+    }
+
+    pI = stage_input(k);
     if( pI == NULL )
         return; // bubble
+    if( blocked(k, pI) )
+        return; // stall
 
-    if( !pI->stalled ) {
+    // instructions behind a mispredicted branch that has not been resolved
+    // yet were fetched down the wrong path, they are squashed without
+    // executing
+    if( g_branch_pending && !pI->stalled )
+        pI->wrongpath = 1;
+
+    if( !pI->stalled && !pI->wrongpath ) {
         // BEGIN FUNCTIONAL EXECUTION -->
+        HOSTPROF_SWITCH(hp_exec);
         assert( pI->pc == regs.regs_PC );
 
         /* maintain $r0 semantics */
@@ -524,6 +1663,7 @@ void decode(void)
         regs.regs_PC = regs.regs_NPC;
         regs.regs_NPC += sizeof(md_inst_t);
 
+        HOSTPROF_SWITCH(hp_timing);
         // <---  END FUNCTIONAL EXECUTION
 
 	// record correct next instruction address (use for branches/jumps)
@@ -533,16 +1673,23 @@ void decode(void)
         pI->src[0] = g_raw[i1];
         pI->src[1] = g_raw[i2];
         pI->src[2] = g_raw[i3];
+        pI->srcreg[0] = i1;
+        pI->srcreg[1] = i2;
+        pI->srcreg[2] = i3;
+        pI->addr = addr;
 
         // record which register(s) this instruction writes to
-        if( o1 != DNA ) g_raw[o1] = pI;
-        if( o2 != DNA ) g_raw[o2] = pI;
+        if( o1 != DNA ) g_raw[o1] = pI->seq;
+        if( o2 != DNA ) g_raw[o2] = pI->seq;
         pI->dst[0] = o1;
         pI->dst[1] = o2;
 
         // determine instruction type
         if( MD_OP_FLAGS(op) & F_CTRL ) 
             pI->taken = (regs.regs_PC != (pI->pc+sizeof(md_inst_t)));
+        pI->mispredicted = (pI->next_pc != pI->pred_pc);
+        if( pI->mispredicted )
+            g_branch_pending = 1;
     }
 
     // check for RAW hazard
@@ -551,7 +1698,8 @@ void decode(void)
     for ( i=0; i < 3; ++i ) { 
 
         // if there's a dependency for that register in the current pipeline
-        if ( pI->src[i] != NULL ) {
+        src = producer(pI->src[i]);
+        if ( src != NULL ) {
 
             // get the space between the current instruction and the instruction with the dependency
             // get the instruction type of the current instruction 
@@ -562,68 +1710,229 @@ void decode(void)
             
 
             // then stall until the current instruction is complete
-            if( pI->src[i]->donecycle > sim_cycle ) {
+            if( src->donecycle > sim_cycle ) {
                 // src[i] has not written to register file this cycle or earlier
 		pI->stalled = 1;
+                stall(pI, STALL_RAW);
+                set_bubble(k, src->dmiss ? CPI_DCACHE
+                           : is_load(src) ? CPI_RAW_LOAD : CPI_RAW_ALU, pI->pc);
                 return;
             }
         }
+
+        // a load that left the pipeline before its data cache miss was
+        // serviced keeps its destination registers busy until the data
+        // arrives: they can be neither read...
+        else if( g_reg_ready[pI->srcreg[i]] > sim_cycle ) {
+            pI->stalled = 1;
+            stall(pI, STALL_RAW);
+            set_bubble(k, CPI_DCACHE, pI->pc);
+            return;
+        }
     }
 
-    if( pI->taken ) {
-        g_fetch_redirected = 1;
-        g_target_pc = pI->next_pc;
+    // ...nor written
+    for ( i=0; i < 2; ++i ) {
+        if( pI->dst[i] != DNA && g_reg_ready[pI->dst[i]] > sim_cycle ) {
+            pI->stalled = 1;
+            stall(pI, STALL_RAW);
+            set_bubble(k, CPI_DCACHE, pI->pc);
+            return;
+        }
     }
 
     // move instruction from IF/ID to ID/EX register...
     pI->stalled = 0;
     pI->status = DECODED;
-    g_piperegister[ID_EX_REGISTER] = pI; // move to ID/EX register
-    g_piperegister[IF_ID_REGISTER] = NULL;
+    advance(k, pI); // move to ID/EX register
 }
 
-void execute()
+void release_fu(void)
 {
-    inst_t *pI = g_piperegister[ID_EX_REGISTER];
+    int i;
 
-    if( g_piperegister[EX_MEM_REGISTER] != NULL )
-        return; // stall
+    // a unit accepts a new operation issuelat cycles after the last one
+    for( i=0; i<fu_pool->num_resources; ++i ) {
+        if( fu_pool->resources[i].busy > 0 )
+            fu_pool->resources[i].busy--;
+    }
+}
+
+void execute(int k)
+{
+    inst_t *pI;
+    enum md_fu_class fuclass;
+    struct res_template *fu = NULL;
+
+    if( !g_stage_first[k] && !g_stage_last[k] ) {
+        pass(k);
+        return;
+    }
+
+    pI = stage_input(k);
     if( pI == NULL )
         return; // bubble
+    if( blocked(k, pI) )
+        return; // stall
+
+    // operations issue to their functional unit in the first execute stage
+    if( g_stage_first[k] ) {
+        // structural hazard: wait for a unit that can accept the operation
+        // (e.g., an unpipelined divider is busy for issuelat cycles)
+        fuclass = MD_OP_FUCLASS(pI->op);
+        if( fuclass != FUClass_NA ) {
+            fu = res_get(fu_pool, fuclass);
+            if( fu == NULL ) {
+                pI->stalled = 1;
+                sim_fu_stalls++;
+                stall(pI, STALL_FU);
+                set_bubble(k, CPI_STRUCTURAL, pI->pc);
+                return;
+            }
+            fu->master->busy = fu->issuelat;
+        }
+
+        // the unit produces the result oplat cycles after the last execute
+        // stage starts; meanwhile the instruction moves on down the pipeline
+        pI->fucycle = sim_cycle + (pipe_exec_stages - 1)
+            + ((fu != NULL) ? fu->oplat - 1 : 0);
+    }
     pI->stalled = 0;
     pI->status = EXECUTED;
 
-    g_piperegister[EX_MEM_REGISTER] = pI; // move to EX/MEM register
-    g_piperegister[ID_EX_REGISTER] = NULL;
+    advance(k, pI); // move to EX/MEM register
 
+    // with full forwarding, the result of any operation except a load
+    // operation can be forwarded from the last execute stage
+    if( g_stage_last[k] && pipe_fwd == FWD_FULL
+        && !is_load(pI) && !is_branch(pI) )
+        forward(pI);
+}
 
-    // the result of any operation except a load operation can be forwarded
-    // in the execute stage
-    if(!is_load(pI) && !is_branch(pI)) forward(pI);
+// stores retire into the write buffer, which writes them into the L1 data
+// cache one at a time, in order; returns 1 once store pI is in the buffer,
+// or CACHE_MSHR_FULL if neither the buffer nor the cache can take it yet
+int wbuf_insert(inst_t *pI)
+{
+    struct wbuf_ent *ent = &wbuf[wbuf_tail];
+    struct wbuf_ent *last = &wbuf[(wbuf_tail + wbuf_size - 1) % wbuf_size];
+    tick_t start;
+    int lat;
+
+    if( ent->done > sim_cycle )
+        return CACHE_MSHR_FULL; // the oldest store has not drained yet
+    start = MAX(sim_cycle, last->done);
+    HOSTPROF_SWITCH(hp_cache);
+    lat = cache_access(cache_dl1, Write, pI->addr, start);
+    HOSTPROF_SWITCH(hp_timing);
+    if( lat == CACHE_MSHR_FULL )
+        return CACHE_MSHR_FULL;
+    ent->addr = pI->addr;
+    ent->done = start + lat;
+    wbuf_tail = (wbuf_tail + 1) % wbuf_size;
+    return 1;
 }
 
-void memory()
+// does the write buffer still hold a store to the doubleword load pI reads?
+int wbuf_match(inst_t *pI)
 {
-    inst_t *pI = g_piperegister[EX_MEM_REGISTER];
-    if( g_piperegister[MEM_WB_REGISTER] != NULL )
-        return; // stall
+    int i;
+
+    for( i=0; i<wbuf_size; ++i ) {
+        if( wbuf[i].done > sim_cycle && (wbuf[i].addr >> 3) == (pI->addr >> 3) )
+            return 1;
+    }
+    return 0;
+}
+
+// load or store pI accesses the L1 data cache in the last memory stage k;
+// returns zero while the access holds pI in the memory stage
+int data_access(int k, inst_t *pI)
+{
+    int lat;
+
+    if( pI->memcycle == 0xFFFFFFFF ) {
+        if( wbuf_size > 0 && is_store(pI) )
+            lat = wbuf_insert(pI);
+        else if( wbuf_size > 0 && wbuf_match(pI) )
+            lat = cache_dl1_lat; // the write buffer forwards the data
+        else {
+            HOSTPROF_SWITCH(hp_cache);
+            lat = cache_access(cache_dl1, is_store(pI) ? Write : Read,
+                               pI->addr, sim_cycle);
+            HOSTPROF_SWITCH(hp_timing);
+        }
+        if( lat == CACHE_MSHR_FULL ) {
+            // try again next cycle
+            stall(pI, STALL_DCACHE);
+            set_bubble(k, CPI_DCACHE, pI->pc);
+            return 0;
+        }
+        pI->memcycle = sim_cycle + lat - 1;
+        pI->dmiss = (lat > cache_dl1_lat);
+    }
+
+    // a blocking cache holds loads in the memory stage until their data
+    // arrives, and stores that do not go through a write buffer until the
+    // cache has been written
+    if( pI->memcycle > sim_cycle && (cache_dl1_mshrs == 0 || is_store(pI)) ) {
+        stall(pI, STALL_DCACHE);
+        set_bubble(k, CPI_DCACHE, pI->pc);
+        return 0;
+    }
+    pI->fucycle = MAX(pI->fucycle, pI->memcycle);
+    return 1;
+}
+
+void memory(int k)
+{
+    inst_t *pI;
+
+    if( !g_stage_last[k] ) {
+        pass(k); // loads complete in the last memory stage
+        return;
+    }
+
+    pI = stage_input(k);
     if( pI == NULL )
         return; // bubble, nothing to do
+    if( blocked(k, pI) )
+        return; // stall
 
-    pI->status = MEMORY_STAGE_COMPLETED;
-    g_piperegister[MEM_WB_REGISTER] = pI; // move to MEM/WB register
-    g_piperegister[EX_MEM_REGISTER] = NULL;
+    // loads and stores access the data cache
+    if( cache_dl1 != NULL && (MD_OP_FLAGS(pI->op) & F_MEM)
+        && !data_access(k, pI) )
+        return; // stall
 
+    pI->status = MEMORY_STAGE_COMPLETED;
+    advance(k, pI); // move to MEM/WB register
 
-    // all operations can be forwarded immediately from the memory stage
-    forward(pI);
+    // all operations can be forwarded immediately from the memory stage,
+    // unless there is no forwarding network at all
+    if( pipe_fwd != FWD_NONE )
+        forward(pI);
 }
 
-void writeback(void)
+void writeback(int k)
 {
-    inst_t *pI = g_piperegister[MEM_WB_REGISTER];
-    if( pI == NULL )
+    inst_t *pI = stage_input(k);
+    if( pI == NULL ) {
+        // nothing retires this cycle, charge it to the cause of the bubble
+        g_cycle = g_bubble[k-1];
         return; // bubble, nothing to do
+    }
+
+    // instructions complete in order, so a long-latency operation holds
+    // MEM/WB until its result has been produced; only a load waiting for a
+    // non-blocking data cache leaves without its result
+    if( pI->fucycle > sim_cycle
+        && !(cache_dl1 != NULL && cache_dl1_mshrs > 0 && is_load(pI)) ) {
+        sim_wb_stalls++;
+        stall(pI, STALL_LATENCY);
+        g_cycle.cause = CPI_LATENCY;
+        g_cycle.pc = pI->pc;
+        return;
+    }
 
     // instruction has completely finished executing
 
@@ -631,18 +1940,35 @@ void writeback(void)
     // currently in the pipeline, we erase the mapping from architected
     // register to this instruction here:
 
-    if( (pI->dst[0] != DNA) && (g_raw[pI->dst[0]] == pI) )
-        g_raw[ pI->dst[0] ] = NULL;
-    if( (pI->dst[1] != DNA) && (g_raw[pI->dst[1]] == pI) )
-        g_raw[ pI->dst[1] ] = NULL;
+    if( (pI->dst[0] != DNA) && (g_raw[pI->dst[0]] == pI->seq) )
+        g_raw[ pI->dst[0] ] = NO_PRODUCER;
+    if( (pI->dst[1] != DNA) && (g_raw[pI->dst[1]] == pI->seq) )
+        g_raw[ pI->dst[1] ] = NO_PRODUCER;
 
-    pI->donecycle = sim_cycle;
+    // ...and later instructions find out about a load result that has not
+    // arrived yet from g_reg_ready
+    if( pI->fucycle > sim_cycle ) {
+        if( pI->dst[0] != DNA ) g_reg_ready[ pI->dst[0] ] = pI->fucycle;
+        if( pI->dst[1] != DNA ) g_reg_ready[ pI->dst[1] ] = pI->fucycle;
+    }
+
+    pI->donecycle = MAX(sim_cycle, pI->fucycle);
     pI->status = DONE; // i.e., finished writing back this cycle
-    g_piperegister[MEM_WB_REGISTER] = NULL;
+    g_piperegister[k-1] = NULL;
+    g_cycle.cause = CPI_BASE;
+    g_cycle.pc = pI->pc;
+    if( pI->traced ) {
+        char buf[64];
+        if( pI->stallcycles ) {
+            sprintf(buf, "stalled %u cycles", pI->stallcycles);
+            ptrace_label(pI->uid, buf);
+        }
+        ptrace_endinst(pI->uid, /* flush */FALSE);
+    }
     free_inst(pI);
-        // instruction will not be reused immediately (see implementation of
-        // alloc_inst, and free_inst) so "status" will remain "DONE" while
-        // any dependent instructions continue through pipeline
+        // instructions still holding its sequence number in src[] now find
+        // that it has retired (see producer()), i.e., its result is in the
+        // register file, or in g_reg_ready
 }
 
 void print_instruction( inst_t *x )
@@ -671,6 +1997,9 @@ void print_instruction( inst_t *x )
 
 void display_pipeline()
 {
+    int k;
+    char name[32];
+
     // call this function from within gdb to print out status of pipeline
     // if you encounter a bug, or to visualize pipeline operation
     // (this is a good way to "verify" your pipeline model makes sense!)
@@ -678,32 +2007,43 @@ void display_pipeline()
     printf("========================================\n");
     printf("pipeline status at end of cycle %u:\n", sim_cycle);
     printf("========================================\n");
-    printf("PC     :=             0x%6x\n", g_fetch_pc );
-    printf("IF/ID  := ");
-    print_instruction( g_piperegister[IF_ID_REGISTER] );
-    printf("ID/EX  := ");
-    print_instruction( g_piperegister[ID_EX_REGISTER] );
-    printf("EX/MEM := ");
-    print_instruction( g_piperegister[EX_MEM_REGISTER] );
-    printf("MEM/WB := ");
-    print_instruction( g_piperegister[MEM_WB_REGISTER] );
+    printf("PC       :=             0x%6x\n", g_fetch_pc );
+    for( k=0; k<g_depth-1; ++k ) {
+        sprintf(name, "%s/%s", g_stage_name[k], g_stage_name[k+1]);
+        printf("%-8s := ", name);
+        print_instruction( g_piperegister[k] );
+    }
     printf("\n");
 }
 
 /* start simulation, program loaded, processor precise state initialized */
 void sim_main(void)
 {
+    int k;
+
     cpen411_init();
 
     do {
-        writeback();
-        memory();
-        execute();
-        decode();
-        fetch();
-        
-        inst_t* IF = g_piperegister[IF_ID_REGISTER];
-        
+        HOSTPROF_INSN(hp_timing); // the host profiler samples whole cycles
+        ptrace_newcycle(sim_cycle);
+        release_fu();
+
+        // oldest first, so that each stage sees the pipeline register after
+        // it already emptied by the next stage
+        for( k=g_depth-1; k>=0; --k ) {
+            switch( g_stage_kind[k] ) {
+            case STAGE_IF:  if( k == 0 ) fetch(); else pass(k); break;
+            case STAGE_ID:  decode(k); break;
+            case STAGE_EX:  execute(k); break;
+            case STAGE_MEM: memory(k); break;
+            case STAGE_WB:  writeback(k); break;
+            default: panic("bogus pipeline stage");
+            }
+        }
+
+        // a cycle cut short by the program exiting is not charged
+        charge_cycle(g_cycle.cause, g_cycle.pc);
+
         sim_cycle++;
     } while (!max_insts || sim_num_insn < max_insts);
 }
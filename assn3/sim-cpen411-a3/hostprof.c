@@ -0,0 +1,549 @@
+/* hostprof.c - simulator self-profiling routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _MSC_VER
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "options.h"
+#include "stats.h"
+#include "loader.h"
+#include "symbol.h"
+#include "eio.h"
+#include "hostprof.h"
+
+#ifdef HOST_PROFILE
+
+/* component names and descriptions, in enum hostprof_comp_t order */
+static char *comp_name[hp_NUM] = {
+  "other", "decode", "exec", "xlate", "syscall", "bpred", "cache", "timing"
+};
+static char *comp_desc[hp_NUM] = {
+  "simulator setup and unhooked code",
+  "instruction fetch and decode",
+  "functional execution",
+  "memory translation",
+  "system calls",
+  "branch predictors",
+  "cache models",
+  "other timing models"
+};
+
+/* instructions between timed instructions */
+static int hostprof_period;
+
+/* component being charged */
+volatile enum hostprof_comp_t hostprof_cur = hp_other;
+
+/* timing the current instruction? */
+int hostprof_sampling = FALSE;
+
+/* instructions left until the next sampling decision */
+int hostprof_countdown = 1;
+
+/* host ticks charged to each component in timed instructions, and in
+   regions timed on every occurrence */
+static qword_t sampled[hp_NUM];
+static qword_t exact[hp_NUM];
+
+/* tick of the last switch */
+static qword_t last_tick;
+
+/* inside a region timed on every occurrence? */
+static int in_exact;
+
+/* sampling state saved by hostprof_begin() */
+static int saved_sampling;
+
+/* start of the profile and of the main loop, in ticks, and start of the
+   profile on the wall clock */
+static qword_t start_tick;
+static qword_t loop_tick;
+static double start_wall;
+
+/* breakdown in seconds, computed by hostprof_stop() */
+static double secs[hp_NUM];
+static double total_secs;
+
+/* highest SIGPROF sample rate, profiling timers only fire on the kernel
+   tick, so faster rates are not honoured */
+#define SIGPROF_MAX_HZ		1000
+
+/* SIGPROF samples per second (0 for none), and functions to print */
+static int sigprof_hz;
+static int sigprof_nfuncs;
+
+/* guest PC named by the simulator */
+static md_addr_t *guest_pc = NULL;
+
+/* SIGPROF sample counts per guest PC, an open-addressed hash table that is
+   allocated up front, since the signal handler cannot allocate */
+#define SAMPLE_TAB_SZ		(1 << 16)
+#define SAMPLE_PROBES		16
+struct pc_samples_t {
+  md_addr_t pc;			/* guest PC, 0 for a free entry */
+  unsigned int n[hp_NUM];	/* samples per component */
+};
+static struct pc_samples_t *sample_tab = NULL;
+
+/* samples taken, samples without a guest PC, samples the table dropped */
+static counter_t nsamples = 0;
+static counter_t nsamples_nopc = 0;
+static counter_t nsamples_dropped = 0;
+
+/* read the host cycle counter, or a nanosecond clock where there is none */
+static qword_t
+host_tick(void)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+  return __builtin_ia32_rdtsc();
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (qword_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (qword_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+#endif
+}
+
+/* wall clock time, in seconds */
+static double
+host_wall(void)
+{
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+#endif
+}
+
+/* charge the time since the last switch to the current component, and
+   continue with component COMP */
+void
+hostprof_switch(enum hostprof_comp_t comp)
+{
+  qword_t now = host_tick();
+
+  if (in_exact)
+    exact[hostprof_cur] += now - last_tick;
+  else
+    sampled[hostprof_cur] += now - last_tick;
+  last_tick = now;
+  hostprof_cur = comp;
+}
+
+/* instruction boundary, decide whether to time the next instruction, which
+   starts in component COMP */
+void
+hostprof_insn(enum hostprof_comp_t comp)
+{
+  if (!hostprof_sampling)
+    {
+      /* time the next instruction */
+      last_tick = host_tick();
+      if (!loop_tick)
+	loop_tick = last_tick;
+      hostprof_cur = comp;
+      hostprof_sampling = TRUE;
+      hostprof_countdown = 1;
+    }
+  else
+    {
+      /* close the timed instruction */
+      hostprof_switch(comp);
+      if (hostprof_period > 1)
+	{
+	  hostprof_sampling = FALSE;
+	  hostprof_countdown = hostprof_period - 1;
+	}
+      else
+	hostprof_countdown = 1;
+    }
+}
+
+/* time a rare region in component COMP on every occurrence, returns the
+   component to hand to hostprof_end() */
+enum hostprof_comp_t
+hostprof_begin(enum hostprof_comp_t comp)
+{
+  enum hostprof_comp_t prev = hostprof_cur;
+
+  if (hostprof_sampling)
+    hostprof_switch(comp);
+  else
+    {
+      last_tick = host_tick();
+      hostprof_cur = comp;
+    }
+
+  /* everything up to hostprof_end() is timed */
+  saved_sampling = hostprof_sampling;
+  hostprof_sampling = TRUE;
+  in_exact = TRUE;
+
+  return prev;
+}
+
+void
+hostprof_end(enum hostprof_comp_t prev)
+{
+  hostprof_switch(prev);
+  hostprof_sampling = saved_sampling;
+  in_exact = FALSE;
+}
+
+/* guest PC recorded by the SIGPROF sampler */
+void
+hostprof_guest_pc(md_addr_t *pc)
+{
+  guest_pc = pc;
+}
+
+/* SIGPROF handler, charges a sample to the current guest PC and component */
+static void
+sigprof_handler(int sig)
+{
+  md_addr_t pc = guest_pc ? *guest_pc : 0;
+  enum hostprof_comp_t comp = hostprof_cur;
+  unsigned int i, h;
+
+  nsamples++;
+  if (pc == 0)
+    {
+      nsamples_nopc++;
+      return;
+    }
+
+  h = (unsigned int)(pc >> 2) * 2654435761u;
+  for (i=0; i < SAMPLE_PROBES; i++)
+    {
+      struct pc_samples_t *e = &sample_tab[(h + i) & (SAMPLE_TAB_SZ - 1)];
+
+      if (e->pc == 0)
+	e->pc = pc;
+      if (e->pc == pc)
+	{
+	  e->n[comp]++;
+	  return;
+	}
+    }
+  nsamples_dropped++;
+}
+
+/* start or stop the SIGPROF timer */
+static void
+sigprof_timer(int hz)
+{
+#ifndef _MSC_VER
+  struct itimerval itv;
+
+  itv.it_interval.tv_sec = 0;
+  itv.it_interval.tv_usec = hz > 0 ? MAX(1000000 / hz, 1) : 0;
+  itv.it_value = itv.it_interval;
+  if (setitimer(ITIMER_PROF, &itv, NULL) < 0)
+    fatal("could not set the host profiler's SIGPROF timer");
+#else
+  fatal("SIGPROF sampling is not supported on this host");
+#endif
+}
+
+/* register host profiler options */
+void
+hostprof_reg_options(struct opt_odb_t *odb)	/* options database */
+{
+  opt_reg_int(odb, "-hostprof:period",
+	      "instructions between instructions timed by the host profiler"
+	      " (1 times all)",
+	      &hostprof_period, /* default */17, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-hostprof:hz",
+	      "SIGPROF samples of the guest PC per second of host CPU time"
+	      " (0 for none, at most 1000)",
+	      &sigprof_hz, /* default */0, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-hostprof:funcs",
+	      "print the SIGPROF samples of this many guest functions",
+	      &sigprof_nfuncs, /* default */20, /* print */TRUE, NULL);
+}
+
+/* register host profiler stats */
+void
+hostprof_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
+{
+  int i;
+  char buf[512], buf1[512];
+
+  stat_reg_double(sdb, "host.total",
+		  "host time profiled, in seconds",
+		  &total_secs, 0.0, "%12.6f");
+  for (i=0; i < hp_NUM; i++)
+    {
+      sprintf(buf, "host.%s", comp_name[i]);
+      sprintf(buf1, "host time in %s, in seconds", comp_desc[i]);
+      stat_reg_double(sdb, mystrdup(buf), mystrdup(buf1),
+		      &secs[i], 0.0, "%12.6f");
+    }
+  for (i=0; i < hp_NUM; i++)
+    {
+      sprintf(buf, "host.%s_frac", comp_name[i]);
+      sprintf(buf1, "host.%s / host.total", comp_name[i]);
+      stat_reg_formula(sdb, mystrdup(buf),
+		       "fraction of host time in this component",
+		       mystrdup(buf1), NULL);
+    }
+  if (sigprof_hz > 0)
+    {
+      stat_reg_counter(sdb, "host.samples",
+		       "SIGPROF samples taken",
+		       &nsamples, 0, NULL);
+      stat_reg_counter(sdb, "host.samples_dropped",
+		       "SIGPROF samples dropped by a full sample table",
+		       &nsamples_dropped, 0, NULL);
+      stat_reg_formula(sdb, "host.sample_rate",
+		       "SIGPROF samples taken per second of host time profiled",
+		       "host.samples / host.total", "%12.2f");
+    }
+}
+
+/* start timing, at the start of simulation */
+void
+hostprof_start(void)
+{
+  int i;
+
+  if (hostprof_period < 1)
+    fatal("host profiler period must be at least one instruction");
+  if (sigprof_hz < 0 || sigprof_hz > SIGPROF_MAX_HZ)
+    fatal("SIGPROF sample rate must be between 0 and %d Hz", SIGPROF_MAX_HZ);
+
+  for (i=0; i < hp_NUM; i++)
+    sampled[i] = exact[i] = 0;
+  hostprof_cur = hp_other;
+  hostprof_sampling = FALSE;
+  hostprof_countdown = 1;
+  in_exact = FALSE;
+  loop_tick = 0;
+
+  if (sigprof_hz > 0)
+    {
+#ifndef _MSC_VER
+      struct sigaction sa;
+
+      sample_tab = calloc(SAMPLE_TAB_SZ, sizeof(struct pc_samples_t));
+      if (!sample_tab)
+	fatal("out of virtual memory");
+
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_handler = sigprof_handler;
+      sigemptyset(&sa.sa_mask);
+      sa.sa_flags = SA_RESTART;
+      if (sigaction(SIGPROF, &sa, NULL) < 0)
+	fatal("could not install the host profiler's SIGPROF handler");
+#endif
+      sigprof_timer(sigprof_hz);
+    }
+
+  start_wall = host_wall();
+  start_tick = host_tick();
+}
+
+/* stop timing and compute the breakdown, before the stats are printed */
+void
+hostprof_stop(void)
+{
+  int i;
+  qword_t now;
+  double sec_per_tick, loop_ticks, nsampled, hooked;
+
+  /* no more samples while the stats are computed */
+  if (sample_tab)
+    sigprof_timer(0);
+
+  /* close an instruction cut short by the end of simulation */
+  if (hostprof_sampling)
+    {
+      hostprof_switch(hp_other);
+      hostprof_sampling = FALSE;
+      in_exact = FALSE;
+    }
+
+  now = host_tick();
+  total_secs = host_wall() - start_wall;
+  sec_per_tick = now > start_tick ? total_secs / (double)(now - start_tick) : 0.0;
+
+  /* the timed instructions give the split of the main loop's time, less the
+     regions timed exactly; normalizing to the loop's time, rather than
+     scaling by the period, also takes out the profiler's own overhead */
+  loop_ticks = loop_tick ? (double)(now - loop_tick) : 0.0;
+  nsampled = 0.0;
+  for (i=0; i < hp_NUM; i++)
+    {
+      loop_ticks -= (double)exact[i];
+      nsampled += (double)sampled[i];
+    }
+  loop_ticks = MAX(loop_ticks, 0.0);
+
+  hooked = 0.0;
+  for (i=0; i < hp_NUM; i++)
+    {
+      secs[i] = (double)exact[i];
+      if (nsampled > 0.0)
+	secs[i] += loop_ticks * (double)sampled[i] / nsampled;
+      secs[i] *= sec_per_tick;
+      if (i != hp_other)
+	hooked += secs[i];
+    }
+
+  /* `other' gets what the hooks did not claim, mostly the time before the
+     main loop started */
+  secs[hp_other] = MAX(total_secs - hooked, 0.0);
+
+  /* keep the fractions well-defined on empty runs */
+  total_secs = MAX(total_secs, 1e-9);
+}
+
+/* print the SIGPROF samples by guest function, after the stats */
+void
+hostprof_print_funcs(FILE *stream)
+{
+  int i, j, n, nfuncs, *order;
+  counter_t (*fn)[hp_NUM], total;
+  struct sym_sym_t *sym;
+
+  if (!sample_tab)
+    return;
+
+  /* one row per text symbol, plus one for code outside of any */
+  nfuncs = 0;
+  if (ld_prog_fname && !eio_valid(ld_prog_fname))
+    {
+      sym_loadsyms(ld_prog_fname, /* !locals */FALSE);
+      nfuncs = sym_ntextsyms;
+    }
+  fn = calloc(nfuncs + 1, sizeof(*fn));
+  order = (int *)calloc(nfuncs + 1, sizeof(int));
+  if (!fn || !order)
+    fatal("out of virtual memory");
+
+  for (i=0; i < SAMPLE_TAB_SZ; i++)
+    {
+      if (sample_tab[i].pc == 0)
+	continue;
+      sym = nfuncs > 0
+	? sym_bind_addr(sample_tab[i].pc, &n, FALSE, sdb_text) : NULL;
+      if (sym == NULL)
+	n = nfuncs;
+      for (j=0; j < hp_NUM; j++)
+	fn[n][j] += sample_tab[i].n[j];
+    }
+  for (i=0; i <= nfuncs; i++)
+    order[i] = i;
+
+  myfprintf(stream, "\nhost time samples by guest function, %n samples at %d Hz"
+	    " (%.0f Hz achieved)", nsamples, sigprof_hz, nsamples / total_secs);
+  if (nsamples_nopc > 0 || nsamples_dropped > 0)
+    myfprintf(stream, " (%n without a guest PC, %n dropped)",
+	      nsamples_nopc, nsamples_dropped);
+  fprintf(stream, ":\n%-24s %10s", "function", "samples");
+  for (j=0; j < hp_NUM; j++)
+    fprintf(stream, " %8s", comp_name[j]);
+  fprintf(stream, "\n");
+
+  /* sort functions by samples, with a simple selection of the top N */
+  for (n=0; n < sigprof_nfuncs && n <= nfuncs; n++)
+    {
+      int best = n;
+      counter_t best_total = 0;
+
+      for (i=n; i <= nfuncs; i++)
+	{
+	  for (total=0, j=0; j < hp_NUM; j++)
+	    total += fn[order[i]][j];
+	  if (total > best_total)
+	    {
+	      best = i;
+	      best_total = total;
+	    }
+	}
+      if (best_total == 0)
+	break;
+      i = order[n]; order[n] = order[best]; order[best] = i;
+
+      fprintf(stream, "%-24.24s ", order[n] < nfuncs
+	      ? sym_textsyms[order[n]]->name : "<unknown>");
+      myfprintf(stream, "%10n", best_total);
+      for (j=0; j < hp_NUM; j++)
+	myfprintf(stream, " %8n", fn[order[n]][j]);
+      fprintf(stream, "\n");
+    }
+
+  free(order);
+  free(fn);
+}
+
+#endif /* HOST_PROFILE */
@@ -0,0 +1,130 @@
+/* interval.h - parallel trace interval simulation interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "options.h"
+#include "stats.h"
+#include "sweep.h"
+
+/*
+ * The interval package splits the replay of an EIO trace into COUNT
+ * intervals of equal instruction counts and simulates them concurrently.
+ * Every interval but the first is measured by two worker runs that start
+ * from the same checkpoint embedded in the trace (see `-eio:start'), at
+ * least WARMUP instructions before the interval: one stops where the
+ * interval starts and the other where it ends.  Since both runs are
+ * deterministic, the counters of the second minus those of the first are
+ * exactly the interval's, measured with warm caches and predictors.
+ *
+ * The driver sums the scalar counters of all intervals into the simulator's
+ * own stats database, so formulas are computed over the stitched counters
+ * when it prints its statistics.  Distributions are not stitched.  If asked
+ * to check, the driver also runs the whole trace serially and writes the
+ * error of each stitched stat to `<prefix>.csv'.
+ */
+
+/* interval simulation definition */
+struct interval_t {
+  int count;			/* number of intervals */
+  counter_t length;		/* instructions in the trace */
+  counter_t warmup;		/* minimum warm-up before each interval */
+  int check;			/* also run the whole trace serially? */
+  counter_t *start;		/* first instruction of each interval */
+  struct sweep_t *runs;		/* worker runs */
+};
+
+/* create an interval simulation of COUNT intervals over the first LENGTH
+   instructions of a trace, each warmed up over at least WARMUP
+   instructions, with one more serial run if CHECK is set */
+struct interval_t *
+interval_new(int count,			/* number of intervals */
+	     counter_t length,		/* instructions in the trace */
+	     counter_t warmup,		/* minimum warm-up per interval */
+	     int check,			/* compare against a serial run? */
+	     char *prefix);		/* output file name prefix */
+
+/* launch all runs of interval simulation IV, at most NJOBS at once,
+   returns the run index in a worker, or -1 in the driver after all
+   workers have exited */
+int					/* run index, or -1 in driver */
+interval_launch(struct interval_t *iv,	/* interval simulation */
+		int njobs);		/* max concurrent runs, 0 = host CPUs */
+
+/* apply the start and stop options of run RUN to options database ODB */
+void
+interval_apply(struct interval_t *iv,	/* interval simulation */
+	       struct opt_odb_t *odb,	/* options database */
+	       int run);		/* run index */
+
+/* return the output file name of run RUN, with extension EXT */
+char *
+interval_fname(struct interval_t *iv,	/* interval simulation */
+	       int run,			/* run index */
+	       char *ext);		/* file name extension */
+
+/* stitch the counters of all interval runs into stats database SDB */
+void
+interval_stitch(struct interval_t *iv,	/* interval simulation */
+		struct stat_sdb_t *sdb);/* stats database */
+
+/* compare the stitched stats of SDB with those of the serial run, one row
+   per stat in `<prefix>.csv' */
+void
+interval_compare(struct interval_t *iv,	/* interval simulation */
+		 struct stat_sdb_t *sdb);/* stats database */
+
+#endif /* INTERVAL_H */
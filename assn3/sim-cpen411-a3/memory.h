@@ -64,11 +64,26 @@
 #define MEM_PTAB_SIZE		(32*1024)
 #define MEM_LOG_PTAB_SIZE	15
 
+/* host page shared by a memory space and its snapshots */
+struct mem_shared_t {
+  byte_t *page;			/* page pointer */
+  int refs;			/* page tables and snapshots holding it */
+};
+
 /* page table entry */
 struct mem_pte_t {
   struct mem_pte_t *next;	/* next translation in this bucket */
   md_addr_t tag;		/* virtual page number tag */
   byte_t *page;			/* page pointer */
+  struct mem_shared_t *shared;	/* copy-on-write page, NULL if private */
+};
+
+/* memory snapshot, the pages of a memory space at the time of the snapshot;
+   the pages are shared with the memory space until either side writes them */
+struct mem_snap_t {
+  int npages;			/* pages in the snapshot */
+  md_addr_t *addrs;		/* virtual address of each page */
+  struct mem_shared_t **pages;	/* host page of each page */
 };
 
 /* memory object */
@@ -81,6 +96,10 @@ struct mem_t {
   counter_t page_count;			/* total number of pages allocated */
   counter_t ptab_misses;		/* total first level page tbl misses */
   counter_t ptab_accesses;		/* total page table accesses */
+  counter_t snapshots;			/* total snapshots taken */
+  counter_t restores;			/* total snapshots restored */
+  counter_t cow_copies;			/* total pages copied on write */
+  counter_t mapped_pages;		/* total pages mapped from the host */
 };
 
 /* memory access command */
@@ -129,12 +148,17 @@ typedef enum md_fault_type
 /* compute address of access within a host page */
 #define MEM_OFFSET(ADDR)	((ADDR) & (MD_PAGE_SIZE - 1))
 
-/* memory tickle function, allocates pages when they are first written */
+/* memory tickle function, allocates pages when they are first written and
+   copies pages shared with a snapshot or mapped from the host before they
+   are written */
 #define MEM_TICKLE(MEM, ADDR)						\
   (!MEM_PAGE(MEM, ADDR)							\
    ? (/* allocate page at address ADDR */				\
       mem_newpage(MEM, ADDR))						\
-   : (/* nada... */ (void)0))
+   : ((MEM)->ptab[MEM_PTAB_SET(ADDR)]->shared				\
+      ? (/* copy shared page at address ADDR, MEM_PAGE() hit above */	\
+	 mem_cowpage(MEM, ADDR))					\
+      : (/* nada... */ (void)0)))
 
 /* memory page iterator */
 #define MEM_FORALL(MEM, ITER, PTE)					\
@@ -218,6 +242,37 @@ void
 mem_newpage(struct mem_t *mem,		/* memory space to allocate in */
 	    md_addr_t addr);		/* virtual address to allocate */
 
+/* give page at address ADDR its own copy if it is shared with a snapshot,
+   call only after a MEM_PAGE() hit on ADDR */
+void
+mem_cowpage(struct mem_t *mem,		/* memory space to access */
+	    md_addr_t addr);		/* virtual address to write */
+
+/* back the NBYTES of simulated memory at ADDR with host memory HOST, which
+   must stay valid and unchanged while the memory space exists; pages HOST
+   covers entirely are shared, and copied on their first write, the rest are
+   copied in now */
+void
+mem_map(struct mem_t *mem,		/* memory space to map into */
+	md_addr_t addr,			/* target address to map */
+	byte_t *host,			/* host memory to map */
+	int nbytes);			/* number of bytes to map */
+
+/* take a snapshot of memory space MEM; no pages are copied, each page is
+   shared until the next write to it */
+struct mem_snap_t *
+mem_snapshot(struct mem_t *mem);	/* memory space to snapshot */
+
+/* rewind memory space MEM to snapshot SNAP, which stays valid and can be
+   restored again; pages written since the snapshot are released */
+void
+mem_restore(struct mem_t *mem,		/* memory space to rewind */
+	    struct mem_snap_t *snap);	/* snapshot to restore */
+
+/* release snapshot SNAP */
+void
+mem_snap_free(struct mem_snap_t *snap);	/* snapshot to release */
+
 /* generic memory access function, it's safe because alignments and permissions
    are checked, handles any natural transfer sizes; note, faults out if nbytes
    is not a power-of-two or larger then MD_PAGE_SIZE */
@@ -253,6 +308,25 @@ mem_dump(struct mem_t *mem,		/* memory space to display */
  * to the memory system, pass mem_access() as the memory access function
  */
 
+/* copy NBYTES to/from simulated memory space a page at a time, returns any
+   faults encountered; unlike mem_access(), transfers may be any length and
+   alignment, reads of unallocated pages return zeros; the accessor routines
+   below use this path when they are passed mem_access() */
+enum md_fault_type
+mem_bulk_access(struct mem_t *mem,	/* memory space to access */
+		enum mem_cmd cmd,	/* Read (from sim mem) or Write */
+		md_addr_t addr,		/* target address to access */
+		void *vp,		/* host memory address to access */
+		int nbytes);		/* number of bytes to access */
+
+/* set NBYTES of simulated memory to C a page at a time, returns any faults
+   encountered; zeroing skips unallocated pages, they already read as zeros */
+enum md_fault_type
+mem_bulk_set(struct mem_t *mem,		/* memory space to access */
+	     md_addr_t addr,		/* target address to access */
+	     int c,			/* value to store in each byte */
+	     int nbytes);		/* number of bytes to set */
+
 /* copy a '\0' terminated string to/from simulated memory space, returns
    the number of bytes copied, returns any fault encountered */
 enum md_fault_type
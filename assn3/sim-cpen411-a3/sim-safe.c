@@ -64,16 +64,63 @@
 #include "syscall.h"
 #include "options.h"
 #include "stats.h"
+#include "refq.h"
+#include "hostprof.h"
+#include "sweep.h"
 #include "sim.h"
 
 
 
+#define  NUMBER_OF_ENTRIES      512
+#define	 BITS_FOR_ENTRY         9      // log2(NUMBER_OF_ENTRIES) 
+
+#define  HISTORY_TO_RETAIN 	18
+#define  STATES_PER_ENTRY       262144     // 2^HISTORY_TO_RETAIN
+
+#define  NUMBER_OF_ENTRIES_STANDARD  262144 // 32768 // 262144
+
+#define  RUN_I_THROUGH_IV            true   // set to false to run custom predictor
+
+
 static counter_t g_total_cond_branches      = 0;
-static counter_t g_total_mispredictions_i   = 0;
-static counter_t g_total_mispredictions_ii  = 0;
-static counter_t g_total_mispredictions_iii = 0;
-static counter_t g_total_mispredictions_iv  = 0;
-static counter_t g_total_mispredictions_v   = 0;
+
+// one set of predictors with their own tables and counters; a parameter
+// sweep feeds one such model per grid point from a single functional run
+struct bpred_model {
+  unsigned index_mask;          // PC index mask of predictors i-iv
+  int history_bits_v;           // history bits of predictor v
+
+  int *bpred_pht_i;
+  int *bpred_pht_ii;
+  int (*bpred_pht_iii)[2];
+  int last_outcome_iii;
+  int (*bpred_pht_iv)[16];
+  int branch_history_iv;
+  int *bpred_pht_v;             // NUMBER_OF_ENTRIES rows of 2^history_bits_v
+  int branch_history_v;
+
+  counter_t mispredictions_i;
+  counter_t mispredictions_ii;
+  counter_t mispredictions_iii;
+  counter_t mispredictions_iv;
+  counter_t mispredictions_v;
+};
+
+// predictor models fed by this run, and the one sim_reg_stats() reports
+static struct bpred_model models[REFQ_MAX_CONSUMERS];
+static int nmodels = 0;
+static struct bpred_model *model = &models[0];
+
+static void bpred_model_add(void);
+static void bpred_model_select(int inst);
+
+// options that configure the predictor models only, grid points that differ
+// only in these share one functional run; predictors i-iv are four
+// consumers per model
+static char *bpred_model_opts[] = { "-bpred:index", "-bpred:hist", NULL };
+static struct sweep_models_t bpred_models =
+  { bpred_model_opts, REFQ_MAX_CONSUMERS / (RUN_I_THROUGH_IV ? 4 : 1),
+    bpred_model_add, bpred_model_select };
 /*
 
  * This file implements a functional simulator.  This functional simulator is
@@ -94,6 +141,19 @@ static counter_t sim_num_refs = 0;
 /* maximum number of inst's to execute */
 static unsigned int max_insts;
 
+/* reference queue feeding the branch predictors */
+static struct refq_t *refq = NULL;
+
+/* reference queue size, in instructions */
+static unsigned int refq_size;
+
+/* run the branch predictors inline on the functional core? */
+static int refq_inline;
+
+/* PC bits indexing predictors i-iv, and history bits of predictor v */
+static int bpred_index_bits;
+static int bpred_history_bits;
+
 /* register simulator-specific options */
 	void
 sim_reg_options(struct opt_odb_t *odb)
@@ -111,13 +171,45 @@ sim_reg_options(struct opt_odb_t *odb)
 			&max_insts, /* default */0,
 			/* print */TRUE, /* format */NULL);
 
+	/* branch predictor reference queue */
+	opt_reg_uint(odb, "-refq:size",
+			"reference queue size, in instructions (power of two)",
+			&refq_size, /* default */4096,
+			/* print */TRUE, /* format */NULL);
+	opt_reg_flag(odb, "-refq:inline",
+			"run the branch predictors inline on the functional core "
+			"(faster on a single host CPU)",
+			&refq_inline, /* default */FALSE,
+			/* print */TRUE, /* format */NULL);
+
+	/* branch predictor models */
+	opt_reg_int(odb, "-bpred:index",
+			"PC bits indexing predictors i-iv",
+			&bpred_index_bits, /* default */15,
+			/* print */TRUE, /* format */NULL);
+	opt_reg_int(odb, "-bpred:hist",
+			"global history bits of predictor v",
+			&bpred_history_bits, /* default */HISTORY_TO_RETAIN,
+			/* print */TRUE, /* format */NULL);
+	sweep_reg_models(&bpred_models);
+}
+
+/* fatal if the predictor model options are out of range */
+	static void
+bpred_check_options(void)
+{
+	if (bpred_index_bits < 1 || (1 << bpred_index_bits) > NUMBER_OF_ENTRIES_STANDARD)
+		fatal("`-bpred:index' must be between 1 and %d",
+				log_base2(NUMBER_OF_ENTRIES_STANDARD));
+	if (bpred_history_bits < 1 || (1 << bpred_history_bits) > STATES_PER_ENTRY)
+		fatal("`-bpred:hist' must be between 1 and %d", HISTORY_TO_RETAIN);
 }
 
 /* check simulator-specific option values */
 	void
 sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 {
-	/* nada */
+	bpred_check_options();
 }
 
 /* register simulator-specific statistics */
@@ -138,7 +230,7 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 
 	stat_reg_counter(sdb, "sim_num_mispredict_i",
 			"total number of mispredictions_i",
-			&g_total_mispredictions_i, g_total_mispredictions_i, NULL);
+			&model->mispredictions_i, model->mispredictions_i, NULL);
 
 	stat_reg_formula(sdb, "sim_pred_accuracy_i",
 			"branch prediction accuracy i",
@@ -147,7 +239,7 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 
 	stat_reg_counter(sdb, "sim_num_mispredict_ii",
 			"total number of mispredictions_ii",
-			&g_total_mispredictions_ii, g_total_mispredictions_ii, NULL);
+			&model->mispredictions_ii, model->mispredictions_ii, NULL);
 
 	stat_reg_formula(sdb, "sim_pred_accuracy_ii",
 			"branch prediction accuracy ii",
@@ -156,7 +248,7 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 
 	stat_reg_counter(sdb, "sim_num_mispredict_iii",
 			"total number of mispredictions_iii",
-			&g_total_mispredictions_iii, g_total_mispredictions_iii, NULL);
+			&model->mispredictions_iii, model->mispredictions_iii, NULL);
 
 	stat_reg_formula(sdb, "sim_pred_accuracy_iii",
 			"branch prediction accuracy iii",
@@ -166,7 +258,7 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 
 	stat_reg_counter(sdb, "sim_num_mispredict_iv",
 			"total number of mispredictions_iv",
-			&g_total_mispredictions_iv, g_total_mispredictions_iv, NULL);
+			&model->mispredictions_iv, model->mispredictions_iv, NULL);
 
 	stat_reg_formula(sdb, "sim_pred_accuracy_iv",
 			"branch prediction accuracy iv",
@@ -176,7 +268,7 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 
 	stat_reg_counter(sdb, "sim_num_mispredict_v",
 			"total number of mispredictions_v",
-			&g_total_mispredictions_v, g_total_mispredictions_v, NULL);
+			&model->mispredictions_v, model->mispredictions_v, NULL);
 
 	stat_reg_formula(sdb, "sim_pred_accuracy_v",
 			"branch prediction accuracy v",
@@ -189,9 +281,10 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 
 	stat_reg_formula(sdb, "sim_inst_rate",
 			"simulation speed (in insts/sec)",
-			"sim_num_insn / sim_elapsed_time", NULL);
+			"(sim_num_insn - sim_insn_base) / sim_elapsed_time", NULL);
 	ld_reg_stats(sdb);
 	mem_reg_stats(mem, sdb);
+	refq_reg_stats(refq, sdb, "refq");
 }
 
 /* initialize the simulator */
@@ -203,9 +296,15 @@ sim_init(void)
 	/* allocate and initialize register file */
 	regs_init(&regs);
 
+	/* the host profiler samples the PC of the instruction being simulated */
+	HOSTPROF_GUEST_PC(&regs.regs_PC);
+
 	/* allocate and initialize memory space */
 	mem = mem_create("mem");
 	mem_init(mem);
+
+	/* the predictors run behind the functional core */
+	refq = refq_create(refq_size, /* threaded */!refq_inline);
 }
 
 /* load program into simulated state */
@@ -338,19 +437,184 @@ sim_uninit(void)
 #define DTMP            (3+32+32)
 
 
-#define  NUMBER_OF_ENTRIES      512
-#define	 BITS_FOR_ENTRY         9      // log2(NUMBER_OF_ENTRIES) 
 
-#define  HISTORY_TO_RETAIN 	18
-#define  STATES_PER_ENTRY       262144     // 2^HISTORY_TO_RETAIN
 
-#define  NUMBER_OF_ENTRIES_STANDARD  262144 // 32768 // 262144
+// every predictor below is a reference queue consumer with its own state,
+// so each one can run on its own thread behind the functional core
 
-#define  RUN_I_THROUGH_IV            true   // set to false to run custom predictor
+// index into the standard predictor tables of model M
+#define  BPRED_INDEX(M, PC)          (((PC) >> 3) & (M)->index_mask)
+
+
+// i) 1-bit predictor
+static void bpred_i(struct refq_rec_t *rec, void *arg)
+{
+  struct bpred_model *m = (struct bpred_model *) arg;
+
+  if (!(MD_OP_FLAGS(rec->op) & F_COND)) return;
+
+  int actual_outcome = rec->taken;
+  unsigned index = BPRED_INDEX(m, rec->pc);
+  assert( index <= m->index_mask );
+
+  int prediction_i = m->bpred_pht_i[index];
+  if(prediction_i != actual_outcome) m->mispredictions_i++;
+  m->bpred_pht_i[index] = actual_outcome;
+}
+
+// ii) 2-bit saturating counter
+static void bpred_ii(struct refq_rec_t *rec, void *arg)
+{
+  struct bpred_model *m = (struct bpred_model *) arg;
+
+  if (!(MD_OP_FLAGS(rec->op) & F_COND)) return;
+
+  int branch_taken = (rec->taken == 1);
+  unsigned index = BPRED_INDEX(m, rec->pc);
+  assert( index <= m->index_mask );
+
+  int prediction_state_ii = m->bpred_pht_ii[index];
+  bool predicted_taken_ii = (prediction_state_ii >= 2);
+
+  if ((branch_taken && !predicted_taken_ii) || (!branch_taken && predicted_taken_ii)) 
+	m->mispredictions_ii++;	
+
+  if (branch_taken && prediction_state_ii < 3)
+	m->bpred_pht_ii[index] += 1;
+
+  else if (!branch_taken && prediction_state_ii > 0)
+	m->bpred_pht_ii[index] -= 1;
+}
+
+// iii) 1-bit predictor with 1-bit of history
+static void bpred_iii(struct refq_rec_t *rec, void *arg)
+{
+  struct bpred_model *m = (struct bpred_model *) arg;
+
+  if (!(MD_OP_FLAGS(rec->op) & F_COND)) return;
+
+  int actual_outcome = rec->taken;
+  int branch_taken = (actual_outcome == 1);
+  unsigned index = BPRED_INDEX(m, rec->pc);
+  assert( index <= m->index_mask );
+
+  int prediction_iii = m->bpred_pht_iii[index][m->last_outcome_iii];
+  bool predicted_taken_iii = (prediction_iii == 1);
+
+  if ((branch_taken && !predicted_taken_iii) || (!branch_taken && predicted_taken_iii))
+        m->mispredictions_iii++; 
+
+  m->bpred_pht_iii[index][m->last_outcome_iii] = actual_outcome;
+  m->last_outcome_iii = actual_outcome;
+}
 
+// iv) 2-bit saturating counter with 4 bits of history
+static void bpred_iv(struct refq_rec_t *rec, void *arg)
+{
+  struct bpred_model *m = (struct bpred_model *) arg;
+
+  if (!(MD_OP_FLAGS(rec->op) & F_COND)) return;
+
+  int actual_outcome = rec->taken;
+  int branch_taken = (actual_outcome == 1);
+  unsigned index = BPRED_INDEX(m, rec->pc);
+  assert( index <= m->index_mask );
+
+  int prediction_state_iv = m->bpred_pht_iv[index][m->branch_history_iv];
+  bool predicted_taken_iv = (prediction_state_iv >= 2);
+
+  if ((branch_taken && !predicted_taken_iv) || (!branch_taken && predicted_taken_iv)) 
+	m->mispredictions_iv++;
+
+  if (branch_taken && prediction_state_iv < 3)  
+	m->bpred_pht_iv[index][m->branch_history_iv] += 1;
+
+  else if (!branch_taken && prediction_state_iv > 0)  
+	m->bpred_pht_iv[index][m->branch_history_iv] -= 1;
+ 
+  // shift in a bit from the right	
+  m->branch_history_iv = (m->branch_history_iv << 1) & 15; 
+  // and 15 (...00001111) to only keep last 4 bits of history 
+
+  if (actual_outcome == 1) m->branch_history_iv = m->branch_history_iv | 1; 
+  // then if last_outcome is a 1, turn the shifted bit into a 1, otherwise leave it as a zero/
+}
+
+// v) 2-bit saturating counter with X bits of history
+static void bpred_v(struct refq_rec_t *rec, void *arg)
+{
+  struct bpred_model *m = (struct bpred_model *) arg;
+
+  if (!(MD_OP_FLAGS(rec->op) & F_COND)) return;
+
+  int actual_outcome = rec->taken;
+  int branch_taken = (actual_outcome == 1);
+  unsigned index_v = (rec->pc >> 3) & ( (1<<BITS_FOR_ENTRY) - 1);
+  assert (index_v < NUMBER_OF_ENTRIES );
+
+  int *entry_v = &m->bpred_pht_v[((size_t)index_v << m->history_bits_v) + m->branch_history_v];
+  int prediction_state_v = *entry_v;
+  bool predicted_taken_v = (prediction_state_v >= 2);
 
-static int bpred_pht_v[NUMBER_OF_ENTRIES][STATES_PER_ENTRY];
-int branch_history_v = 0;
+  if ((branch_taken && !predicted_taken_v) || (!branch_taken && predicted_taken_v))
+        m->mispredictions_v++;
+
+  // saturating counter
+  if (branch_taken && prediction_state_v < 3)
+        *entry_v += 1;
+
+  else if (!branch_taken && prediction_state_v > 0)
+        *entry_v -= 1;
+
+  // update history
+  m->branch_history_v = (m->branch_history_v << 1) & ((1 << m->history_bits_v) - 1); 
+  // and 15 (...00001111) to only keep last 4 bits of history
+
+  if (actual_outcome == 1) m->branch_history_v = m->branch_history_v | 1; 
+  // then if last_outcome is a 1, turn the shifted bit into a 1, otherwise leave it as a zero
+}
+
+// attach one more predictor model, configured from the current option values
+static void bpred_model_add(void)
+{
+  struct bpred_model *m;
+  size_t entries;
+
+  if (nmodels == bpred_models.max)
+    fatal("too many predictor models, maximum is %d", bpred_models.max);
+  bpred_check_options();
+  m = &models[nmodels++];
+
+  if( RUN_I_THROUGH_IV ){
+    entries = (size_t)1 << bpred_index_bits;
+    m->index_mask = entries - 1;
+    m->bpred_pht_i = (int *) calloc(entries, sizeof(int));
+    m->bpred_pht_ii = (int *) calloc(entries, sizeof(int));
+    m->bpred_pht_iii = (int (*)[2]) calloc(entries, sizeof(int [2]));
+    m->bpred_pht_iv = (int (*)[16]) calloc(entries, sizeof(int [16]));
+    if (!m->bpred_pht_i || !m->bpred_pht_ii || !m->bpred_pht_iii || !m->bpred_pht_iv)
+      fatal("out of virtual memory");
+
+    refq_add_consumer(refq, "bpred_i", bpred_i, m);
+    refq_add_consumer(refq, "bpred_ii", bpred_ii, m);
+    refq_add_consumer(refq, "bpred_iii", bpred_iii, m);
+    refq_add_consumer(refq, "bpred_iv", bpred_iv, m);
+  }
+  else {
+    m->history_bits_v = bpred_history_bits;
+    m->bpred_pht_v = (int *) calloc((size_t)NUMBER_OF_ENTRIES << bpred_history_bits, sizeof(int));
+    if (!m->bpred_pht_v)
+      fatal("out of virtual memory");
+
+    refq_add_consumer(refq, "bpred_v", bpred_v, m);
+  }
+}
+
+// make predictor model INST the one sim_reg_stats() reports
+static void bpred_model_select(int inst)
+{
+  model = &models[inst];
+}
 
 
 void sim_main(void)
@@ -360,17 +624,13 @@ void sim_main(void)
   enum md_opcode op;
   register int is_write;
   enum md_fault_type fault;
+  int i1, i2, i3, o1, o2;
+  struct refq_rec_t *rec;
 
 
-  static int bpred_pht_i[NUMBER_OF_ENTRIES_STANDARD];
-
-  static int bpred_pht_ii[NUMBER_OF_ENTRIES_STANDARD];
-
-  static int bpred_pht_iii[NUMBER_OF_ENTRIES_STANDARD][2];
-  int last_outcome_iii = 0;
-
-  static int bpred_pht_iv[NUMBER_OF_ENTRIES_STANDARD][16];
-  int branch_history_iv = 0;
+  // a parameter sweep may have attached its models already
+  if (nmodels == 0)
+    bpred_model_add();
 
 
   fprintf(stderr, "sim: ** starting functional simulation **\n");
@@ -381,6 +641,8 @@ void sim_main(void)
 
   while (TRUE)
     {
+      HOSTPROF_INSN(hp_decode);
+
       /* maintain $r0 semantics */
       regs.regs_R[MD_REG_ZERO] = 0;
 #ifdef TARGET_ALPHA
@@ -403,10 +665,12 @@ void sim_main(void)
       MD_SET_OPCODE(op, inst);
 
       /* execute the instruction */
+      HOSTPROF_SWITCH(hp_exec);
       switch (op)
 	{
 #define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)	\
 	case OP:						\
+          i1 = I1; i2 = I2; i3 = I3; o1 = O1; o2 = O2;		\
           SYMCAT(OP,_IMPL);					\
           break;					
 #define DEFLINK(OP,MSK,NAME,MASK,SHIFT)				\
@@ -442,105 +706,24 @@ void sim_main(void)
 	}
 
 
+      // the predictors only look at conditional branches, so only
+      // those are handed to them
       if (MD_OP_FLAGS(op) & F_COND)
-      {
-        g_total_cond_branches++;
-
-	int actual_outcome = (regs.regs_NPC != (regs.regs_PC + sizeof(md_inst_t)));
-        int branch_taken   = (actual_outcome == 1);
-
-	if( RUN_I_THROUGH_IV ){ 
-
-          unsigned index = (regs.regs_PC >> 3) & ( (1 << 15) - 1);
-          assert( index < NUMBER_OF_ENTRIES_STANDARD );	
-  
-
-          // i) 1-bit predictor
-	  int prediction_i = bpred_pht_i[index];
-          if(prediction_i != actual_outcome) g_total_mispredictions_i++;
-          bpred_pht_i[index] = actual_outcome;
-        
-
-	  // ii) 2-bit saturating counter
-	  int prediction_state_ii = bpred_pht_ii[index];
-	  bool predicted_taken_ii = (prediction_state_ii >= 2);
-
-	  if ((branch_taken && !predicted_taken_ii) || (!branch_taken && predicted_taken_ii)) 
-		g_total_mispredictions_ii++;	
-
-	
-	  if (branch_taken && prediction_state_ii < 3)
-		bpred_pht_ii[index] += 1;
-
-	  else if (!branch_taken && prediction_state_ii > 0)
-		bpred_pht_ii[index] -= 1;
-
-	
-          // iii) 1-bit predictor with 1-bit of history
-          int prediction_iii = bpred_pht_iii[index][last_outcome_iii];
-          bool predicted_taken_iii = (prediction_iii == 1);
-
-          if ((branch_taken && !predicted_taken_iii) || (!branch_taken && predicted_taken_iii))
-                g_total_mispredictions_iii++; 
-
-	  bpred_pht_iii[index][last_outcome_iii] = actual_outcome;
-          last_outcome_iii = actual_outcome;
-
-
-	  // iv) 2-bit saturating counter with 4 bits of history
-	  int prediction_state_iv = bpred_pht_iv[index][branch_history_iv];
-	  bool predicted_taken_iv = (prediction_state_iv >= 2);
-	
-          if ((branch_taken && !predicted_taken_iv) || (!branch_taken && predicted_taken_iv)) 
-		g_total_mispredictions_iv++;
- 
-
-          if (branch_taken && prediction_state_iv < 3)  
-		bpred_pht_iv[index][branch_history_iv] += 1;
-
-          else if (!branch_taken && prediction_state_iv > 0)  
-		bpred_pht_iv[index][branch_history_iv] -= 1;
-         
-	  // shift in a bit from the right	
-	  branch_history_iv = (branch_history_iv << 1) & 15; 
-	  // and 15 (...00001111) to only keep last 4 bits of history 
-	
-	  if (actual_outcome == 1) branch_history_iv = branch_history_iv | 1; 
-	  // then if last_outcome is a 1, turn the shifted bit into a 1, otherwise leave it as a zero/
-
-	}
-	else 
         {
-          // v) 2-bit saturating counter with X bits of history
-	  unsigned index_v = (regs.regs_PC >> 3) & ( (1<<BITS_FOR_ENTRY) - 1);
-	  assert (index_v < NUMBER_OF_ENTRIES );
-
-
-          int prediction_state_v = bpred_pht_v[index_v][branch_history_v];
-          bool predicted_taken_v = (prediction_state_v >= 2);
-
-          if ((branch_taken && !predicted_taken_v) || (!branch_taken && predicted_taken_v))
-                g_total_mispredictions_v++;
-
-	  // saturating counter
-          if (branch_taken && prediction_state_v < 3)
-                bpred_pht_v[index_v][branch_history_v] += 1;
-
-          else if (!branch_taken && prediction_state_v > 0)
-                bpred_pht_v[index_v][branch_history_v] -= 1;
-
-	  // update history
-          branch_history_v = (branch_history_v << 1) & (int)(pow(2, HISTORY_TO_RETAIN) - 1); 
-	  // and 15 (...00001111) to only keep last 4 bits of history
-        
-	  if (actual_outcome == 1) branch_history_v = branch_history_v | 1; 
-	  // then if last_outcome is a 1, turn the shifted bit into a 1, otherwise leave it as a zero
-	
-	}
-      }
-
-  
-     
+          g_total_cond_branches++;
+
+          HOSTPROF_SWITCH(hp_timing);
+          rec = refq_alloc(refq);
+          rec->icnt    = sim_num_insn;
+          rec->pc      = regs.regs_PC;
+          rec->next_pc = regs.regs_NPC;
+          rec->addr    = addr;
+          rec->op      = op;
+          rec->in[0]   = i1; rec->in[1] = i2; rec->in[2] = i3;
+          rec->out[0]  = o1; rec->out[1] = o2;
+          rec->taken   = (regs.regs_NPC != (regs.regs_PC + sizeof(md_inst_t)));
+          refq_publish(refq);
+        }
 
 
       /* go to the next instruction */
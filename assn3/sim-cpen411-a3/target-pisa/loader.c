@@ -66,6 +66,11 @@
 #include <bfd.h>
 #else /* !BFD_LOADER */
 #include "target-pisa/ecoff.h"
+#ifndef _MSC_VER
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif /* !_MSC_VER */
 #endif /* BFD_LOADER */
 
 /* amount of tail padding added to all loaded text segments */
@@ -146,6 +151,86 @@ ld_reg_stats(struct stat_sdb_t *sdb)	/* stats data base */
 }
 
 
+#ifndef BFD_LOADER
+
+/* map executable FOBJ read-only into host memory, returns NULL if it cannot
+   be mapped, else the image and its size in *SIZE; the mapping is kept for
+   the whole run, as its pages back simulated memory */
+static byte_t *
+ld_map_exec(FILE *fobj,			/* executable file */
+	    size_t *size)		/* size of the image */
+{
+#ifndef _MSC_VER
+  struct stat sbuf;
+  void *image;
+
+  if (fstat(fileno(fobj), &sbuf) < 0 || sbuf.st_size <= 0)
+    return NULL;
+
+  image = mmap(NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE, fileno(fobj), 0);
+  if (image == MAP_FAILED)
+    return NULL;
+
+  *size = sbuf.st_size;
+  return image;
+#else /* _MSC_VER */
+  return NULL;
+#endif /* !_MSC_VER */
+}
+
+/* load section SHDR of executable FOBJ into simulated memory; with an
+   executable IMAGE of SIZE bytes its pages are mapped in place, else the
+   section is read and copied */
+static void
+ld_load_scn(FILE *fobj,			/* executable file */
+	    byte_t *image,		/* mapped executable, or NULL */
+	    size_t size,		/* size of the mapped executable */
+	    struct ecoff_scnhdr *shdr,	/* section to load */
+	    struct mem_t *mem)		/* memory space to load into */
+{
+  char *p;
+
+  if (image && (size_t)shdr->s_scnptr + shdr->s_size <= size)
+    {
+      /* section pages are shared with the image until written */
+      mem_map(mem, shdr->s_vaddr, image + shdr->s_scnptr, shdr->s_size);
+      return;
+    }
+
+  p = calloc(shdr->s_size, sizeof(char));
+  if (!p)
+    fatal("out of virtual memory");
+
+  if (fseek(fobj, shdr->s_scnptr, 0) == -1)
+    fatal("could not read section at 0x%08x from executable",
+	  shdr->s_vaddr);
+  if (fread(p, shdr->s_size, 1, fobj) < 1)
+    fatal("could not read section at 0x%08x from executable",
+	  shdr->s_vaddr);
+
+  /* copy program section into simulator target memory */
+  mem_bcopy(mem_access, mem, Write, shdr->s_vaddr, p, shdr->s_size);
+
+  /* release the section buffer */
+  free(p);
+}
+
+#endif /* !BFD_LOADER */
+
+/* start recording an EIO trace of the program just loaded, if requested,
+   it begins with a checkpoint of the initial state */
+static void
+ld_start_trace(struct regs_t *regs,	/* initial registers */
+	       struct mem_t *mem)	/* initial memory */
+{
+  if (sim_trace_fname == NULL)
+    return;
+
+  fprintf(stderr, "sim: recording EIO trace: %s\n", sim_trace_fname);
+  sim_trace_fd = eio_create(sim_trace_fname);
+  eio_write_chkpt(regs, mem, sim_trace_fd);
+}
+
 /* load program text and initialized data into simulated virtual memory
    space and initialize program segment range variables */
 void
@@ -179,6 +264,28 @@ ld_load_prog(char *fname,		/* program to load */
       if (eio_read_chkpt(regs, mem, sim_eio_fd) != -1)
 	fatal("bad initial checkpoint in EIO file");
 
+      if ((sim_chkpt_fname != NULL || sim_eio_start != 0)
+	  && sim_trace_fname != NULL)
+	fatal("cannot record an EIO trace from a restored checkpoint");
+
+      /* start from an embedded checkpoint? */
+      if (sim_eio_start != 0)
+	{
+	  counter_t restore_icnt;
+
+	  if (sim_chkpt_fname != NULL)
+	    fatal("`-eio:start' and `-chkpt' cannot be used together");
+
+	  restore_icnt = eio_seek(sim_eio_fd, (counter_t)sim_eio_start,
+				  regs, mem);
+	  if (restore_icnt == -1)
+	    warn("no EIO checkpoint at or before instruction %u, "
+		 "starting from the beginning", sim_eio_start);
+	  else
+	    myfprintf(stderr, "sim: restored EIO checkpoint at instruction %n\n",
+		      restore_icnt);
+	}
+
       /* load checkpoint? */
       if (sim_chkpt_fname != NULL)
 	{
@@ -205,10 +312,16 @@ ld_load_prog(char *fname,		/* program to load */
 	  eio_fast_forward(sim_eio_fd, restore_icnt);
 	}
 
+      /* restored checkpoints set the instruction count, count from there */
+      sim_insn_base = sim_num_insn;
+
       /* computed state... */
       ld_environ_base = regs->regs_R[MD_REG_SP];
       ld_prog_entry = regs->regs_PC;
 
+      /* re-record the trace, e.g., to embed checkpoints in it */
+      ld_start_trace(regs, mem);
+
       /* fini... */
       return;
     }
@@ -296,7 +409,8 @@ ld_load_prog(char *fname,		/* program to load */
 	    /* release the section buffer */
 	    free(p);
 	  }
-	/* zero out the section if it is loadable but not allocated in exec */
+	/* zero out the section if it is loadable but not allocated in exec,
+	   this only touches pages the other sections already allocated */
 	else if (zero_bss_segs
 		 && (bfd_get_section_flags(abfd, sect) & SEC_LOAD)
 		 && bfd_section_vma(abfd, sect)
@@ -367,6 +481,8 @@ ld_load_prog(char *fname,		/* program to load */
   {
     FILE *fobj;
     long floc;
+    byte_t *image;
+    size_t image_size = 0;
     struct ecoff_filehdr fhdr;
     struct ecoff_aouthdr ahdr;
     struct ecoff_scnhdr shdr;
@@ -395,6 +511,9 @@ ld_load_prog(char *fname,		/* program to load */
     if (fread(&fhdr, sizeof(struct ecoff_filehdr), 1, fobj) < 1)
       fatal("cannot read header from executable `%s'", argv[0]);
 
+    /* read-only sections are mapped straight from the executable */
+    image = ld_map_exec(fobj, &image_size);
+
     /* record endian of target */
     if (fhdr.f_magic == ECOFF_EB_MAGIC)
       ld_target_big_endian = TRUE;
@@ -433,8 +552,6 @@ ld_load_prog(char *fname,		/* program to load */
     floc = ftell(fobj);
     for (i = 0; i < fhdr.f_nscns; i++)
       {
-	char *p;
-
 	if (fseek(fobj, floc, 0) == -1)
 	  fatal("could not reset location in executable");
 	if (fread(&shdr, sizeof(struct ecoff_scnhdr), 1, fobj) < 1)
@@ -447,24 +564,13 @@ ld_load_prog(char *fname,		/* program to load */
 	    ld_text_size = ((shdr.s_vaddr + shdr.s_size) - MD_TEXT_BASE) 
 	      + TEXT_TAIL_PADDING;
 
-	    p = calloc(shdr.s_size, sizeof(char));
-	    if (!p)
-	      fatal("out of virtual memory");
-
-	    if (fseek(fobj, shdr.s_scnptr, 0) == -1)
-	      fatal("could not read `.text' from executable", i);
-	    if (fread(p, shdr.s_size, 1, fobj) < 1)
-	      fatal("could not read text section from executable");
-
-	    /* copy program section into simulator target memory */
-	    mem_bcopy(mem_access, mem, Write, shdr.s_vaddr, p, shdr.s_size);
+	    /* load program section into simulator target memory, it is
+	       predecoded in place, which would copy every mapped page */
+	    ld_load_scn(fobj, NULL, 0, &shdr, mem);
 
 	    /* create tail padding and copy into simulator target memory */
 	    mem_bzero(mem_access, mem,
 		      shdr.s_vaddr + shdr.s_size, TEXT_TAIL_PADDING);
-  
-	    /* release the section buffer */
-	    free(p);
 
 #if 0
 	    Text_seek = shdr.s_scnptr;
@@ -486,7 +592,11 @@ ld_load_prog(char *fname,		/* program to load */
 	    Rdata_size = shdr.s_size;
 	    Rdata_seek = shdr.s_scnptr;
 #endif
-	    /* fall through */
+
+	    /* never predecoded, so map it from the image */
+	    ld_load_scn(fobj, image, image_size, &shdr, mem);
+	    break;
+
 	  case ECOFF_STYP_DATA:
 #if 0
 	    Data_seek = shdr.s_scnptr;
@@ -497,27 +607,15 @@ ld_load_prog(char *fname,		/* program to load */
 	    Sdata_seek = shdr.s_scnptr;
 #endif
 
-	    p = calloc(shdr.s_size, sizeof(char));
-	    if (!p)
-	      fatal("out of virtual memory");
-
-	    if (fseek(fobj, shdr.s_scnptr, 0) == -1)
-	      fatal("could not read `.text' from executable", i);
-	    if (fread(p, shdr.s_size, 1, fobj) < 1)
-	      fatal("could not read text section from executable");
-
-	    /* copy program section it into simulator target memory */
-	    mem_bcopy(mem_access, mem, Write, shdr.s_vaddr, p, shdr.s_size);
-
-	    /* release the section buffer */
-	    free(p);
-
+	    /* map it from the image too, pages the program writes get their
+	       own copy then, the rest stay shared with the image */
+	    ld_load_scn(fobj, image, image_size, &shdr, mem);
 	    break;
 
 	  case ECOFF_STYP_BSS:
-	    break;
-
+	    /* fall through */
 	  case ECOFF_STYP_SBSS:
+	    /* unallocated pages read as zeros, nothing to load */
 	    break;
 	  }
       }
@@ -643,8 +741,7 @@ ld_load_prog(char *fname,		/* program to load */
   /* finally, predecode the text segment... */
   {
     md_addr_t addr;
-    md_inst_t inst;
-    enum md_fault_type fault;
+    md_inst_t *inst;
 
     if (OP_MAX > 255)
       fatal("cannot perform fast decoding, too many opcodes");
@@ -654,13 +751,13 @@ ld_load_prog(char *fname,		/* program to load */
 	 addr < (ld_text_base+ld_text_size);
 	 addr += sizeof(md_inst_t))
       {
-	fault = mem_access(mem, Read, addr, &inst, sizeof(inst));
-	if (fault != md_fault_none)
-	  fatal("could not read instruction memory");
-	inst.a = (inst.a & ~0xff) | (word_t)MD_OP_ENUM(MD_OPFIELD(inst));
-	fault = mem_access(mem, Write, addr, &inst, sizeof(inst));
-	if (fault != md_fault_none)
-	  fatal("could not write instruction memory");
+	/* instructions never straddle a page, decode in the host page */
+	MEM_TICKLE(mem, addr);
+	inst = (md_inst_t *)(MEM_PAGE(mem, addr) + MEM_OFFSET(addr));
+	inst->a = (inst->a & ~0xff) | (word_t)MD_OP_ENUM(MD_OPFIELD((*inst)));
       }
   }
+
+  /* the trace starts from the loaded program */
+  ld_start_trace(regs, mem);
 }
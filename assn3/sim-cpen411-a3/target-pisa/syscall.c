@@ -51,6 +51,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "host.h"
 #include "misc.h"
 #include "machine.h"
@@ -61,6 +62,8 @@
 #include "endian.h"
 #include "eio.h"
 #include "syscall.h"
+#include "vfs.h"
+#include "hostprof.h"
 
 /* live execution only support on same-endian hosts... */
 #ifndef MD_CROSS_ENDIAN
@@ -592,22 +595,299 @@ struct {
 };
 #define SS_NFLAGS	(sizeof(ss_flag_table)/sizeof(ss_flag_table[0]))
 
+#ifndef _MSC_VER
+/*
+ * zero-copy I/O, when the system call is handed the plain mem_access()
+ * accessor the host I/O vectors point straight at the host pages that back
+ * simulated memory, so a single readv()/writev() moves the data; a tracing
+ * accessor (e.g., EIO) still gets the buffered copies so it sees each byte
+ */
+
+/* host I/O vectors per readv()/writev(), each covers at most one page */
+#define SYS_MAX_IOV		256
+
+/* stands in for unallocated pages on output, they read as zeros */
+static byte_t sys_zero_page[MD_PAGE_SIZE];
+
+/* point up to MAXIOV host I/O vectors at the NBYTES of simulated memory at
+   ADDR; with ALLOC unallocated pages are allocated (input), otherwise they
+   read as zeros (output); returns the number of vectors built, and the
+   bytes they cover in *NCOVERED */
+static int
+sys_mem_iov(struct mem_t *mem,		/* memory space to access */
+	    md_addr_t addr,		/* target address to access */
+	    size_t nbytes,		/* number of bytes to access */
+	    int alloc,			/* allocate unallocated pages? */
+	    struct iovec *iov,		/* host I/O vectors to fill */
+	    int maxiov,			/* host I/O vectors available */
+	    size_t *ncovered)		/* bytes covered by the vectors */
+{
+  int niov = 0;
+  size_t count;
+  byte_t *page;
+
+  *ncovered = 0;
+  while (nbytes > 0 && niov < maxiov)
+    {
+      /* up to the end of this page */
+      count = MIN(nbytes, (size_t)(MD_PAGE_SIZE - MEM_OFFSET(addr)));
+
+      if (alloc)
+	MEM_TICKLE(mem, addr);
+      page = MEM_PAGE(mem, addr);
+
+      iov[niov].iov_base = page ? page + MEM_OFFSET(addr) : sys_zero_page;
+      iov[niov].iov_len = count;
+      niov++;
+
+      addr += count;
+      nbytes -= count;
+      *ncovered += count;
+    }
+  return niov;
+}
+
+/* read up to NBYTES from FD straight into simulated memory at ADDR, returns
+   the number of bytes read, or -1 on an error */
+static ssize_t
+sys_read_mem(int fd,			/* host file descriptor */
+	     struct mem_t *mem,		/* memory space to access */
+	     md_addr_t addr,		/* target address to access */
+	     size_t nbytes)		/* number of bytes to read */
+{
+  struct iovec iov[SYS_MAX_IOV];
+  struct stat sbuf;
+  ssize_t n, total = 0;
+  size_t covered;
+  int niov, regular;
+
+  /* only keep reading past a full vector set on regular files, a pipe or
+     terminal would block where a single read() returns */
+  regular = (fstat(fd, &sbuf) == 0 && S_ISREG(sbuf.st_mode));
+
+  do {
+    niov = sys_mem_iov(mem, addr, nbytes, /* alloc */TRUE,
+		       iov, SYS_MAX_IOV, &covered);
+    n = readv(fd, iov, niov);
+    if (n < 0)
+      return total ? total : -1;
+
+    total += n;
+    addr += n;
+    nbytes -= n;
+  } while (regular && n == (ssize_t)covered && nbytes > 0);
+
+  return total;
+}
+
+/* write NBYTES of simulated memory at ADDR to FD, or to STREAM if it is
+   non-NULL, straight from the simulated memory pages; returns the number of
+   bytes written, or -1 on an error */
+static ssize_t
+sys_write_mem(int fd,			/* host file descriptor */
+	      FILE *stream,		/* host stream, overrides FD */
+	      struct mem_t *mem,	/* memory space to access */
+	      md_addr_t addr,		/* target address to access */
+	      size_t nbytes)		/* number of bytes to write */
+{
+  struct iovec iov[SYS_MAX_IOV];
+  ssize_t n, total = 0;
+  size_t covered;
+  int i, niov;
+
+  while (nbytes > 0)
+    {
+      niov = sys_mem_iov(mem, addr, nbytes, /* alloc */FALSE,
+			 iov, SYS_MAX_IOV, &covered);
+      if (stream)
+	{
+	  for (i = 0, n = 0; i < niov; i++)
+	    n += fwrite(iov[i].iov_base, 1, iov[i].iov_len, stream);
+	}
+      else
+	{
+	  n = writev(fd, iov, niov);
+	  if (n < 0)
+	    return total ? total : -1;
+	}
+
+      total += n;
+      if (n != (ssize_t)covered)
+	break;
+      addr += n;
+      nbytes -= n;
+    }
+
+  return total;
+}
+#endif /* !_MSC_VER */
+
 #endif /* !MD_CROSS_ENDIAN */
 
 
+/*
+ * buffered simulated program output, small writes to stdout/stderr are
+ * collected and handed to the host (sim_progfd, or the host fd) in one go;
+ * a single buffer is shared by both streams so they stay in program order
+ */
+
+/* output buffer, NULL if writes go straight through */
+static char *sys_outbuf = NULL;
+
+/* output buffer size and fill, in bytes */
+static int sys_outbuf_size = 0;
+static int sys_outbuf_len = 0;
+
+/* target stream of the buffered output */
+static int sys_outbuf_fd = 1;
+
+/* output stats */
+static counter_t sys_output_writes = 0;	/* program writes to stdout/stderr */
+static counter_t sys_output_hostwrites = 0;/* host writes issued for them */
+
+/* write NBYTES in BUF to target stream FD on the host */
+static void
+sys_host_output(int fd, char *buf, int nbytes)
+{
+  int n;
+
+  sys_output_hostwrites++;
+  if (sim_progfd)
+    {
+      /* redirect program output to file */
+      fwrite(buf, 1, nbytes, sim_progfd);
+      return;
+    }
+
+  /* write the output to stdout/stderr */
+  while (nbytes > 0)
+    {
+      n = write(fd, buf, nbytes);
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  warn("lost %d bytes of program output", nbytes);
+	  return;
+	}
+      buf += n;
+      nbytes -= n;
+    }
+}
+
+/* buffer up to SIZE bytes of simulated program output (writes to stdout and
+   stderr) before handing it to the host, 0 writes it straight through; the
+   buffer is flushed before any other system call, so output stays ordered
+   with input */
+void
+sys_output_init(int size)		/* output buffer size, in bytes */
+{
+  if (size < 0)
+    fatal("program output buffer size must be positive, or 0 for none");
+
+  sys_flush_output();
+  if (sys_outbuf)
+    free(sys_outbuf);
+
+  sys_outbuf = NULL;
+  sys_outbuf_size = size;
+  if (size > 0)
+    {
+      sys_outbuf = (char *)malloc(size);
+      if (!sys_outbuf)
+	fatal("out of virtual memory");
+    }
+}
+
+/* reserve NBYTES of output buffer for stream FD, returns NULL if the write
+   does not fit and should go straight to the host */
+static char *
+sys_output_reserve(int fd, int nbytes)
+{
+  char *p;
+
+  if (!sys_outbuf || nbytes < 0 || nbytes > sys_outbuf_size)
+    {
+      sys_flush_output();
+      return NULL;
+    }
+
+  if (fd != sys_outbuf_fd || sys_outbuf_len + nbytes > sys_outbuf_size)
+    sys_flush_output();
+
+  sys_outbuf_fd = fd;
+  p = sys_outbuf + sys_outbuf_len;
+  sys_outbuf_len += nbytes;
+  return p;
+}
+
+/* write NBYTES of simulated program output in BUF to stream FD (1 or 2) */
+void
+sys_output(int fd,			/* target stdout/stderr fd */
+	   void *buf,			/* output data */
+	   int nbytes)			/* number of bytes to write */
+{
+  char *p;
+
+  sys_output_writes++;
+  if ((p = sys_output_reserve(fd, nbytes)) != NULL)
+    memcpy(p, buf, nbytes);
+  else
+    sys_host_output(fd, buf, nbytes);
+}
+
+/* hand any buffered simulated program output to the host */
+void
+sys_flush_output(void)
+{
+  if (sys_outbuf_len > 0)
+    sys_host_output(sys_outbuf_fd, sys_outbuf, sys_outbuf_len);
+  sys_outbuf_len = 0;
+}
+
+/* register system call statistics */
+void
+sys_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
+{
+  stat_reg_counter(sdb, "sim_num_prog_writes",
+		   "total program writes to stdout/stderr",
+		   &sys_output_writes, 0, NULL);
+  stat_reg_counter(sdb, "sim_num_prog_hostwrites",
+		   "total host writes issued for program output",
+		   &sys_output_hostwrites, 0, NULL);
+  stat_reg_formula(sdb, "sim_prog_write_coalescing",
+		   "program writes per host write",
+		   "sim_num_prog_writes / sim_num_prog_hostwrites", NULL);
+}
+
 /* syscall proxy handler, architect registers and memory are assumed to be
    precise when this function is called, register and memory are updated with
    the results of the sustem call */
-void
-sys_syscall(struct regs_t *regs,	/* registers to access */
-	    mem_access_fn mem_fn,	/* generic memory accessor */
-	    struct mem_t *mem,		/* memory space to access */
-	    md_inst_t inst,		/* system call inst */
-	    int traceable)		/* traceable system call? */
+static void
+syscall_proxy(struct regs_t *regs,	/* registers to access */
+	      mem_access_fn mem_fn,	/* generic memory accessor */
+	      struct mem_t *mem,	/* memory space to access */
+	      md_inst_t inst,		/* system call inst */
+	      int traceable)		/* traceable system call? */
 {
   word_t syscode = regs->regs_R[2];
 
-  /* first, check if an EIO trace is being consumed... */
+  /* hand buffered program output to the host before anything else, e.g., a
+     read from stdin, can depend on it */
+  if (sys_outbuf_len > 0 && !MD_OUTPUT_SYSCALL(regs))
+    sys_flush_output();
+
+  /* record the call in the EIO trace being written, it is executed live or
+     taken from the EIO trace being consumed... */
+  if (traceable && sim_trace_fd != NULL)
+    {
+      eio_write_trace(sim_trace_fd, sim_num_insn, regs, mem_fn, mem, inst);
+
+      /* fini... */
+      return;
+    }
+
+  /* else, check if an EIO trace is being consumed... */
   if (traceable && sim_eio_fd != NULL)
     {
       eio_read_trace(sim_eio_fd, sim_num_insn, regs, mem_fn, mem, inst);
@@ -630,6 +910,8 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
   switch (syscode)
     {
     case SS_SYS_exit:
+      sys_flush_output();
+
       /* exit jumps to the target set in main() */
       longjmp(sim_exit_buf, /* exitcode + fudge */regs->regs_R[4]+1);
       break;
@@ -672,6 +954,51 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
       {
 	char *buf;
 
+	if (vfs_fd(/*fd*/regs->regs_R[4]))
+	  {
+	    byte_t *data;
+
+	    /* read from the in-memory file system */
+	    /*nread*/regs->regs_R[2] =
+	      vfs_read(/*fd*/regs->regs_R[4], &data, /*nbytes*/regs->regs_R[6]);
+
+	    /* check for error condition */
+	    if (regs->regs_R[2] != -1)
+	      {
+		mem_bcopy(mem_fn, mem, Write, /*buf*/regs->regs_R[5],
+			  data, /*nread*/regs->regs_R[2]);
+		regs->regs_R[7] = 0;
+	      }
+	    else
+	      {
+		/* got an error, return details */
+		regs->regs_R[2] = errno;
+		regs->regs_R[7] = 1;
+	      }
+	    break;
+	  }
+
+#ifndef _MSC_VER
+	if (mem_fn == mem_access)
+	  {
+	    /* read straight into the host pages of simulated memory */
+	    /*nread*/regs->regs_R[2] =
+	      sys_read_mem(/*fd*/regs->regs_R[4], mem,
+			   /*buf*/regs->regs_R[5], /*nbytes*/regs->regs_R[6]);
+
+	    /* check for error condition */
+	    if (regs->regs_R[2] != -1)
+	      regs->regs_R[7] = 0;
+	    else
+	      {
+		/* got an error, return details */
+		regs->regs_R[2] = errno;
+		regs->regs_R[7] = 1;
+	      }
+	    break;
+	  }
+#endif /* !_MSC_VER */
+
 	/* allocate same-sized input buffer in host memory */
 	if (!(buf = (char *)calloc(/*nbytes*/regs->regs_R[6], sizeof(char))))
 	  fatal("out of memory in SYS_read");
@@ -704,6 +1031,73 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
       {
 	char *buf;
 
+	if (vfs_fd(/*fd*/regs->regs_R[4]))
+	  {
+	    byte_t *data;
+
+	    /* write to the in-memory file system */
+	    /*nwritten*/regs->regs_R[2] =
+	      vfs_write(/*fd*/regs->regs_R[4], &data, /*nbytes*/regs->regs_R[6]);
+
+	    /* check for an error condition */
+	    if (regs->regs_R[2] != -1)
+	      {
+		mem_bcopy(mem_fn, mem, Read, /*buf*/regs->regs_R[5],
+			  data, /*nwritten*/regs->regs_R[2]);
+		/*result*/regs->regs_R[7] = 0;
+	      }
+	    else
+	      {
+		/* got an error, return details */
+		regs->regs_R[2] = errno;
+		regs->regs_R[7] = 1;
+	      }
+	    break;
+	  }
+
+	if (MD_OUTPUT_SYSCALL(regs))
+	  {
+	    sys_output_writes++;
+
+	    /* small program output writes are collected in the buffer */
+	    buf = sys_output_reserve(/*fd*/regs->regs_R[4],
+				     /*nbytes*/regs->regs_R[6]);
+	    if (buf)
+	      {
+		mem_bcopy(mem_fn, mem, Read, /*buf*/regs->regs_R[5],
+			  buf, /*nbytes*/regs->regs_R[6]);
+		/*nwritten*/regs->regs_R[2] = regs->regs_R[6];
+		/*result*/regs->regs_R[7] = 0;
+		break;
+	      }
+	    sys_output_hostwrites++;
+	  }
+
+#ifndef _MSC_VER
+	if (mem_fn == mem_access)
+	  {
+	    /* write straight from the host pages of simulated memory,
+	       redirecting program output to file if requested */
+	    /*nwritten*/regs->regs_R[2] =
+	      sys_write_mem(/*fd*/regs->regs_R[4],
+			    (sim_progfd && MD_OUTPUT_SYSCALL(regs))
+			    ? sim_progfd : NULL,
+			    mem, /*buf*/regs->regs_R[5],
+			    /*nbytes*/regs->regs_R[6]);
+
+	    /* check for an error condition */
+	    if (regs->regs_R[2] == regs->regs_R[6])
+	      /*result*/regs->regs_R[7] = 0;
+	    else
+	      {
+		/* got an error, return details */
+		regs->regs_R[2] = errno;
+		regs->regs_R[7] = 1;
+	      }
+	    break;
+	  }
+#endif /* !_MSC_VER */
+
 	/* allocate same-sized output buffer in host memory */
 	if (!(buf = (char *)calloc(/*nbytes*/regs->regs_R[6], sizeof(char))))
 	  fatal("out of memory in SYS_write");
@@ -749,7 +1143,7 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
       {
 	char buf[MAXBUFSIZE];
 	unsigned int i;
-	int ss_flags = regs->regs_R[5], local_flags = 0;
+	int ss_flags = regs->regs_R[5], local_flags = 0, fd;
 
 	/* translate open(2) flags */
 	for (i=0; i<SS_NFLAGS; i++)
@@ -767,9 +1161,10 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 	/* copy filename to host memory */
 	mem_strcpy(mem_fn, mem, Read, /*fname*/regs->regs_R[4], buf);
 
-	/* open the file */
-	/*fd*/regs->regs_R[2] =
-	  open(buf, local_flags, /*mode*/regs->regs_R[6]);
+	/* open the file, from the in-memory file system if it is there */
+	if (!vfs_open(buf, local_flags, /*mode*/regs->regs_R[6], &fd))
+	  fd = open(buf, local_flags, /*mode*/regs->regs_R[6]);
+	/*fd*/regs->regs_R[2] = fd;
 	
 	/* check for an error condition */
 	if (regs->regs_R[2] != -1)
@@ -794,7 +1189,10 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 	}
 
       /* close the file */
-      regs->regs_R[2] = close(/*fd*/regs->regs_R[4]);
+      if (vfs_fd(/*fd*/regs->regs_R[4]))
+	regs->regs_R[2] = vfs_close(/*fd*/regs->regs_R[4]);
+      else
+	regs->regs_R[2] = close(/*fd*/regs->regs_R[4]);
 
       /* check for an error condition */
       if (regs->regs_R[2] != -1)
@@ -810,12 +1208,16 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
     case SS_SYS_creat:
       {
 	char buf[MAXBUFSIZE];
+	int fd;
 
 	/* copy filename to host memory */
 	mem_strcpy(mem_fn, mem, Read, /*fname*/regs->regs_R[4], buf);
 
-	/* create the file */
-	/*fd*/regs->regs_R[2] = creat(buf, /*mode*/regs->regs_R[5]);
+	/* create the file, in the in-memory file system if it is in use */
+	if (!vfs_open(buf, O_WRONLY|O_CREAT|O_TRUNC, /*mode*/regs->regs_R[5],
+		      &fd))
+	  fd = creat(buf, /*mode*/regs->regs_R[5]);
+	/*fd*/regs->regs_R[2] = fd;
 
 	/* check for an error condition */
 	if (regs->regs_R[2] != -1)
@@ -948,9 +1350,14 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 
     case SS_SYS_lseek:
       /* seek into file */
-      regs->regs_R[2] =
-	lseek(/*fd*/regs->regs_R[4],
-	      /*off*/regs->regs_R[5], /*dir*/regs->regs_R[6]);
+      if (vfs_fd(/*fd*/regs->regs_R[4]))
+	regs->regs_R[2] =
+	  vfs_lseek(/*fd*/regs->regs_R[4],
+		    /*off*/regs->regs_R[5], /*dir*/regs->regs_R[6]);
+      else
+	regs->regs_R[2] =
+	  lseek(/*fd*/regs->regs_R[4],
+		/*off*/regs->regs_R[5], /*dir*/regs->regs_R[6]);
 
       /* check for an error condition */
       if (regs->regs_R[2] != -1)
@@ -1093,7 +1500,10 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 
     case SS_SYS_dup:
       /* dup() the file descriptor */
-      /*fd*/regs->regs_R[2] = dup(/*fd*/regs->regs_R[4]);
+      if (vfs_fd(/*fd*/regs->regs_R[4]))
+	/*fd*/regs->regs_R[2] = vfs_dup(/*fd*/regs->regs_R[4], -1);
+      else
+	/*fd*/regs->regs_R[2] = dup(/*fd*/regs->regs_R[4]);
 
       /* check for an error condition */
       if (regs->regs_R[2] != -1)
@@ -1335,7 +1745,12 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 #endif /* _MSC_VER */
 
 	/* fstat() the file */
-	/*result*/regs->regs_R[2] = fstat(/*fd*/regs->regs_R[4], &sbuf);
+#ifndef _MSC_VER
+	if (vfs_fd(/*fd*/regs->regs_R[4]))
+	  /*result*/regs->regs_R[2] = vfs_fstat(/*fd*/regs->regs_R[4], &sbuf);
+	else
+#endif /* !_MSC_VER */
+	  /*result*/regs->regs_R[2] = fstat(/*fd*/regs->regs_R[4], &sbuf);
 
 	/* check for an error condition */
 	if (regs->regs_R[2] != -1)
@@ -1441,8 +1856,12 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 
     case SS_SYS_dup2:
       /* dup2() the file descriptor */
-      regs->regs_R[2] =
-	dup2(/* fd1 */regs->regs_R[4], /* fd2 */regs->regs_R[5]);
+      if (vfs_fd(/* fd1 */regs->regs_R[4]) || vfs_fd(/* fd2 */regs->regs_R[5]))
+	regs->regs_R[2] =
+	  vfs_dup(/* fd1 */regs->regs_R[4], /* fd2 */regs->regs_R[5]);
+      else
+	regs->regs_R[2] =
+	  dup2(/* fd1 */regs->regs_R[4], /* fd2 */regs->regs_R[5]);
 
       /* check for an error condition */
       if (regs->regs_R[2] != -1)
@@ -1792,40 +2211,111 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
       regs->regs_R[7] = 0;
 #else /* !_MSC_VER */
       {
-	int i;
+	int i, j, niov, maxiov, cnt;
+	int zero_copy = (mem_fn == mem_access);
 	char *buf;
-	struct iovec *iov;
+	word_t ss_iov[2];
+	md_addr_t base;
+	size_t len, want, covered;
+	ssize_t n, total;
+	struct iovec *iov = NULL;
 
-	/* allocate host side I/O vectors */
-	iov =
-	  (struct iovec *)malloc(/*iovcnt*/regs->regs_R[6]
-				 * sizeof(struct iovec));
-	if (!iov)
-	  fatal("out of virtual memory in SYS_writev");
+	if (vfs_fd(/*fd*/regs->regs_R[4]))
+	  {
+	    byte_t *data;
 
-	/* copy target side pointer data into host side vector */
-	mem_bcopy(mem_fn, mem, Read, /*iov*/regs->regs_R[5],
-		  iov, /*iovcnt*/regs->regs_R[6] * sizeof(struct iovec));
+	    /* write to the in-memory file system, a vector at a time */
+	    for (i=0, total=0; i < /*iovcnt*/regs->regs_R[6]; i++)
+	      {
+		mem_bcopy(mem_fn, mem, Read,
+			  /*iov*/regs->regs_R[5] + i * sizeof(ss_iov),
+			  ss_iov, sizeof(ss_iov));
+		base = MD_SWAPW(ss_iov[0]);
+		len = MD_SWAPW(ss_iov[1]);
+
+		n = vfs_write(/*fd*/regs->regs_R[4], &data, len);
+		if (n < 0)
+		  {
+		    total = -1;
+		    break;
+		  }
+		mem_bcopy(mem_fn, mem, Read, base, data, n);
+		total += n;
+	      }
+	    /*result*/regs->regs_R[2] = total;
 
-	/* copy target side I/O vector buffers to host memory */
-	for (i=0; i < /*iovcnt*/regs->regs_R[6]; i++)
+	    /* check for an error condition */
+	    if (regs->regs_R[2] != -1)
+	      regs->regs_R[7] = 0;
+	    else
+	      {
+		/* got an error, indicate results */
+		regs->regs_R[2] = errno;
+		regs->regs_R[7] = 1;
+	      }
+	    break;
+	  }
+
+	/* build host side I/O vectors, when the plain accessor is in use they
+	   point straight at simulated memory, one per page, otherwise they
+	   point at buffered copies */
+	for (i=0, niov=0; i < /*iovcnt*/regs->regs_R[6]; i++)
 	  {
-	    iov[i].iov_base = (char *)MD_SWAPW((unsigned)iov[i].iov_base);
-	    iov[i].iov_len = MD_SWAPW(iov[i].iov_len);
-	    if (iov[i].iov_base != NULL)
+	    /* target side I/O vectors are pairs of 32-bit words */
+	    mem_bcopy(mem_fn, mem, Read,
+		      /*iov*/regs->regs_R[5] + i * sizeof(ss_iov),
+		      ss_iov, sizeof(ss_iov));
+	    base = MD_SWAPW(ss_iov[0]);
+	    len = MD_SWAPW(ss_iov[1]);
+
+	    maxiov = (zero_copy && base != 0)
+	      ? (MEM_OFFSET(base) + len + MD_PAGE_SIZE - 1) / MD_PAGE_SIZE : 1;
+	    iov = (struct iovec *)realloc(iov, (niov + MAX(maxiov, 1))
+					  * sizeof(struct iovec));
+	    if (!iov)
+	      fatal("out of virtual memory in SYS_writev");
+
+	    if (base == 0)
 	      {
-		buf = (char *)calloc(iov[i].iov_len, sizeof(char));
+		iov[niov].iov_base = NULL;
+		iov[niov].iov_len = len;
+		niov++;
+	      }
+	    else if (zero_copy)
+	      niov += sys_mem_iov(mem, base, len, /* alloc */FALSE,
+				  iov + niov, maxiov, &covered);
+	    else
+	      {
+		buf = (char *)calloc(len, sizeof(char));
 		if (!buf)
 		  fatal("out of virtual memory in SYS_writev");
-		mem_bcopy(mem_fn, mem, Read, (md_addr_t)iov[i].iov_base,
-			  buf, iov[i].iov_len);
-		iov[i].iov_base = buf;
+		mem_bcopy(mem_fn, mem, Read, base, buf, len);
+		iov[niov].iov_base = buf;
+		iov[niov].iov_len = len;
+		niov++;
 	      }
 	  }
 
-	/* perform the vector'ed write */
-	/*result*/regs->regs_R[2] =
-	  writev(/*fd*/regs->regs_R[4], iov, /*iovcnt*/regs->regs_R[6]);
+	/* perform the vector'ed write, a few host calls if there are more
+	   vectors than the host takes at once */
+	for (i=0, total=0; i < niov; i += cnt)
+	  {
+	    cnt = MIN(niov - i, SYS_MAX_IOV);
+	    for (j=0, want=0; j < cnt; j++)
+	      want += iov[i+j].iov_len;
+
+	    n = writev(/*fd*/regs->regs_R[4], iov + i, cnt);
+	    if (n < 0)
+	      {
+		if (!total)
+		  total = -1;
+		break;
+	      }
+	    total += n;
+	    if ((size_t)n != want)
+	      break;
+	  }
+	/*result*/regs->regs_R[2] = total;
 
 	/* check for an error condition */
 	if (regs->regs_R[2] != -1)
@@ -1838,7 +2328,7 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 	  }
 
 	/* free all the allocated memory */
-	for (i=0; i < /*iovcnt*/regs->regs_R[6]; i++)
+	for (i=0; !zero_copy && i < niov; i++)
 	  {
 	    if (iov[i].iov_base)
 	      {
@@ -2032,3 +2522,22 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 #endif /* MD_CROSS_ENDIAN */
 
 }
+
+/* syscall handler, see syscall_proxy() */
+void
+sys_syscall(struct regs_t *regs,	/* registers to access */
+	    mem_access_fn mem_fn,	/* generic memory accessor */
+	    struct mem_t *mem,		/* memory space to access */
+	    md_inst_t inst,		/* system call inst */
+	    int traceable)		/* traceable system call? */
+{
+#ifdef HOST_PROFILE
+  enum hostprof_comp_t prev = hostprof_begin(hp_syscall);
+#endif
+
+  syscall_proxy(regs, mem_fn, mem, inst, traceable);
+
+#ifdef HOST_PROFILE
+  hostprof_end(prev);
+#endif
+}
@@ -0,0 +1,486 @@
+/* vfs.c - in-memory file system routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "host.h"
+#include "misc.h"
+#include "stats.h"
+#include "vfs.h"
+
+/* a file held in memory */
+struct vfs_file_t {
+  struct vfs_file_t *next;		/* next file in the table */
+  char *name;				/* name the program opens it by */
+  char *path;				/* host path to write it back to */
+  byte_t *data;				/* file contents */
+  size_t size;				/* file size, in bytes */
+  size_t cap;				/* bytes allocated for the contents */
+  int dirty;				/* written since the last vfs_sync()? */
+};
+
+/* an open file */
+struct vfs_open_t {
+  struct vfs_file_t *file;		/* file opened */
+  off_t pos;				/* file position */
+  int flags;				/* host open(2) flags */
+  int refs;				/* descriptors sharing this open */
+};
+
+/* preloaded directory, NULL if the file system is not in use */
+static char *vfs_dir = NULL;
+
+/* file table */
+static struct vfs_file_t *vfs_files = NULL;
+
+/* open files, by descriptor */
+static struct vfs_open_t *vfs_fds[VFS_MAX_FD];
+
+/* file system stats */
+static counter_t vfs_nfiles = 0;	/* files preloaded */
+static counter_t vfs_bytes_loaded = 0;	/* bytes preloaded */
+static counter_t vfs_nopens = 0;	/* opens served */
+static counter_t vfs_bytes_read = 0;	/* bytes read by the program */
+static counter_t vfs_bytes_written = 0;	/* bytes written by the program */
+
+/* add an empty file NAME to the file table */
+static struct vfs_file_t *
+vfs_new_file(char *name)
+{
+  struct vfs_file_t *f;
+
+  f = (struct vfs_file_t *)calloc(1, sizeof(struct vfs_file_t));
+  if (!f)
+    fatal("out of virtual memory");
+  f->name = mystrdup(name);
+
+  f->next = vfs_files;
+  vfs_files = f;
+  return f;
+}
+
+/* strip FNAME down to the name it is kept under in the file table */
+static char *
+vfs_name(char *fname)
+{
+  size_t len = strlen(vfs_dir);
+
+  /* the program may name preloaded files relative to the directory */
+  while (fname[0] == '.' && fname[1] == '/')
+    fname += 2;
+  if (!strncmp(fname, vfs_dir, len) && fname[len] == '/')
+    fname += len + 1;
+  return fname;
+}
+
+/* find file FNAME in the file table, returns NULL if it is not there */
+static struct vfs_file_t *
+vfs_lookup(char *fname)
+{
+  struct vfs_file_t *f;
+
+  fname = vfs_name(fname);
+  for (f = vfs_files; f != NULL; f = f->next)
+    {
+      if (!strcmp(f->name, fname))
+	return f;
+    }
+  return NULL;
+}
+
+/* make room for SIZE bytes in file F */
+static void
+vfs_grow(struct vfs_file_t *f, size_t size)
+{
+  if (size <= f->cap)
+    return;
+
+  f->cap = MAX(size, 2 * f->cap);
+  f->data = (byte_t *)realloc(f->data, f->cap);
+  if (!f->data)
+    fatal("out of virtual memory");
+}
+
+/* load every regular file in directory DIR into the file system */
+void
+vfs_init(char *dir)			/* directory to preload */
+{
+  DIR *dirp;
+  struct dirent *ent;
+  struct stat sbuf;
+  struct vfs_file_t *f;
+  char path[4096];
+  FILE *fd;
+
+  dirp = opendir(dir);
+  if (!dirp)
+    fatal("cannot open preload directory `%s'", dir);
+
+  /* names are matched without any trailing slashes */
+  vfs_dir = mystrdup(dir);
+  while (strlen(vfs_dir) > 1 && vfs_dir[strlen(vfs_dir) - 1] == '/')
+    vfs_dir[strlen(vfs_dir) - 1] = '\0';
+
+  while ((ent = readdir(dirp)) != NULL)
+    {
+      sprintf(path, "%s/%s", vfs_dir, ent->d_name);
+      if (stat(path, &sbuf) < 0 || !S_ISREG(sbuf.st_mode))
+	continue;
+
+      f = vfs_new_file(ent->d_name);
+      vfs_grow(f, MAX(sbuf.st_size, 1));
+
+      fd = fopen(path, "rb");
+      if (!fd)
+	fatal("cannot open preload file `%s'", path);
+      f->size = fread(f->data, 1, sbuf.st_size, fd);
+      if (f->size != (size_t)sbuf.st_size)
+	fatal("cannot read preload file `%s'", path);
+      fclose(fd);
+
+      vfs_nfiles++;
+      vfs_bytes_loaded += f->size;
+    }
+  closedir(dirp);
+}
+
+/* is descriptor FD served by the file system? */
+int
+vfs_fd(int fd)				/* target file descriptor */
+{
+  return (fd >= 0 && fd < VFS_MAX_FD && vfs_fds[fd] != NULL);
+}
+
+/* open file FNAME with host open(2) FLAGS and MODE, returns TRUE if the file
+   system handles it, with the descriptor (or -1 and errno) in *FD; returns
+   FALSE if the file should be opened on the host */
+int
+vfs_open(char *fname,			/* file name */
+	 int flags,			/* host open(2) flags */
+	 int mode,			/* creation mode */
+	 int *fd)			/* descriptor, -1 on an error */
+{
+  struct vfs_file_t *f;
+  struct vfs_open_t *o;
+  struct stat sbuf;
+  int hfd;
+
+  if (!vfs_dir)
+    return FALSE;
+
+  f = vfs_lookup(fname);
+  if (!f && !(flags & O_CREAT))
+    return FALSE;
+
+  /* a host file that was not preloaded keeps its contents unless the open
+     truncates it, and O_EXCL must see it, so leave such opens to the host */
+  if (!f && (!(flags & O_TRUNC) || (flags & O_EXCL))
+      && stat(fname, &sbuf) == 0)
+    return FALSE;
+  if (f && (flags & O_CREAT) && (flags & O_EXCL))
+    {
+      errno = EEXIST;
+      *fd = -1;
+      return TRUE;
+    }
+
+  /* hold a host descriptor, so the number stays ours */
+  hfd = open("/dev/null", O_RDONLY);
+  if (hfd < 0)
+    {
+      *fd = -1;
+      return TRUE;
+    }
+  if (hfd >= VFS_MAX_FD)
+    {
+      close(hfd);
+      return FALSE;
+    }
+
+  if (!f)
+    f = vfs_new_file(vfs_name(fname));
+
+  /* created or written files go back to the host under the name used here,
+     created files even if the program never writes to them */
+  if ((flags & O_CREAT) || (flags & O_ACCMODE) != O_RDONLY)
+    {
+      if (!f->path)
+	f->path = mystrdup(fname);
+    }
+  if (flags & O_CREAT)
+    f->dirty = TRUE;
+  if ((flags & O_TRUNC) && (flags & O_ACCMODE) != O_RDONLY)
+    {
+      f->size = 0;
+      f->dirty = TRUE;
+    }
+
+  o = (struct vfs_open_t *)calloc(1, sizeof(struct vfs_open_t));
+  if (!o)
+    fatal("out of virtual memory");
+  o->file = f;
+  o->pos = 0;
+  o->flags = flags;
+  o->refs = 1;
+  vfs_fds[hfd] = o;
+
+  vfs_nopens++;
+  *fd = hfd;
+  return TRUE;
+}
+
+/* read up to NBYTES from FD, returns the count (0 at end of file) and a
+   pointer to the data in *DATA, or -1 and errno */
+int
+vfs_read(int fd,			/* file descriptor */
+	 byte_t **data,			/* pointer to the data read */
+	 int nbytes)			/* bytes requested */
+{
+  struct vfs_open_t *o = vfs_fds[fd];
+  int n;
+
+  if ((o->flags & O_ACCMODE) == O_WRONLY || nbytes < 0)
+    {
+      errno = (nbytes < 0) ? EINVAL : EBADF;
+      return -1;
+    }
+
+  if ((size_t)o->pos >= o->file->size)
+    n = 0;
+  else
+    n = MIN((size_t)nbytes, o->file->size - o->pos);
+
+  *data = o->file->data + o->pos;
+  o->pos += n;
+
+  vfs_bytes_read += n;
+  return n;
+}
+
+/* write NBYTES to FD, returns the count and the space to copy the data to in
+   *DATA, or -1 and errno */
+int
+vfs_write(int fd,			/* file descriptor */
+	  byte_t **data,		/* where to copy the data */
+	  int nbytes)			/* bytes to write */
+{
+  struct vfs_open_t *o = vfs_fds[fd];
+  struct vfs_file_t *f = o->file;
+
+  if ((o->flags & O_ACCMODE) == O_RDONLY || nbytes < 0)
+    {
+      errno = (nbytes < 0) ? EINVAL : EBADF;
+      return -1;
+    }
+
+  if (o->flags & O_APPEND)
+    o->pos = f->size;
+
+  /* writes past the end leave a hole of zeros */
+  vfs_grow(f, o->pos + nbytes);
+  if ((size_t)o->pos > f->size)
+    memset(f->data + f->size, 0, o->pos - f->size);
+
+  *data = f->data + o->pos;
+  o->pos += nbytes;
+  f->size = MAX(f->size, (size_t)o->pos);
+  f->dirty = TRUE;
+
+  vfs_bytes_written += nbytes;
+  return nbytes;
+}
+
+/* reposition FD as lseek(2), returns the new offset, or -1 and errno */
+off_t
+vfs_lseek(int fd,			/* file descriptor */
+	  off_t offset,			/* offset */
+	  int whence)			/* SEEK_SET, SEEK_CUR or SEEK_END */
+{
+  struct vfs_open_t *o = vfs_fds[fd];
+  off_t pos;
+
+  switch (whence)
+    {
+    case SEEK_SET: pos = offset; break;
+    case SEEK_CUR: pos = o->pos + offset; break;
+    case SEEK_END: pos = o->file->size + offset; break;
+    default: pos = -1; break;
+    }
+
+  if (pos < 0)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  o->pos = pos;
+  return pos;
+}
+
+/* stat FD as fstat(2), returns 0, or -1 and errno */
+int
+vfs_fstat(int fd,			/* file descriptor */
+	  struct stat *sbuf)		/* stat buffer to fill */
+{
+  struct vfs_file_t *f = vfs_fds[fd]->file;
+
+  /* a plain file, with fixed times so runs are reproducible */
+  memset(sbuf, 0, sizeof(*sbuf));
+  sbuf->st_mode = S_IFREG | 0644;
+  sbuf->st_nlink = 1;
+  sbuf->st_uid = getuid();
+  sbuf->st_gid = getgid();
+  sbuf->st_size = f->size;
+  sbuf->st_blksize = 4096;
+  sbuf->st_blocks = (f->size + 511) / 512;
+  return 0;
+}
+
+/* drop FD from the descriptor table, the open goes with its last one */
+static void
+vfs_release(int fd)
+{
+  struct vfs_open_t *o = vfs_fds[fd];
+
+  vfs_fds[fd] = NULL;
+  if (--o->refs == 0)
+    free(o);
+}
+
+/* duplicate FD as dup(2), or as dup2(2) onto NEWFD if NEWFD >= 0; either
+   descriptor may be served by the file system, returns the new descriptor,
+   or -1 and errno */
+int
+vfs_dup(int fd,				/* file descriptor */
+	int newfd)			/* descriptor to reuse, or -1 */
+{
+  struct vfs_open_t *o = vfs_fd(fd) ? vfs_fds[fd] : NULL;
+  int hfd;
+
+  if (newfd == fd)
+    return dup2(fd, newfd);
+
+  /* the host closes NEWFD, if it was open, and keeps numbering for us */
+  hfd = (newfd < 0) ? dup(fd) : dup2(fd, newfd);
+  if (hfd < 0)
+    return -1;
+  if (vfs_fd(hfd))
+    vfs_release(hfd);
+
+  if (o)
+    {
+      if (hfd >= VFS_MAX_FD)
+	{
+	  close(hfd);
+	  errno = EMFILE;
+	  return -1;
+	}
+      o->refs++;
+      vfs_fds[hfd] = o;
+    }
+  return hfd;
+}
+
+/* close FD, returns 0, or -1 and errno */
+int
+vfs_close(int fd)			/* file descriptor */
+{
+  vfs_release(fd);
+  return close(fd);
+}
+
+/* write every file the program created or modified to the host */
+void
+vfs_sync(void)
+{
+  struct vfs_file_t *f;
+  FILE *fd;
+
+  for (f = vfs_files; f != NULL; f = f->next)
+    {
+      if (!f->dirty)
+	continue;
+
+      /* can't fatal() here, this runs from the fatal hook */
+      fd = fopen(f->path, "wb");
+      if (!fd || fwrite(f->data, 1, f->size, fd) != f->size)
+	warn("cannot write back file `%s'", f->path);
+      if (fd)
+	fclose(fd);
+      f->dirty = FALSE;
+    }
+}
+
+/* register file system statistics */
+void
+vfs_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
+{
+  if (!vfs_dir)
+    return;
+
+  stat_reg_counter(sdb, "vfs.files", "total files preloaded",
+		   &vfs_nfiles, vfs_nfiles, NULL);
+  stat_reg_counter(sdb, "vfs.bytes_loaded", "total bytes preloaded",
+		   &vfs_bytes_loaded, vfs_bytes_loaded, NULL);
+  stat_reg_counter(sdb, "vfs.opens", "total opens served from memory",
+		   &vfs_nopens, 0, NULL);
+  stat_reg_counter(sdb, "vfs.bytes_read", "total bytes read from memory",
+		   &vfs_bytes_read, 0, NULL);
+  stat_reg_counter(sdb, "vfs.bytes_written", "total bytes written to memory",
+		   &vfs_bytes_written, 0, NULL);
+}
@@ -61,6 +61,15 @@
 /* EIO file version */
 #define EIO_FILE_VERSION		3
 
+/* create new EIO files in the binary EXO encoding? EIO files of either
+   encoding can be read */
+extern int eio_binary;
+
+/* instructions between checkpoints embedded in EIO traces written, 0 for
+   none; they are taken at the first system call past each interval, and
+   need binary traces, as only those can seek */
+extern unsigned int eio_chkpt_interval;
+
 FILE *eio_create(char *fname);
 
 FILE *eio_open(char *fname);
@@ -109,4 +118,18 @@ eio_read_trace(FILE *eio_fd,			/* EIO stream file desc */
 /* fast forward EIO trace EIO_FD to the transaction just after ICNT */
 void eio_fast_forward(FILE *eio_fd, counter_t icnt);
 
+/* restore the last checkpoint embedded in EIO trace EIO_FD at or before
+   instruction ICNT, and leave the trace at the transaction after it;
+   returns the instruction count of the checkpoint, or -1 if there is
+   none and nothing was done */
+counter_t
+eio_seek(FILE *eio_fd,				/* EIO stream file desc */
+	 counter_t icnt,			/* instruction to seek to */
+	 struct regs_t *regs,			/* regs to restore */
+	 struct mem_t *mem);			/* memory to restore */
+
+/* returns the instruction count of the last transaction in EIO file FNAME,
+   0 if it has none */
+counter_t eio_last_icnt(char *fname);
+
 #endif /* EIO_H */
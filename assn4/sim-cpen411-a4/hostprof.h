@@ -0,0 +1,184 @@
+/* hostprof.h - simulator self-profiling interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+
+#ifndef HOSTPROF_H
+#define HOSTPROF_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "options.h"
+#include "stats.h"
+
+/*
+ * The host profiler splits the simulator's own run time between its
+ * components, so that optimization effort goes where the host time goes.
+ * It is compiled in only when HOST_PROFILE is defined (see FFLAGS in the
+ * Makefile); otherwise the hooks below expand to nothing.
+ *
+ * Time is read from the host cycle counter (rdtsc) where there is one and
+ * from clock_gettime() elsewhere, and is converted to seconds against the
+ * wall clock at the end of the run.  To keep the overhead low, only one in
+ * every -hostprof:period instructions (cycles, for the pipeline models) is
+ * timed, and the split of the timed instructions is applied to the whole
+ * main loop; system calls are rare and expensive, so they are timed on
+ * every occurrence instead.  Each component is charged its exclusive
+ * time, e.g., a page table miss taken while executing a load is charged to
+ * translation, not to execution.  Whatever no hook claims, e.g., setting up
+ * the timing models, is charged to `other'.
+ *
+ * The simulator hooks its main loop as follows:
+ *
+ *   HOSTPROF_INSN(hp_decode);	-- start of an instruction (or cycle)
+ *   ...fetch and decode...
+ *   HOSTPROF_SWITCH(hp_exec);	-- move on to the next component
+ *
+ * and code that may run in any component brackets itself with
+ *
+ *   HOSTPROF_ENTER(hp_xlate, prev);	-- PREV saves the current component
+ *   ...
+ *   HOSTPROF_LEAVE(prev);
+ *
+ * With -hostprof:hz, a SIGPROF timer also samples the guest PC the
+ * simulator is working on, which it names with HOSTPROF_GUEST_PC() at
+ * startup, along with the component it is in.  At exit the samples are
+ * grouped by the guest function they fall in, which shows the guest code
+ * regions that are expensive to simulate, e.g., system call heavy code, or
+ * code that thrashes the page tables.  The samples land on whichever
+ * simulator thread the kernel picks, so run reference queue consumers
+ * inline (-refq:inline) for a clean split.
+ */
+
+/* simulator components */
+enum hostprof_comp_t {
+  hp_other,			/* simulator setup, and anything unhooked */
+  hp_decode,			/* instruction fetch and decode */
+  hp_exec,			/* functional execution */
+  hp_xlate,			/* memory translation, page table misses */
+  hp_syscall,			/* system call proxy and EIO traces */
+  hp_bpred,			/* branch predictors */
+  hp_cache,			/* cache models */
+  hp_timing,			/* other timing models, e.g., a pipeline */
+  hp_NUM
+};
+
+#ifdef HOST_PROFILE
+
+/* component being charged, kept up to date even between timed
+   instructions for the SIGPROF sampler */
+extern volatile enum hostprof_comp_t hostprof_cur;
+
+/* timing the current instruction? */
+extern int hostprof_sampling;
+
+/* instructions left until the next sampling decision */
+extern int hostprof_countdown;
+
+/* charge the time since the last switch to the current component, and
+   continue with component COMP */
+void hostprof_switch(enum hostprof_comp_t comp);
+
+/* instruction boundary, decide whether to time the next instruction, which
+   starts in component COMP */
+void hostprof_insn(enum hostprof_comp_t comp);
+
+/* time a rare region in component COMP on every occurrence, returns the
+   component to hand to hostprof_end() */
+enum hostprof_comp_t hostprof_begin(enum hostprof_comp_t comp);
+void hostprof_end(enum hostprof_comp_t prev);
+
+/* guest PC recorded by the SIGPROF sampler */
+void hostprof_guest_pc(md_addr_t *pc);
+
+#define HOSTPROF_INSN(COMP)						\
+  do { if (--hostprof_countdown <= 0) hostprof_insn(COMP);		\
+       else hostprof_cur = (COMP); } while (0)
+#define HOSTPROF_SWITCH(COMP)						\
+  do { if (hostprof_sampling) hostprof_switch(COMP);			\
+       else hostprof_cur = (COMP); } while (0)
+#define HOSTPROF_ENTER(COMP, PREV)					\
+  do { (PREV) = hostprof_cur; HOSTPROF_SWITCH(COMP); } while (0)
+#define HOSTPROF_LEAVE(PREV)						\
+  HOSTPROF_SWITCH(PREV)
+#define HOSTPROF_GUEST_PC(PC)						\
+  hostprof_guest_pc(PC)
+
+/* register host profiler options */
+void
+hostprof_reg_options(struct opt_odb_t *odb);	/* options database */
+
+/* register host profiler stats */
+void
+hostprof_reg_stats(struct stat_sdb_t *sdb);	/* stats database */
+
+/* start timing, at the start of simulation */
+void hostprof_start(void);
+
+/* stop timing and compute the breakdown, before the stats are printed */
+void hostprof_stop(void);
+
+/* print the SIGPROF samples by guest function, after the stats */
+void hostprof_print_funcs(FILE *stream);
+
+#else /* !HOST_PROFILE */
+
+#define HOSTPROF_INSN(COMP)
+#define HOSTPROF_SWITCH(COMP)
+#define HOSTPROF_ENTER(COMP, PREV)
+#define HOSTPROF_LEAVE(PREV)
+#define HOSTPROF_GUEST_PC(PC)
+
+#endif /* HOST_PROFILE */
+
+#endif /* HOSTPROF_H */
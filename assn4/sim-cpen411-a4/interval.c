@@ -0,0 +1,445 @@
+/* interval.c - parallel trace interval simulation routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "options.h"
+#include "stats.h"
+#include "sweep.h"
+#include "interval.h"
+
+/* create an interval simulation of COUNT intervals over the first LENGTH
+   instructions of a trace, each warmed up over at least WARMUP
+   instructions, with one more serial run if CHECK is set */
+struct interval_t *
+interval_new(int count,			/* number of intervals */
+	     counter_t length,		/* instructions in the trace */
+	     counter_t warmup,		/* minimum warm-up per interval */
+	     int check,			/* compare against a serial run? */
+	     char *prefix)		/* output file name prefix */
+{
+  int i;
+  struct interval_t *iv;
+
+  if (count < 1)
+    fatal("need at least one interval");
+  if (length < (counter_t)count)
+    fatal("cannot split %d instructions into %d intervals",
+	  (int)length, count);
+  if (length > (counter_t)0xffffffff)
+    fatal("intervals are limited to 2^32 instructions");
+
+  iv = (struct interval_t *)calloc(1, sizeof(struct interval_t));
+  if (!iv)
+    fatal("out of virtual memory");
+  iv->count = count;
+  iv->length = length;
+  iv->warmup = warmup;
+  iv->check = check;
+
+  iv->start = (counter_t *)calloc(count, sizeof(counter_t));
+  if (!iv->start)
+    fatal("out of virtual memory");
+  for (i=0; i < count; i++)
+    iv->start[i] = (length * i) / count;
+
+  /* the first interval needs no warm-up run */
+  iv->runs = sweep_runs(2*count - 1 + (check ? 1 : 0), prefix);
+
+  return iv;
+}
+
+/* launch all runs of interval simulation IV, at most NJOBS at once,
+   returns the run index in a worker, or -1 in the driver after all
+   workers have exited */
+int					/* run index, or -1 in driver */
+interval_launch(struct interval_t *iv,	/* interval simulation */
+		int njobs)		/* max concurrent runs, 0 = host CPUs */
+{
+  fprintf(stderr, "interval: %d intervals of ~%.0f instructions, "
+	  "warm-up >= %.0f\n", iv->count,
+	  (double)iv->length / iv->count, (double)iv->warmup);
+  return sweep_launch(iv->runs, njobs);
+}
+
+/* run RUN measures interval *PI, from the trace start or a warm-up start,
+   and stops at the interval's start if *PWARM is set; returns FALSE for
+   the serial run */
+static int
+run_interval(struct interval_t *iv, int run, int *pi, int *pwarm)
+{
+  if (run >= 2*iv->count - 1)
+    return FALSE;
+
+  *pi = (run + 1) / 2;
+  *pwarm = (run > 0 && (run & 1));
+  return TRUE;
+}
+
+/* apply the start and stop options of run RUN to options database ODB */
+void
+interval_apply(struct interval_t *iv,	/* interval simulation */
+	       struct opt_odb_t *odb,	/* options database */
+	       int run)			/* run index */
+{
+  int i, warm, largc;
+  counter_t start, stop;
+  char *largv[5], start_buf[32], stop_buf[32];
+
+  if (!run_interval(iv, run, &i, &warm))
+    return;
+
+  /* restore a checkpoint at least WARMUP instructions, and one instruction,
+     before the interval, so both runs of it execute its first instruction */
+  start = 0;
+  if (i > 0)
+    start = iv->start[i] - MAX(iv->warmup, 1);
+  if (start < 0)
+    start = 0;
+
+  /* the last interval runs to the end of the trace */
+  if (warm)
+    stop = iv->start[i];
+  else
+    stop = (i + 1 < iv->count) ? iv->start[i + 1] : 0;
+
+  sprintf(start_buf, "%u", (unsigned int)start);
+  sprintf(stop_buf, "%u", (unsigned int)stop);
+
+  /* marshall an option array, opt_process_options() skips argv[0] */
+  largc = 0;
+  largv[largc++] = "interval";
+  largv[largc++] = "-eio:start";
+  largv[largc++] = start_buf;
+  largv[largc++] = "-max:inst";
+  largv[largc++] = stop_buf;
+  opt_process_options(odb, largc, largv);
+}
+
+/* return the output file name of run RUN, with extension EXT */
+char *
+interval_fname(struct interval_t *iv,	/* interval simulation */
+	       int run,			/* run index */
+	       char *ext)		/* file name extension */
+{
+  return sweep_fname(iv->runs, run, ext);
+}
+
+/* scalar statistics read from a simulator output */
+struct run_stats_t {
+  int nstats;			/* number of stats */
+  int maxstats;			/* allocated slots */
+  char **names;			/* stat names */
+  double *vals;			/* stat values */
+};
+
+/* read the scalar statistics of simulator output FNAME into RS, returns
+   FALSE if it cannot be read */
+static int
+read_stats(char *fname, struct run_stats_t *rs)
+{
+  int in_stats;
+  char line[1024], *name, *val, *hash;
+  FILE *fd;
+
+  rs->nstats = rs->maxstats = 0;
+  rs->names = NULL;
+  rs->vals = NULL;
+
+  fd = fopen(fname, "r");
+  if (!fd)
+    {
+      warn("could not open interval output `%s'", fname);
+      return FALSE;
+    }
+
+  in_stats = FALSE;
+  while (fgets(line, sizeof(line), fd))
+    {
+      if (!in_stats)
+	{
+	  if (strstr(line, "** simulation statistics **"))
+	    in_stats = TRUE;
+	  continue;
+	}
+
+      /* scalar stats print as `<name> <value> # <description>' */
+      name = strtok(line, " \t\n");
+      val = strtok(NULL, " \t\n");
+      hash = strtok(NULL, " \t\n");
+      if (!name || !val || !hash || strcmp(hash, "#") != 0)
+	continue;
+
+      if (rs->nstats == rs->maxstats)
+	{
+	  rs->maxstats = rs->maxstats ? 2*rs->maxstats : 64;
+	  rs->names =
+	    (char **)realloc(rs->names, rs->maxstats * sizeof(char *));
+	  rs->vals =
+	    (double *)realloc(rs->vals, rs->maxstats * sizeof(double));
+	  if (!rs->names || !rs->vals)
+	    fatal("out of virtual memory");
+	}
+      rs->names[rs->nstats] = mystrdup(name);
+      rs->vals[rs->nstats] = strtod(val, NULL);
+      rs->nstats++;
+    }
+
+  fclose(fd);
+  return TRUE;
+}
+
+/* release the statistics in RS */
+static void
+free_stats(struct run_stats_t *rs)
+{
+  int i;
+
+  for (i=0; i < rs->nstats; i++)
+    free(rs->names[i]);
+  if (rs->names)
+    free(rs->names);
+  if (rs->vals)
+    free(rs->vals);
+}
+
+/* return the value of stat NAME in RS through *PVAL, FALSE if absent */
+static int
+find_stat(struct run_stats_t *rs, char *name, double *pval)
+{
+  int i;
+
+  for (i=0; i < rs->nstats; i++)
+    {
+      if (!strcmp(rs->names[i], name))
+	{
+	  *pval = rs->vals[i];
+	  return TRUE;
+	}
+    }
+  return FALSE;
+}
+
+/* read the stats of run RUN, FALSE if it failed */
+static int
+read_run(struct interval_t *iv, int run, struct run_stats_t *rs)
+{
+  int ok;
+  char *fname;
+
+  if (iv->runs->status[run] != 0)
+    {
+      warn("interval run %d failed, exit status %d",
+	   run, iv->runs->status[run]);
+      rs->nstats = 0;
+      rs->names = NULL;
+      rs->vals = NULL;
+      return FALSE;
+    }
+
+  fname = interval_fname(iv, run, "simout");
+  ok = read_stats(fname, rs);
+  free(fname);
+  return ok;
+}
+
+/* returns non-zero if STAT is a scalar counter that can be stitched */
+static int
+scalar_stat(struct stat_stat_t *stat)
+{
+  switch (stat->sc)
+    {
+    case sc_int:
+    case sc_uint:
+#ifdef HOST_HAS_QWORD
+    case sc_qword:
+    case sc_sqword:
+#endif /* HOST_HAS_QWORD */
+    case sc_float:
+    case sc_double:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+/* set scalar stat STAT to VAL */
+static void
+set_stat(struct stat_stat_t *stat, double val)
+{
+  switch (stat->sc)
+    {
+    case sc_int:
+      *stat->variant.for_int.var = (int)val;
+      break;
+    case sc_uint:
+      *stat->variant.for_uint.var = (unsigned int)val;
+      break;
+#ifdef HOST_HAS_QWORD
+    case sc_qword:
+      *stat->variant.for_qword.var = (qword_t)val;
+      break;
+    case sc_sqword:
+      *stat->variant.for_sqword.var = (sqword_t)val;
+      break;
+#endif /* HOST_HAS_QWORD */
+    case sc_float:
+      *stat->variant.for_float.var = (float)val;
+      break;
+    case sc_double:
+      *stat->variant.for_double.var = val;
+      break;
+    default:
+      panic("bogus stat class");
+    }
+}
+
+/* stitch the counters of all interval runs into stats database SDB */
+void
+interval_stitch(struct interval_t *iv,	/* interval simulation */
+		struct stat_sdb_t *sdb)	/* stats database */
+{
+  int i, n;
+  double sum, end, start;
+  struct run_stats_t *rs;
+  struct stat_stat_t *stat;
+
+  /* the counters of interval I are those of run 2I less those of warm-up
+     run 2I-1, the first interval starts from the initial state */
+  n = 2*iv->count - 1;
+  rs = (struct run_stats_t *)calloc(n, sizeof(struct run_stats_t));
+  if (!rs)
+    fatal("out of virtual memory");
+  for (i=0; i < n; i++)
+    read_run(iv, i, &rs[i]);
+
+  for (stat=sdb->stats; stat != NULL; stat=stat->next)
+    {
+      if (!scalar_stat(stat))
+	continue;
+
+      if (!find_stat(&rs[0], stat->name, &sum))
+	continue;
+      for (i=1; i < iv->count; i++)
+	{
+	  if (find_stat(&rs[2*i], stat->name, &end)
+	      && find_stat(&rs[2*i - 1], stat->name, &start))
+	    sum += end - start;
+	}
+      set_stat(stat, sum);
+    }
+
+  for (i=0; i < n; i++)
+    free_stats(&rs[i]);
+  free(rs);
+
+  fprintf(stderr, "interval: stitched %d intervals\n", iv->count);
+}
+
+/* compare the stitched stats of SDB with those of the serial run, one row
+   per stat in `<prefix>.csv' */
+void
+interval_compare(struct interval_t *iv,	/* interval simulation */
+		 struct stat_sdb_t *sdb)/* stats database */
+{
+  int i;
+  double val;
+  char fname[1024];
+  struct run_stats_t stitched, serial;
+  FILE *fd;
+
+  if (!iv->check)
+    return;
+
+  /* formulas are compared too, so read the stitched stats back as printed */
+  sprintf(fname, "%.1000s.stitched", iv->runs->prefix);
+  fd = fopen(fname, "w");
+  if (!fd)
+    fatal("could not open interval output `%s'", fname);
+  fprintf(fd, "\nsim: ** simulation statistics **\n");
+  stat_print_stats(sdb, fd);
+  fclose(fd);
+  read_stats(fname, &stitched);
+
+  if (!read_run(iv, iv->runs->nconfigs - 1, &serial))
+    {
+      free_stats(&stitched);
+      return;
+    }
+
+  sprintf(fname, "%.1000s.csv", iv->runs->prefix);
+  fd = fopen(fname, "w");
+  if (!fd)
+    fatal("could not open interval table `%s'", fname);
+
+  /* relative error in percent, blank where the serial value is zero */
+  fprintf(fd, "stat,stitched,serial,error\n");
+  for (i=0; i < stitched.nstats; i++)
+    {
+      if (!find_stat(&serial, stitched.names[i], &val))
+	continue;
+      fprintf(fd, "%s,%.17g,%.17g,", stitched.names[i],
+	      stitched.vals[i], val);
+      if (val != 0.0)
+	fprintf(fd, "%.4f", 100.0 * (stitched.vals[i] - val) / val);
+      fprintf(fd, "\n");
+    }
+  fclose(fd);
+
+  free_stats(&stitched);
+  free_stats(&serial);
+
+  fprintf(stderr, "interval: compared with the serial run in `%s'\n", fname);
+}
@@ -213,6 +213,82 @@ exo_print(struct exo_term_t *exo, FILE *stream);
 struct exo_term_t *
 exo_read(FILE *stream);
 
+
+/*
+ * EXO binary encoding:
+ *
+ *   The binary encoding stores the same terms as the text format, without
+ *   the lexer on the read side.  Each term starts with its class as a byte,
+ *   followed by:
+ *
+ *	ec_integer, ec_address	value as an unsigned LEB128 varint
+ *	ec_float		8-byte host-order double
+ *	ec_char			1 byte
+ *	ec_string, ec_token	varint length, bytes and a terminating '\0'
+ *	ec_list			element terms, then an ec_null byte
+ *	ec_array		varint size, then SIZE element terms, where an
+ *				ec_null byte is a NULL element
+ *	ec_blob			varint size, then SIZE bytes
+ *
+ *   Readers decode terms from a buffer in memory (usually a mapped file).
+ *   exo_pull() decodes one node at a time into a caller-provided term, so
+ *   callers can walk a record without building a tree; exo_pull_tree()
+ *   builds whole terms with nodes taken from an arena, which is reset
+ *   rather than freed node by node.  Strings and blob data point into the
+ *   buffer, so the buffer must outlive any term read from it.
+ */
+
+/* write EXO term EXO to STREAM in the binary encoding, returns the number
+   of bytes written */
+size_t
+exo_write(struct exo_term_t *exo, FILE *stream);
+
+/* EXO node arena, terms built in it are released all at once */
+struct exo_arena_t {
+  struct exo_chunk_t *head;	/* first chunk of the arena */
+  struct exo_chunk_t *cur;	/* chunk currently allocated from */
+};
+
+/* create an EXO node arena */
+struct exo_arena_t *
+exo_arena_create(void);
+
+/* release every term built in ARENA, its memory is kept for reuse */
+void
+exo_arena_reset(struct exo_arena_t *arena);
+
+/* binary EXO reader */
+struct exo_reader_t {
+  unsigned char *buf;		/* encoded terms */
+  unsigned char *p;		/* next byte to decode */
+  unsigned char *end;		/* end of the encoded terms */
+};
+
+/* start reader RD on the SIZE bytes of encoded terms at BUF */
+void
+exo_reader_init(struct exo_reader_t *rd, unsigned char *buf, size_t size);
+
+/* return the class of the next term of RD, ec_null at the end of a list,
+   or ec_NUM at the end of the buffer */
+enum exo_class_t
+exo_peek(struct exo_reader_t *rd);
+
+/* pull the next node of RD into TERM, returns FALSE at the end of the
+   buffer; scalars, strings and blobs are decoded in full, a list or array
+   yields only its header (arrays with their size, and a NULL array) and
+   its elements are pulled next, the end of a list pulls as ec_null */
+int
+exo_pull(struct exo_reader_t *rd, struct exo_term_t *term);
+
+/* skip over the next term of RD, lists and arrays included */
+void
+exo_skip(struct exo_reader_t *rd);
+
+/* pull the next whole term of RD, with its nodes taken from ARENA, returns
+   NULL at the end of the buffer */
+struct exo_term_t *
+exo_pull_tree(struct exo_reader_t *rd, struct exo_arena_t *arena);
+
 /* lexor components */
 enum lex_t {
   lex_integer = 256,
@@ -0,0 +1,331 @@
+/* refq.c - reference queue routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "refq.h"
+
+/* spins before a waiting thread gives up its host CPU */
+#define REFQ_SPINS		64
+
+/* list of live queues, for refq_sync_all() */
+static struct refq_t *refq_list = NULL;
+
+/* wait a little while another thread makes progress */
+static void
+refq_pause(int *spins)
+{
+  if (++*spins < REFQ_SPINS)
+    {
+#if defined(__i386__) || defined(__x86_64__)
+      __asm__ __volatile__ ("pause");
+#endif
+    }
+  else
+    {
+      *spins = 0;
+      sched_yield();
+    }
+}
+
+/* return the position of the slowest consumer */
+static word_t
+min_tail(struct refq_t *q)
+{
+  int i;
+  word_t tail, dist, max_dist = 0;
+
+  /* positions wrap, so compare distances from the head */
+  for (i=0; i < q->nconsumers; i++)
+    {
+      tail = __atomic_load_n(&q->consumers[i].tail, __ATOMIC_ACQUIRE);
+      dist = q->head - tail;
+      if (dist > max_dist)
+	max_dist = dist;
+    }
+  return q->head - max_dist;
+}
+
+/* consumer thread, reads every record in order until the queue shuts down */
+static void *
+consumer_thread(void *arg)
+{
+  struct refq_consumer_t *c = (struct refq_consumer_t *)arg;
+  struct refq_t *q = c->q;
+  word_t pos, head;
+  int spins = 0;
+
+  pos = c->tail;
+  for (;;)
+    {
+      head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+      if (pos == head)
+	{
+	  /* the producer sets DONE after its last publish */
+	  if (__atomic_load_n(&q->done, __ATOMIC_ACQUIRE)
+	      && pos == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE))
+	    break;
+	  refq_pause(&spins);
+	  continue;
+	}
+      spins = 0;
+
+      while (pos != head)
+	{
+	  c->fn(&q->ring[pos & q->mask], c->arg);
+	  pos++;
+	  if ((pos & (REFQ_BATCH-1)) == 0)
+	    __atomic_store_n(&c->tail, pos, __ATOMIC_RELEASE);
+	}
+      __atomic_store_n(&c->tail, pos, __ATOMIC_RELEASE);
+    }
+  return NULL;
+}
+
+/* create a reference queue with SIZE records, SIZE must be a power-of-two */
+struct refq_t *
+refq_create(word_t size,		/* ring size, in records */
+	    int threaded)		/* run consumers on their own threads? */
+{
+  struct refq_t *q;
+
+  if (size < REFQ_BATCH || (size & (size-1)) != 0)
+    fatal("reference queue size `%u' must be a power-of-two >= %d",
+	  size, REFQ_BATCH);
+
+  if (posix_memalign((void **)&q, REFQ_LINE_SZ, sizeof(struct refq_t)))
+    fatal("out of virtual memory");
+  memset(q, 0, sizeof(struct refq_t));
+
+  if (posix_memalign((void **)&q->ring, REFQ_LINE_SZ,
+		     size * sizeof(struct refq_rec_t)))
+    fatal("out of virtual memory");
+  memset(q->ring, 0, size * sizeof(struct refq_rec_t));
+
+  q->size = size;
+  q->mask = size - 1;
+  q->threaded = threaded;
+
+  /* place on the live queue list */
+  q->next = refq_list;
+  refq_list = q;
+
+  return q;
+}
+
+/* add consumer FN, called with ARG for every published record; consumers
+   must all be added before the first record is published */
+void
+refq_add_consumer(struct refq_t *q,	/* reference queue */
+		  char *name,		/* consumer name */
+		  refq_fn_t fn,		/* consumer function */
+		  void *arg)		/* consumer-specific state */
+{
+  struct refq_consumer_t *c;
+
+  if (q->running || q->head != 0)
+    panic("consumer `%s' added to a running reference queue", name);
+  if (q->nconsumers == REFQ_MAX_CONSUMERS)
+    fatal("too many reference queue consumers, maximum is %d",
+	  REFQ_MAX_CONSUMERS);
+
+  c = &q->consumers[q->nconsumers++];
+  c->tail = 0;
+  c->fn = fn;
+  c->arg = arg;
+  c->name = name;
+  c->q = q;
+}
+
+/* start the consumer threads, done on the first reserved record */
+static void
+start_consumers(struct refq_t *q)
+{
+  int i;
+
+  q->running = TRUE;
+  if (!q->threaded)
+    return;
+
+  for (i=0; i < q->nconsumers; i++)
+    {
+      if (pthread_create(&q->consumers[i].thread, NULL,
+			 consumer_thread, &q->consumers[i]) != 0)
+	fatal("could not start reference queue consumer `%s'",
+	      q->consumers[i].name);
+    }
+}
+
+/* reserve the next record in the ring, waits while the ring is full */
+struct refq_rec_t *
+refq_alloc(struct refq_t *q)		/* reference queue */
+{
+  int spins = 0;
+
+  if (!q->running)
+    start_consumers(q);
+
+  if (!q->threaded)
+    {
+      /* consumers run inside refq_publish(), one slot is enough */
+      return &q->ring[0];
+    }
+
+  if (q->head - q->tail_min >= q->size)
+    {
+      /* ring looks full, refresh the slowest consumer position */
+      q->tail_min = min_tail(q);
+      if (q->head - q->tail_min >= q->size)
+	{
+	  q->full_waits++;
+	  do {
+	    refq_pause(&spins);
+	    q->tail_min = min_tail(q);
+	  } while (q->head - q->tail_min >= q->size);
+	}
+    }
+  return &q->ring[q->head & q->mask];
+}
+
+/* publish the record last returned by refq_alloc() to all consumers */
+void
+refq_publish(struct refq_t *q)		/* reference queue */
+{
+  int i;
+
+  if (!q->threaded)
+    {
+      for (i=0; i < q->nconsumers; i++)
+	q->consumers[i].fn(&q->ring[0], q->consumers[i].arg);
+      q->head++;
+      return;
+    }
+
+  __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+}
+
+/* wait until all consumers have read every published record */
+void
+refq_sync(struct refq_t *q)		/* reference queue */
+{
+  int spins = 0;
+
+  if (!q->threaded || !q->running)
+    return;
+
+  while (min_tail(q) != q->head)
+    refq_pause(&spins);
+  q->tail_min = q->head;
+}
+
+/* wait until the consumers of every live queue have caught up */
+void
+refq_sync_all(void)
+{
+  struct refq_t *q;
+
+  for (q=refq_list; q != NULL; q=q->next)
+    refq_sync(q);
+}
+
+/* drain queue Q, stop its consumer threads and free it */
+void
+refq_delete(struct refq_t *q)		/* reference queue */
+{
+  int i;
+  struct refq_t *elt, *prev;
+
+  if (q->threaded && q->running)
+    {
+      __atomic_store_n(&q->done, TRUE, __ATOMIC_RELEASE);
+      for (i=0; i < q->nconsumers; i++)
+	pthread_join(q->consumers[i].thread, NULL);
+    }
+
+  /* remove from the live queue list */
+  for (prev=NULL, elt=refq_list; elt != NULL; prev=elt, elt=elt->next)
+    {
+      if (elt == q)
+	break;
+    }
+  if (elt != NULL)
+    {
+      if (prev != NULL)
+	prev->next = q->next;
+      else
+	refq_list = q->next;
+    }
+
+  free(q->ring);
+  free(q);
+}
+
+/* register reference queue statistics */
+void
+refq_reg_stats(struct refq_t *q,	/* reference queue */
+	       struct stat_sdb_t *sdb,	/* stats database */
+	       char *name)		/* queue name, stats are <name>.* */
+{
+  char buf[512], buf1[512];
+
+  sprintf(buf, "%s.full_waits", name);
+  sprintf(buf1, "times the functional core waited on a full %s ring", name);
+  stat_reg_counter(sdb, mystrdup(buf), mystrdup(buf1),
+		   &q->full_waits, 0, NULL);
+}
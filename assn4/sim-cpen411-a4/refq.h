@@ -0,0 +1,182 @@
+/* refq.h - reference queue interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef REFQ_H
+#define REFQ_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * The reference queue package lets one functional core feed any number of
+ * passive analyzers (branch predictors, caches, ...).  The core publishes a
+ * compact record for each instruction the analyzers need to see (only the
+ * branches for a predictor, say) into a single-producer,
+ * multi-consumer ring buffer; every consumer reads every record, in order, on
+ * its own thread, so throughput is bounded by the functional core rather than
+ * by the sum of all models.  The ring is lock-free: the producer owns the
+ * head index, each consumer owns its tail index, and the producer only waits
+ * when the slowest consumer is a full ring behind.
+ *
+ * Usage, on the functional core:
+ *
+ *   rec = refq_alloc(q);	-- reserve the next record, waits if full
+ *   rec->pc = ...;		-- fill it in
+ *   refq_publish(q);		-- hand it to all consumers
+ *
+ * Consumers must not touch simulator state other than their own, since they
+ * run behind the functional core.  Call refq_sync() (or refq_sync_all()) to
+ * wait for all consumers to catch up, e.g., before printing statistics.  A
+ * queue created with THREADED == FALSE calls the consumers directly from
+ * refq_publish(), which gives the same results on a single host CPU.
+ */
+
+/* maximum number of consumers per queue */
+#define REFQ_MAX_CONSUMERS	16
+
+/* records a consumer processes between tail updates, must be power-of-two */
+#define REFQ_BATCH		64
+
+/* host cache line size, keeps producer and consumer indices apart */
+#define REFQ_LINE_SZ		64
+
+/* reference record, one per published instruction */
+struct refq_rec_t {
+  counter_t icnt;		/* instruction number, 1 is the first */
+  md_addr_t pc;			/* instruction address */
+  md_addr_t next_pc;		/* address of the next instruction executed */
+  md_addr_t addr;		/* effective address, loads and stores only */
+  enum md_opcode op;		/* instruction opcode */
+  byte_t in[3];			/* input register dependences, 0 if none */
+  byte_t out[2];		/* output register dependences, 0 if none */
+  byte_t taken;			/* control instruction redirected the PC? */
+};
+
+/* consumer function, called for every record in program order */
+typedef void
+(*refq_fn_t)(struct refq_rec_t *rec,	/* record to consume */
+	     void *arg);		/* consumer-specific state */
+
+/* queue consumer */
+struct refq_consumer_t {
+  /* consumer owned, next record to read */
+  word_t tail __attribute__((aligned(REFQ_LINE_SZ)));
+  refq_fn_t fn;			/* consumer function */
+  void *arg;			/* consumer-specific state */
+  char *name;			/* consumer name */
+  struct refq_t *q;		/* queue this consumer reads */
+  pthread_t thread;		/* consumer thread */
+};
+
+/* reference queue */
+struct refq_t {
+  /* producer owned, next record to publish */
+  word_t head __attribute__((aligned(REFQ_LINE_SZ)));
+  word_t tail_min;		/* producer's copy of the slowest tail */
+  word_t size;			/* ring size, in records, power-of-two */
+  word_t mask;			/* ring index mask */
+  struct refq_rec_t *ring;	/* record ring */
+  int threaded;			/* run consumers on their own threads? */
+  int running;			/* consumer threads started? */
+  int done;			/* set by producer at shutdown */
+  int nconsumers;		/* number of consumers */
+  struct refq_consumer_t consumers[REFQ_MAX_CONSUMERS];
+  struct refq_t *next;		/* next live queue */
+
+  /* queue stats */
+  counter_t full_waits;		/* times the producer found the ring full */
+};
+
+/* create a reference queue with SIZE records, SIZE must be a power-of-two */
+struct refq_t *
+refq_create(word_t size,		/* ring size, in records */
+	    int threaded);		/* run consumers on their own threads? */
+
+/* add consumer FN, called with ARG for every published record; consumers
+   must all be added before the first record is published */
+void
+refq_add_consumer(struct refq_t *q,	/* reference queue */
+		  char *name,		/* consumer name */
+		  refq_fn_t fn,		/* consumer function */
+		  void *arg);		/* consumer-specific state */
+
+/* reserve the next record in the ring, waits while the ring is full */
+struct refq_rec_t *
+refq_alloc(struct refq_t *q);		/* reference queue */
+
+/* publish the record last returned by refq_alloc() to all consumers */
+void
+refq_publish(struct refq_t *q);		/* reference queue */
+
+/* wait until all consumers have read every published record */
+void
+refq_sync(struct refq_t *q);		/* reference queue */
+
+/* wait until the consumers of every live queue have caught up */
+void
+refq_sync_all(void);
+
+/* drain queue Q, stop its consumer threads and free it */
+void
+refq_delete(struct refq_t *q);		/* reference queue */
+
+/* register reference queue statistics */
+void
+refq_reg_stats(struct refq_t *q,	/* reference queue */
+	       struct stat_sdb_t *sdb,	/* stats database */
+	       char *name);		/* queue name, stats are <name>.* */
+
+#endif /* REFQ_H */
@@ -63,17 +63,64 @@
 #include "syscall.h"
 #include "options.h"
 #include "stats.h"
+#include "refq.h"
+#include "hostprof.h"
+#include "sweep.h"
 #include "sim.h"
 
 static counter_t loads;
 static counter_t stores;
 
-static counter_t g_lcache_miss;
-static counter_t g_scache_miss;
-static counter_t g_icache_miss;
-static counter_t prefetches;
+#define MAX_WAYS 8
+
+struct block {
+   md_addr_t m_tag[MAX_WAYS];
+   int m_valid[MAX_WAYS];
+   unsigned time[MAX_WAYS]; 
+};
+
+struct cache {
+   struct block *m_tag_array;
+     
+   unsigned m_total_blocks;
+   unsigned m_set_shift;
+   unsigned m_set_mask;
+   unsigned m_tag_shift;
+   int n_ways;
+
+   counter_t *writebacks;   // eviction counter, owned by this cache
+};
+
+// one instruction and one data cache with their own counters; a parameter
+// sweep feeds one such model per grid point from a single functional run
+struct cache_model {
+   struct cache icache;
+   struct cache dcache;
+   int prefetch;            // prefetch the next instruction on each fetch?
+
+   counter_t lcache_miss;
+   counter_t scache_miss;
+   counter_t icache_miss;
+   counter_t prefetches;
+
+   counter_t icache_writebacks;
+   counter_t dcache_writebacks;
+};
+
+// cache models fed by this run, and the one sim_reg_stats() reports
+static struct cache_model models[REFQ_MAX_CONSUMERS];
+static int nmodels = 0;
+static struct cache_model *model = &models[0];
+
+static void cache_model_add(void);
+static void cache_model_select(int inst);
 
-static counter_t writeback_events;
+// options that configure the cache models only, grid points that differ
+// only in these share one functional run
+static char *cache_model_opts[] =
+  { "-cache:il1", "-cache:dl1", "-cache:prefetch", NULL };
+static struct sweep_models_t cache_models =
+  { cache_model_opts, REFQ_MAX_CONSUMERS, cache_model_add, cache_model_select };
 
 /*
  * This file implements a functional simulator.  This functional simulator is
@@ -94,6 +141,23 @@ static counter_t sim_num_refs = 0;
 /* maximum number of inst's to execute */
 static unsigned int max_insts;
 
+/* reference queues feeding the instruction and data caches */
+static struct refq_t *icache_q = NULL;
+static struct refq_t *dcache_q = NULL;
+
+/* reference queue size, in instructions */
+static unsigned int refq_size;
+
+/* run the caches inline on the functional core? */
+static int refq_inline;
+
+/* instruction and data cache geometry, <nsets>:<bsize>:<assoc> */
+static char *cache_il1_opt;
+static char *cache_dl1_opt;
+
+/* prefetch the next instruction on each fetch? */
+static int cache_prefetch;
+
 /* register simulator-specific options */
 void
 sim_reg_options(struct opt_odb_t *odb)
@@ -111,13 +175,57 @@ sim_reg_options(struct opt_odb_t *odb)
 	       &max_insts, /* default */0,
 	       /* print */TRUE, /* format */NULL);
 
+  /* cache reference queue */
+  opt_reg_uint(odb, "-refq:size",
+	       "reference queue size, in instructions (power of two)",
+	       &refq_size, /* default */4096,
+	       /* print */TRUE, /* format */NULL);
+  opt_reg_flag(odb, "-refq:inline",
+	       "run the caches inline on the functional core "
+	       "(faster on a single host CPU)",
+	       &refq_inline, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
+  /* cache models */
+  opt_reg_string(odb, "-cache:il1",
+		 "instruction cache config, i.e., {<nsets>:<bsize>:<assoc>}",
+		 &cache_il1_opt, "256:32:4",
+		 /* print */TRUE, /* format */NULL);
+  opt_reg_string(odb, "-cache:dl1",
+		 "data cache config, i.e., {<nsets>:<bsize>:<assoc>}",
+		 &cache_dl1_opt, "32:64:8",
+		 /* print */TRUE, /* format */NULL);
+  opt_reg_flag(odb, "-cache:prefetch",
+	       "prefetch the next instruction on each instruction fetch",
+	       &cache_prefetch, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+  sweep_reg_models(&cache_models);
+}
+
+/* parse cache config OPT of option NAME, fatal if it is not valid */
+static void
+cache_geometry(char *name, char *opt, int *nsets, int *bsize, int *assoc)
+{
+  if (sscanf(opt, "%d:%d:%d", nsets, bsize, assoc) != 3)
+    fatal("bad %s cache parms: <nsets>:<bsize>:<assoc>", name);
+  if (*nsets <= 0 || (*nsets & (*nsets - 1)) != 0)
+    fatal("%s cache sets `%d' must be a power of two", name, *nsets);
+  if (*bsize < (int)sizeof(md_inst_t) || (*bsize & (*bsize - 1)) != 0)
+    fatal("%s cache block size `%d' must be a power of two >= %d",
+	  name, *bsize, (int)sizeof(md_inst_t));
+  if (*assoc <= 0 || *assoc > MAX_WAYS)
+    fatal("%s cache associativity `%d' must be between 1 and %d",
+	  name, *assoc, MAX_WAYS);
 }
 
 /* check simulator-specific option values */
 void
 sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 {
-  /* nada */
+  int nsets, bsize, assoc;
+
+  cache_geometry("instruction", cache_il1_opt, &nsets, &bsize, &assoc);
+  cache_geometry("data", cache_dl1_opt, &nsets, &bsize, &assoc);
 }
 
 /* register simulator-specific statistics */
@@ -136,7 +244,7 @@ sim_reg_stats(struct stat_sdb_t *sdb)
  
  stat_reg_formula(sdb, "sim_inst_rate",
 		   "simulation speed (in insts/sec)",
-		   "sim_num_insn / sim_elapsed_time", NULL);
+		   "(sim_num_insn - sim_insn_base) / sim_elapsed_time", NULL);
 
   stat_reg_counter(sdb, "stores",
                 "total number of stores",
@@ -148,7 +256,7 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 
   stat_reg_counter(sdb, "sim_num_scache_miss",
  		"total number of store cache misses",
-		 &g_scache_miss, 0, NULL);
+		 &model->scache_miss, 0, NULL);
 
   stat_reg_formula(sdb, "sim_scache_miss_rate",
  		"store cache miss rate (percentage)",
@@ -156,15 +264,24 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 
   stat_reg_counter(sdb, "sim_num_lcache_miss",
                 "total number of loads cache misses",
-                 &g_lcache_miss, 0, NULL);
+                 &model->lcache_miss, 0, NULL);
 
   stat_reg_formula(sdb, "sim_lcache_miss_rate",
                 "load cache miss rate (percentage)",
                 "100*(sim_num_lcache_miss / loads)", NULL);
 
-  stat_reg_counter(sdb, "writeback_events",
+  // each cache counts its own evictions, so the caches can run on separate threads
+  stat_reg_counter(sdb, "icache_writebacks",
+                "total number of instruction cache writeback events",
+                 &model->icache_writebacks, 0, NULL);
+
+  stat_reg_counter(sdb, "dcache_writebacks",
+                "total number of data cache writeback events",
+                 &model->dcache_writebacks, 0, NULL);
+
+  stat_reg_formula(sdb, "writeback_events",
                 "total number of writeback events",
-                 &writeback_events, 0, NULL);
+                "icache_writebacks + dcache_writebacks", "%12.0f");
 
   stat_reg_formula(sdb, "writeback_to_store_ratio",
                 "writeback events per store",
@@ -173,14 +290,16 @@ sim_reg_stats(struct stat_sdb_t *sdb)
   // instruction cache
   stat_reg_counter(sdb, "sim_num_icache_miss",
  		"total number of instruction cache misses",
-		 &g_icache_miss, 0, NULL);
+		 &model->icache_miss, 0, NULL);
 
   stat_reg_formula(sdb, "sim_icache_miss_rate",
  		"instruction cache miss rate (percentage)",
- 		"100*(sim_num_icache_miss / sim_num_insn)", NULL);
+ 		"100*(sim_num_icache_miss / (sim_num_insn - sim_insn_base))", NULL);
 
   ld_reg_stats(sdb);
   mem_reg_stats(mem, sdb);
+  refq_reg_stats(icache_q, sdb, "icache_q");
+  refq_reg_stats(dcache_q, sdb, "dcache_q");
 }
 
 /* initialize the simulator */
@@ -192,9 +311,16 @@ sim_init(void)
   /* allocate and initialize register file */
   regs_init(&regs);
 
+  /* the host profiler samples the PC of the instruction being simulated */
+  HOSTPROF_GUEST_PC(&regs.regs_PC);
+
   /* allocate and initialize memory space */
   mem = mem_create("mem");
   mem_init(mem);
+
+  /* the caches run behind the functional core, each on its own queue */
+  icache_q = refq_create(refq_size, /* threaded */!refq_inline);
+  dcache_q = refq_create(refq_size, /* threaded */!refq_inline);
 }
 
 /* load program into simulated state */
@@ -326,28 +452,8 @@ sim_uninit(void)
 #define DFCC            (2+32+32)
 #define DTMP            (3+32+32)
 
-#define MAX_WAYS 8
-
-struct block {
-   md_addr_t m_tag[MAX_WAYS];
-   int m_valid[MAX_WAYS];
-   unsigned time[MAX_WAYS]; 
-};
-
-struct cache {
-   struct block *m_tag_array;
-     
-   unsigned m_total_blocks;
-   unsigned m_set_shift;
-   unsigned m_set_mask;
-   unsigned m_tag_shift;
-   int n_ways;
-};
-
-
-
-// Parameters: cache, starting address of memory reference, miss counter
-void cache_access( struct cache *c, unsigned addr, counter_t *miss_counter)
+// Parameters: cache, starting address of memory reference, LRU timestamp, miss counter
+void cache_access( struct cache *c, unsigned addr, counter_t now, counter_t *miss_counter)
 {
    unsigned index, tag, i;
 
@@ -359,7 +465,7 @@ void cache_access( struct cache *c, unsigned addr, counter_t *miss_counter)
    int miss = 1;
    for (i = 0; i < c->n_ways; i++){
      if(c->m_tag_array[index].m_valid[i] && (c->m_tag_array[index].m_tag[i] == tag)){
-        c->m_tag_array[index].time[i] = sim_num_insn;
+        c->m_tag_array[index].time[i] = now;
         miss = 0;
         break;
      }  
@@ -369,7 +475,7 @@ void cache_access( struct cache *c, unsigned addr, counter_t *miss_counter)
    if(miss){
 
      *miss_counter = *miss_counter + 1;
-     writeback_events++;
+     *c->writebacks = *c->writebacks + 1;
  
      // find the block with the lowest timestamp (LRU)
      unsigned lowest = c->m_tag_array[index].time[0]; 
@@ -391,6 +497,73 @@ void cache_access( struct cache *c, unsigned addr, counter_t *miss_counter)
 
 }
 
+// the caches are reference queue consumers, they only see the published
+// instruction records and never touch the simulated machine state
+
+// instruction cache, one access per published fetch; the fetches the
+// producer leaves out would all hit the block of the previous record
+static void icache_consume(struct refq_rec_t *rec, void *arg)
+{
+  struct cache_model *m = (struct cache_model *) arg;
+
+  // the fetch happens before the instruction is counted
+  cache_access(&m->icache, rec->pc, rec->icnt - 1, &m->icache_miss);
+
+  // access the next instruction in order to prefetch the value into the cache 
+  if(m->prefetch) cache_access(&m->icache, rec->pc + sizeof(md_inst_t), rec->icnt - 1, &m->prefetches); 
+}
+
+// data cache, one access per load or store
+static void dcache_consume(struct refq_rec_t *rec, void *arg)
+{
+  struct cache_model *m = (struct cache_model *) arg;
+
+  if( (MD_OP_FLAGS(rec->op) & F_LOAD) != 0)
+      cache_access(&m->dcache, rec->addr, rec->icnt, &m->lcache_miss);
+  if( (MD_OP_FLAGS(rec->op) & F_STORE) != 0)
+      cache_access(&m->dcache, rec->addr, rec->icnt, &m->scache_miss);
+}
+
+// set up cache C from config OPT of option NAME
+static void cache_create(struct cache *c, char *name, char *opt, counter_t *writebacks)
+{
+  int nsets, bsize, assoc;
+
+  cache_geometry(name, opt, &nsets, &bsize, &assoc);
+  c->m_tag_array    = (struct block *) calloc( sizeof(struct block), nsets);
+  if (!c->m_tag_array)
+    fatal("out of virtual memory");
+  c->m_total_blocks = nsets;
+  c->m_set_shift    = log_base2(bsize);
+  c->m_set_mask     = nsets - 1;
+  c->m_tag_shift    = log_base2(bsize) + log_base2(nsets);
+  c->n_ways         = assoc;
+  c->writebacks     = writebacks;
+}
+
+// attach one more cache model, configured from the current option values
+static void cache_model_add(void)
+{
+  struct cache_model *m;
+
+  if (nmodels == REFQ_MAX_CONSUMERS)
+    fatal("too many cache models, maximum is %d", REFQ_MAX_CONSUMERS);
+  m = &models[nmodels++];
+
+  cache_create(&m->icache, "instruction", cache_il1_opt, &m->icache_writebacks);
+  cache_create(&m->dcache, "data", cache_dl1_opt, &m->dcache_writebacks);
+  m->prefetch = cache_prefetch;
+
+  refq_add_consumer(icache_q, "icache", icache_consume, m);
+  refq_add_consumer(dcache_q, "dcache", dcache_consume, m);
+}
+
+// make cache model INST the one sim_reg_stats() reports
+static void cache_model_select(int inst)
+{
+  model = &models[inst];
+}
+
 /* start simulation, program loaded, processor precise state initialized */
 void sim_main(void)
 {
@@ -399,28 +572,26 @@ void sim_main(void)
   enum md_opcode op;
   register int is_write;
   enum md_fault_type fault;
-
-  // specify whether to do an instruction prefetch with the 
-  int PREFETCH = 0;
-  
-
-  // create instruction cache
-  struct cache *icache = (struct cache *) calloc( sizeof(struct cache), 1);
-  icache->m_tag_array = (struct block *) calloc( sizeof(struct block), 256); 
-  icache->m_total_blocks = 256;  
-  icache->m_set_shift    = 5;    	// 5=log2(32 bytes/block)   
-  icache->m_set_mask     = (1<<8)-1;    // 8=log2(256 blocks/way)
-  icache->m_tag_shift    = 13;
-  icache->n_ways         = 4;
-
-  // create data cache
-  struct cache *dcache = (struct cache *) calloc( sizeof(struct cache), 1);
-  dcache->m_tag_array = (struct block *) calloc( sizeof(struct block), 256);
-  dcache->m_total_blocks = 256;
-  dcache->m_set_shift    = 6;       	// 6=log2(64 bytes/block)
-  dcache->m_set_mask     = (1<<5)-1;	// 5=log2(32 blocks/way)
-  dcache->m_tag_shift    = 11;
-  dcache->n_ways         = 8;
+  int i1, i2, i3, o1, o2;
+  struct refq_rec_t *rec;
+  md_addr_t fetch_block = 0;
+  int fetch_run = 0;
+  unsigned fetch_shift;
+  int fetch_all, i;
+
+  // a parameter sweep may have attached its models already
+  if (nmodels == 0)
+    cache_model_add();
+
+  // runs of fetches from one block of the smallest instruction cache block
+  // size are runs in every model, and a prefetching model sees every fetch
+  fetch_shift = models[0].icache.m_set_shift;
+  fetch_all = FALSE;
+  for (i = 0; i < nmodels; i++)
+    {
+      fetch_shift = MIN(fetch_shift, models[i].icache.m_set_shift);
+      fetch_all |= models[i].prefetch;
+    }
 
   fprintf(stderr, "sim: ** starting functional simulation **\n");
 
@@ -430,17 +601,14 @@ void sim_main(void)
 
   while (TRUE)
     {
+      HOSTPROF_INSN(hp_decode);
+
       /* maintain $r0 semantics */
       regs.regs_R[MD_REG_ZERO] = 0;
 #ifdef TARGET_ALPHA
       regs.regs_F.d[MD_REG_ZERO] = 0.0;
 #endif /* TARGET_ALPHA */
 
-      
-      cache_access(icache, regs.regs_PC, &g_icache_miss);
-      
-      // access the next instruction in order to prefetch the value into the cache 
-      if(PREFETCH) cache_access(icache, regs.regs_NPC, &prefetches); 
 
       MD_FETCH_INST(inst, mem, regs.regs_PC);
 
@@ -457,10 +625,12 @@ void sim_main(void)
       MD_SET_OPCODE(op, inst);
 
       /* execute the instruction */
+      HOSTPROF_SWITCH(hp_exec);
       switch (op)
 	{
 #define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)		\
 	case OP:							\
+          i1 = I1; i2 = I2; i3 = I3; o1 = O1; o2 = O2;			\
           SYMCAT(OP,_IMPL);						\
           break;
 #define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
@@ -498,16 +668,52 @@ void sim_main(void)
       }
 
        
-       // data cache accesses for loads/stores
-       if( (MD_OP_FLAGS(op) & F_LOAD) != 0) {
+       // count loads/stores, the data cache sees them through the queue
+       if( (MD_OP_FLAGS(op) & F_LOAD) != 0)
            loads++;
-           cache_access(dcache, addr, &g_lcache_miss);
-       }
 
-       if( (MD_OP_FLAGS(op) & F_STORE) != 0) {
+       if( (MD_OP_FLAGS(op) & F_STORE) != 0)
            stores++;
-           cache_access(dcache, addr, &g_scache_miss);
-       }
+
+      // hand loads and stores to the data cache
+      if (MD_OP_FLAGS(op) & F_MEM)
+        {
+          HOSTPROF_SWITCH(hp_timing);
+          rec = refq_alloc(dcache_q);
+          rec->icnt    = sim_num_insn;
+          rec->pc      = regs.regs_PC;
+          rec->next_pc = regs.regs_NPC;
+          rec->addr    = addr;
+          rec->op      = op;
+          rec->in[0]   = i1; rec->in[1] = i2; rec->in[2] = i3;
+          rec->out[0]  = o1; rec->out[1] = o2;
+          rec->taken   = (regs.regs_NPC != (regs.regs_PC + sizeof(md_inst_t)));
+          refq_publish(dcache_q);
+        }
+
+      // hand the first two fetches of each run from one block to the
+      // instruction cache: the first may miss, the second hits and makes
+      // the block most recently used (a miss leaves the LRU time alone),
+      // and further hits in the run change nothing
+      if ((regs.regs_PC >> fetch_shift) != fetch_block)
+        {
+          fetch_block = regs.regs_PC >> fetch_shift;
+          fetch_run = 0;
+        }
+      if (fetch_all || fetch_run++ < 2)
+        {
+          HOSTPROF_SWITCH(hp_timing);
+          rec = refq_alloc(icache_q);
+          rec->icnt    = sim_num_insn;
+          rec->pc      = regs.regs_PC;
+          rec->next_pc = regs.regs_NPC;
+          rec->addr    = addr;
+          rec->op      = op;
+          rec->in[0]   = i1; rec->in[1] = i2; rec->in[2] = i3;
+          rec->out[0]  = o1; rec->out[1] = o2;
+          rec->taken   = (regs.regs_NPC != (regs.regs_PC + sizeof(md_inst_t)));
+          refq_publish(icache_q);
+        }
 
 
       /* go to the next instruction */
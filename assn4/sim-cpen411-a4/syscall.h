@@ -62,6 +62,7 @@
 #include "host.h"
 #include "misc.h"
 #include "machine.h"
+#include "stats.h"
 
 /*
  * This module implements the system call portion of the SimpleScalar
@@ -96,4 +97,25 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 	    md_inst_t inst,		/* system call inst */
 	    int traceable);		/* traceable system call? */
 
+/* buffer up to SIZE bytes of simulated program output (writes to stdout and
+   stderr) before handing it to the host, 0 writes it straight through; the
+   buffer is flushed before any other system call, so output stays ordered
+   with input */
+void
+sys_output_init(int size);		/* output buffer size, in bytes */
+
+/* write NBYTES of simulated program output in BUF to stream FD (1 or 2) */
+void
+sys_output(int fd,			/* target stdout/stderr fd */
+	   void *buf,			/* output data */
+	   int nbytes);			/* number of bytes to write */
+
+/* hand any buffered simulated program output to the host */
+void
+sys_flush_output(void);
+
+/* register system call statistics */
+void
+sys_reg_stats(struct stat_sdb_t *sdb);	/* stats database */
+
 #endif /* SYSCALL_H */
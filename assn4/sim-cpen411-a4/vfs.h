@@ -0,0 +1,142 @@
+/* vfs.h - in-memory file system interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef VFS_H
+#define VFS_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "host.h"
+#include "misc.h"
+#include "stats.h"
+
+/*
+ * The in-memory file system serves the simulated program's files from the
+ * simulator's memory, so a run does not touch the host file system between
+ * start up and exit.  vfs_init() loads every regular file in a directory;
+ * the program can then open them by name (or as <dir>/<name>), and files it
+ * creates or writes are kept in memory and written to the host, under the
+ * name the program used, by vfs_sync() at exit.  Files that are not in the
+ * table go to the host as before.
+ *
+ * Descriptors handed out by the file system are real host descriptors (of
+ * /dev/null) held for as long as the file is open, so they can never clash
+ * with descriptors the host hands out to other system calls.  Descriptors
+ * duplicated with vfs_dup() share one file position, as on the host.
+ */
+
+/* largest descriptor the file system serves */
+#define VFS_MAX_FD		1024
+
+/* load every regular file in directory DIR into the file system */
+void
+vfs_init(char *dir);			/* directory to preload */
+
+/* is descriptor FD served by the file system? */
+int
+vfs_fd(int fd);				/* target file descriptor */
+
+/* open file FNAME with host open(2) FLAGS and MODE, returns TRUE if the file
+   system handles it, with the descriptor (or -1 and errno) in *FD; returns
+   FALSE if the file should be opened on the host */
+int
+vfs_open(char *fname,			/* file name */
+	 int flags,			/* host open(2) flags */
+	 int mode,			/* creation mode */
+	 int *fd);			/* descriptor, -1 on an error */
+
+/* read up to NBYTES from FD, returns the count (0 at end of file) and a
+   pointer to the data in *DATA, or -1 and errno */
+int
+vfs_read(int fd,			/* file descriptor */
+	 byte_t **data,			/* pointer to the data read */
+	 int nbytes);			/* bytes requested */
+
+/* write NBYTES to FD, returns the count and the space to copy the data to in
+   *DATA, or -1 and errno */
+int
+vfs_write(int fd,			/* file descriptor */
+	  byte_t **data,		/* where to copy the data */
+	  int nbytes);			/* bytes to write */
+
+/* reposition FD as lseek(2), returns the new offset, or -1 and errno */
+off_t
+vfs_lseek(int fd,			/* file descriptor */
+	  off_t offset,			/* offset */
+	  int whence);			/* SEEK_SET, SEEK_CUR or SEEK_END */
+
+/* stat FD as fstat(2), returns 0, or -1 and errno */
+int
+vfs_fstat(int fd,			/* file descriptor */
+	  struct stat *sbuf);		/* stat buffer to fill */
+
+/* duplicate FD as dup(2), or as dup2(2) onto NEWFD if NEWFD >= 0; either
+   descriptor may be served by the file system, returns the new descriptor,
+   or -1 and errno */
+int
+vfs_dup(int fd,				/* file descriptor */
+	int newfd);			/* descriptor to reuse, or -1 */
+
+/* close FD, returns 0, or -1 and errno */
+int
+vfs_close(int fd);			/* file descriptor */
+
+/* write every file the program created or modified to the host */
+void
+vfs_sync(void);
+
+/* register file system statistics */
+void
+vfs_reg_stats(struct stat_sdb_t *sdb);	/* stats database */
+
+#endif /* VFS_H */